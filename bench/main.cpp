@@ -0,0 +1,238 @@
+//
+//  main.cpp
+//  tinybench
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tinyscript/compiler/compiler.hpp>
+#include <tinyscript/compiler/cppemitter.hpp>
+#include <tinyscript/compiler/sourcemanager.hpp>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/runtime/aot.hpp>
+#include <tinyscript/runtime/jit.hpp>
+#include <tinyscript/runtime/vm.hpp>
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/library.hpp>
+#include <tinyscript/runtime/scheduler.hpp>
+#include <tinyscript/runtime/task.hpp>
+#include <tinyscript/runtime/threadpool.hpp>
+
+using namespace tinyscript;
+using Clock = std::chrono::steady_clock;
+
+// Scripts translated to C++ at build time (see CMakeLists.txt), which `-a` runs instead of compiling
+// the script file.
+TINYSCRIPT_DECLARE_SCRIPT(test)
+TINYSCRIPT_DECLARE_SCRIPT(demo)
+TINYSCRIPT_DECLARE_SCRIPT(fib)
+
+static const std::map<std::string, Program (*)(VM&)> translated = {
+    {"test", &scripts::test},
+    {"demo", &scripts::demo},
+    {"fib", &scripts::fib},
+};
+
+// Static size of the program's bytecode, in instructions and bytes.
+static std::pair<std::uint64_t, std::uint64_t> codeSize(const Program& program) {
+    std::uint64_t count = 0, bytes = 0;
+    auto measure = [&](const Program::Function& function) {
+        const auto& code = function.bytecode;
+        for(std::uint64_t at = 0; at < code.size(); ++count) {
+            at += 1 + (program.encoding == Program::Encoding::Registers
+                        ? operandSize(static_cast<RegOpcode>(code[at]))
+                        : operandSize(static_cast<Opcode>(code[at])));
+        }
+        bytes += code.size();
+    };
+    measure(program.script);
+    for(const auto& function: program.functions) {
+        measure(function);
+    }
+    return std::make_pair(count, bytes);
+}
+
+// Compiles a script once, then runs it to completion [iterations] times and reports the wall time
+// of each run. Script output goes to stdout, timings to stderr. With `-s count`, each run spawns
+// [count] tasks on a scheduler and ticks until they all return, which measures the cost of switching
+// between tasks rather than of running one, and `-w threads` runs them on a thread pool instead.
+// `-p budget` preempts tasks after that many backward jumps and calls, and resumes them straight away.
+// Tasks get the scheduler's default stack of 256 values and 64 frames; `-k slots` gives them [slots]
+// values and a frame for every 4 of them instead, so that more of them fit in memory.
+int main(int argc, const char * argv[]) {
+    
+    tinyscript::VM vm;
+    tinyscript::StdLib lib;
+    
+    vm.registerModule(lib.system());
+    vm.registerModule(lib.io());
+    vm.registerModule(lib.random());
+    vm.registerModule(lib.string());
+    vm.registerModule(lib.reflection());
+    
+    std::uint8_t optLevel = 1;
+    bool jit = false;
+    bool aot = false;
+    std::uint64_t tasks = 0;
+    std::uint64_t budget = 0;
+    std::uint32_t taskStack = 256;
+    unsigned threads = 0;
+    auto encoding = Program::Encoding::Stack;
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; ++arg) {
+        std::string flag = argv[arg];
+        if(flag == "-O0") optLevel = 0;
+        else if(flag == "-O1") optLevel = 1;
+        else if(flag == "-O2") optLevel = 2;
+        else if(flag == "-j") jit = true;
+        else if(flag == "-a") aot = true;
+        else if(flag == "-r") encoding = Program::Encoding::Registers;
+        else if(flag == "-t") encoding = Program::Encoding::Typed;
+        else if(flag == "-s" && arg + 1 < argc) tasks = std::strtoull(argv[++arg], nullptr, 10);
+        else if(flag == "-p" && arg + 1 < argc) budget = std::strtoull(argv[++arg], nullptr, 10);
+        else if(flag == "-w" && arg + 1 < argc) threads = std::atoi(argv[++arg]);
+        else if(flag == "-k" && arg + 1 < argc) taskStack = std::max(std::atoi(argv[++arg]), 4);
+        else break;
+    }
+    
+    if(argc - arg != 1 && argc - arg != 2) {
+        std::cerr << "error: wrong number of arguments" << std::endl;
+        std::cerr << "usage: " << argv[0] << " [-O0|-O1|-O2] [-j] [-a] [-r|-t] [-s count [-w threads] [-k slots]] [-p budget] script_file [iterations]" << std::endl;
+        return -1;
+    }
+    
+    std::ifstream input(argv[arg]);
+    if(!input.is_open()) {
+        std::cerr << "error: cannot open code file '" << argv[arg] << "'" << std::endl;
+        return -1;
+    }
+    int iterations = argc - arg == 2 ? std::atoi(argv[arg+1]) : 10;
+    if(iterations < 1) iterations = 1;
+    
+    Program prog;
+    if(aot) {
+        auto it = translated.find(CppEmitter::scriptName(argv[arg]));
+        if(it == translated.end()) {
+            std::cerr << "error: '" << argv[arg] << "' was not translated to C++ when building tinybench" << std::endl;
+            return -1;
+        }
+        prog = it->second(vm);
+    } else {
+        SourceManager manager{input};
+        Compiler comp{vm, manager};
+        prog = comp.compile(false, optLevel, encoding);
+    }
+    if(jit && !JIT::compile(prog)) std::cerr << "warning: no function could be compiled by the JIT" << std::endl;
+    
+    std::vector<double> times;
+    auto dispatched = vm.dispatchCount();
+    
+    if(tasks) {
+        std::mutex mutex;
+        std::string error;
+        auto onExit = [&](Task&, VM::Result result, const Value& value) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(result == VM::Result::Error && error.empty()) error = value.asString();
+        };
+        Scheduler scheduler{vm};
+        scheduler.setBudget(budget);
+        scheduler.onExit(onExit);
+        std::unique_ptr<ThreadPool> pool;
+        if(threads) {
+            pool = std::make_unique<ThreadPool>(vm, threads);
+            pool->setBudget(budget);
+            pool->onExit(onExit);
+        }
+        
+        double spawnTime = 0;
+        std::vector<std::unique_ptr<Task>> batch;
+        for(int i = 0; i < iterations; ++i) {
+            auto start = Clock::now();
+            for(std::uint64_t t = 0; t < tasks; ++t) {
+                batch.push_back(std::make_unique<Task>(prog, taskStack, taskStack / 4));
+            }
+            auto spawned = Clock::now();
+            for(auto& task: batch) {
+                if(pool) pool->spawn(std::move(task));
+                else scheduler.spawn(std::move(task));
+            }
+            batch.clear();
+            if(pool) pool->wait();
+            else scheduler.run();
+            auto end = Clock::now();
+            if(!error.empty()) {
+                std::cerr << "runtime error: " << error << std::endl;
+                return -1;
+            }
+            spawnTime += std::chrono::duration<double, std::milli>(spawned - start).count();
+            times.push_back(std::chrono::duration<double, std::milli>(end - spawned).count());
+        }
+        
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for(auto t: times) total += t;
+        auto resumes = (pool ? pool->resumes() : scheduler.resumes()) / iterations;
+        std::cerr << argv[arg] << ": " << iterations << " runs of " << tasks << " tasks";
+        if(pool) std::cerr << " on " << pool->threads() << " threads (" << pool->steals() / iterations << " steals per run)";
+        std::cerr << ", "
+                  << "min " << times.front() << " ms, "
+                  << "median " << times[times.size()/2] << " ms, "
+                  << "mean " << total / times.size() << " ms" << std::endl;
+        std::cerr << "  " << resumes << " resumes per run, "
+                  << times[times.size()/2] * 1e6 / resumes << " ns per resume (median), "
+                  << "spawning took " << spawnTime / iterations << " ms per run" << std::endl;
+        return 0;
+    }
+    
+    std::uint64_t preemptions = 0;
+    for(int i = 0; i < iterations; ++i) {
+        Task task{prog, 256};
+        auto run = [&] { return budget ? vm.run(task, budget) : vm.run(task); };
+        auto start = Clock::now();
+        auto result = run();
+        while(result.first == VM::Result::Continue || result.first == VM::Result::Preempted) {
+            preemptions += result.first == VM::Result::Preempted;
+            result = run();
+        }
+        auto end = Clock::now();
+        if(result.first == VM::Result::Error) {
+            std::cerr << "runtime error: " << result.second.asString() << std::endl;
+            return -1;
+        }
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for(auto t: times) total += t;
+    std::cerr << argv[arg] << ": " << iterations << " runs, "
+              << "min " << times.front() << " ms, "
+              << "median " << times[times.size()/2] << " ms, "
+              << "mean " << total / times.size() << " ms" << std::endl;
+    if(budget) std::cerr << "  preempted " << preemptions / iterations << " times per run" << std::endl;
+    
+    // Executed instructions are only counted when the VM is built with TINYSCRIPT_COUNT_DISPATCH.
+    auto size = codeSize(prog);
+    const char* encodings[] = {"stack", "registers", "typed"};
+    std::cerr << "  " << encodings[static_cast<int>(prog.encoding)] << " bytecode: "
+              << size.first << " instructions, " << size.second << " bytes";
+    dispatched = vm.dispatchCount() - dispatched;
+    if(dispatched) std::cerr << ", " << dispatched / iterations << " executed per run";
+    std::cerr << std::endl;
+    return 0;
+}
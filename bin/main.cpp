@@ -12,8 +12,10 @@
 #include <string>
 
 #include <tinyscript/compiler/compiler.hpp>
+#include <tinyscript/compiler/cppemitter.hpp>
 #include <tinyscript/compiler/sourcemanager.hpp>
 
+#include <tinyscript/runtime/jit.hpp>
 #include <tinyscript/runtime/vm.hpp>
 #include <tinyscript/runtime/program.hpp>
 #include <tinyscript/runtime/library.hpp>
@@ -32,21 +34,55 @@ int main(int argc, const char * argv[]) {
     vm.registerModule(lib.string());
     vm.registerModule(lib.reflection());
 
-    if(argc != 2) {
+    bool dump = false;
+    std::uint8_t optLevel = 1;
+    bool jit = false;
+    auto encoding = Program::Encoding::Stack;
+    std::string emitPath;
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; ++arg) {
+        std::string flag = argv[arg];
+        if(flag == "-d") dump = true;
+        else if(flag == "-O0") optLevel = 0;
+        else if(flag == "-O1") optLevel = 1;
+        else if(flag == "-O2") optLevel = 2;
+        else if(flag == "-j") jit = true;
+        else if(flag == "-r") encoding = Program::Encoding::Registers;
+        else if(flag == "-t") encoding = Program::Encoding::Typed;
+        else if(flag == "--emit-cpp" && arg + 1 < argc) emitPath = argv[++arg];
+        else break;
+    }
+    
+    if(argc - arg != 1) {
         std::cerr << "error: wrong number of arguments" << std::endl;
-        std::cerr << "usage: " << argv[0] << " script_file" << std::endl;
+        std::cerr << "usage: " << argv[0] << " [-d] [-O0|-O1|-O2] [-j] [-r|-t] [--emit-cpp output.cpp] script_file" << std::endl;
         return -1;
     }
     
-    std::ifstream input(argv[1]);
+    std::ifstream input(argv[arg]);
     if(!input.is_open()) {
-        std::cerr << "error: cannot open code file '" << argv[1] << "'" << std::endl;
+        std::cerr << "error: cannot open code file '" << argv[arg] << "'" << std::endl;
         return -1;
     }
     
     SourceManager manager{input};
     Compiler comp{vm, manager};
-    auto prog = comp.compile();
+    auto prog = comp.compile(dump, optLevel, encoding);
+    
+    if(!emitPath.empty()) {
+        std::ofstream output(emitPath);
+        if(!output.is_open()) {
+            std::cerr << "error: cannot open output file '" << emitPath << "'" << std::endl;
+            return -1;
+        }
+        CppEmitter emitter{prog, CppEmitter::scriptName(argv[arg])};
+        if(!emitter.emit(output)) {
+            std::cerr << "error: cannot translate '" << argv[arg] << "' to C++" << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+    if(jit) JIT::compile(prog);
     
     Task task{prog, 256};
     auto result = vm.run(task);
@@ -0,0 +1,50 @@
+//
+//  cfg.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/compiler/ilbuilder.hpp>
+
+namespace tinyscript {
+    
+    // Splits a function's IL into basic blocks, so jumps can be threaded and the blocks laid out
+    // again with as many of them as possible falling through to their successor.
+    class ControlFlowGraph {
+    public:
+        ControlFlowGraph(const ILFunction& function);
+        
+        bool isValid() const { return valid_; }
+        void threadJumps();
+        void duplicateTails();
+        void layout();
+        void lower(ILFunction& function);
+    
+    private:
+        struct Block {
+            std::vector<std::string>    labels;
+            std::vector<ILInstruction>  code;
+            std::int64_t                next = -1; // Block execution falls through to
+        };
+        
+        std::uint32_t target(const ILInstruction& inst) const { return blockOf_.at(inst.label()); }
+        std::int64_t forward(std::uint32_t block) const;
+        const std::string& label(std::uint32_t block);
+        std::vector<bool> reachable() const;
+        bool duplicateTail(std::uint32_t block);
+        
+        bool                                    valid_ = true;
+        std::vector<Block>                      blocks_;
+        std::map<std::string, std::uint32_t>    blockOf_;
+        std::vector<std::uint32_t>              order_;
+        std::uint64_t                           labelID_ = 0;
+    };
+}
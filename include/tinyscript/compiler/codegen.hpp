@@ -15,16 +15,16 @@
 namespace tinyscript {
     struct Token;
     class SourceManager;
+    class StringTable;
     
     class CodeGen {
     public:
         
-        CodeGen(const SourceManager& manager);
+        CodeGen(const SourceManager& manager, StringTable& strings);
         
         void openIf();
         void closeIf();
         
-        std::string ifLabel() const;
         std::string elseLabel() const;
         std::string endifLabel() const;
         
@@ -32,15 +32,20 @@ namespace tinyscript {
         void closeLoop();
         
         std::string loopLabel() const;
+        std::string nextLabel() const;
         std::string endLoopLabel() const;
         std::string loopVariable() const;
         
+        void openLogical(bool isAnd);
+        void closeLogical(bool isAnd);
+        
         std::uint64_t patchPoint();
         void patchConversion(Opcode code, std::uint64_t at);
         void patchCall(Opcode code, const std::string& symbol, std::uint64_t at);
         void dropCode(std::uint64_t at);
+        void discardCode(std::uint64_t from);
         
-        void openFunction(const Token& symbol, std::uint8_t arity);
+        void openFunction(const Token& symbol, const std::vector<Type>& paramTypes, Type returnType);
         void closeFunction();
         
         void declareLocal(const Token& symbol);
@@ -49,26 +54,44 @@ namespace tinyscript {
         
         void emitLocal(Opcode code, const Token& symbol);
         void emitLocal(Opcode code, const std::string& symbol);
+        void emitLocalJump(Opcode code, const std::string& symbol, const std::string& label);
         
         void emitConstantI(Opcode code, const Token& symbol);
         void emitConstantI(Opcode code, std::int64_t symbol);
         
         void emitConstantF(Opcode code, const Token& symbol);
-        void emitConstantF(Opcode code, float symbol);
+        void emitConstantF(Opcode code, double symbol);
         
         void emitConstantS(Opcode code, const Token& symbol);
         void emitConstantS(Opcode code, const std::string& symbol);
         
+        void emitConstant(const Value& value);
+        
         void emitInstruction(Opcode code);
         void emitJump(Opcode code, const std::string& label);
+        void emitBranch(bool condition, const std::string& label);
+        void emitNext();
+        void emitCall(const std::string& signature, std::uint8_t arity, Type result);
+        void emitForeignCall(const std::string& signature, std::uint8_t arity, Type result);
         
-        Program generate(bool dump);
+        Program generate(bool dump, std::uint8_t optLevel, Program::Encoding encoding = Program::Encoding::Stack);
         
     private:
+        struct Logical {
+            std::string     skip;   // Pushes the result when the left operand decides it
+            std::string     end;
+            bool            value;
+        };
+        
+        bool branchLogical(bool condition, const std::string& label);
+        bool fuseImmediate(Opcode code);
+        bool fuseIncrement(std::uint8_t slot);
+        
         std::uint64_t               ifID_       = 0;
         std::uint64_t               loopID_     = 0;
         std::vector<std::uint64_t>  ifStack_;
         std::vector<std::uint64_t>  loopStack_;
+        std::vector<Logical>        logicals_;
         
         ILBuilder                   builder_;
         const SourceManager&        manager_;
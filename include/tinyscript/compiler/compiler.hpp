@@ -6,8 +6,10 @@
 //  Copyright © 2018 Amy Parent. All rights reserved.
 //
 #pragma once
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <tinyscript/compiler/token.hpp>
 #include <tinyscript/compiler/scanner.hpp>
@@ -24,10 +26,15 @@ namespace tinyscript {
     class Compiler {
     public:
         Compiler(const VM& vm, const SourceManager& manager);
-        Program compile(bool dump = false);
+        // optLevel 0 emits the IL as generated, 1 runs the peephole optimizer over it, 2 also runs
+        // the mid-level IR passes.
+        Program compile(bool dump = false, std::uint8_t optLevel = 1,
+                        Program::Encoding encoding = Program::Encoding::Stack);
         
     private:
         
+        void scanAssignments();
+        
         // MARK: - recursive descent recognizers;
         
         void recProgram();
@@ -44,12 +51,23 @@ namespace tinyscript {
         void recAssign();
         void recFlowStatement();
         void recYield();
+        void recExpressionStatement();
         
         TypeExpr recExpression(int level);
+        TypeExpr recLogical(const Token& op, TypeExpr lhs, std::uint64_t start, int min);
         TypeExpr recTerm();
         TypeExpr recFuncCall(const Token& func);
         TypeExpr recFuncCall(const Token& module, const Token& func);
         
+        struct Argument {
+            Token           token;
+            TypeExpr        type;
+            std::uint64_t   end;
+        };
+        
+        std::vector<Argument> recArguments();
+        void convertArguments(const std::vector<Argument>& args, const std::vector<Type>& params);
+        
         // MARK: - recursive descent utilities
         
         void compilerError(const std::string& message);
@@ -70,6 +88,7 @@ namespace tinyscript {
         bool expectTerminator();
         
         bool recovering = false;
+        std::set<std::string> assigned_;
         
         
         const SourceManager& manager_;
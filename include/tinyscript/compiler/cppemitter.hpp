@@ -0,0 +1,60 @@
+//
+//  cppemitter.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/runtime/program.hpp>
+
+namespace tinyscript {
+    
+    // Translates a compiled program to a C++ translation unit linking against tinyvm. The unit
+    // defines `tinyscript::scripts::<name>(VM&)` (see TINYSCRIPT_DECLARE_SCRIPT), which rebuilds the
+    // program and points its [compiled] entry at the generated code: each instruction becomes a few
+    // statements on the task's stack, jumps become gotos, and calls, returns and yields go through
+    // the task's frames and resume from a switch over every point they can come back to.
+    class CppEmitter {
+    public:
+        CppEmitter(const Program& program, const std::string& name);
+        
+        // Returns false, with nothing written, if some bytecode can't be translated. Only the stack
+        // encoding is supported.
+        bool emit(std::ostream& out);
+        
+        // A C++ identifier made from the file name of [path], without its extension.
+        static std::string scriptName(const std::string& path);
+    
+    private:
+        struct Instruction {
+            Opcode          code;
+            std::uint32_t   offset;
+            std::uint32_t   next;
+            std::uint8_t    slot = 0;
+            std::int64_t    operand = 0;
+            std::int64_t    target = -1;
+        };
+        
+        const Program::Function& function(std::uint32_t index) const;
+        bool decode(std::uint32_t index);
+        void emitFunction(std::ostream& out, std::uint32_t index) const;
+        void emitInstruction(std::ostream& out, std::uint32_t index, const Instruction& inst) const;
+        void emitProgram(std::ostream& out) const;
+        
+        std::string label(std::uint32_t index, std::int64_t offset) const;
+        
+        const Program&                          program_;
+        std::string                             name_;
+        std::vector<std::vector<Instruction>>   code_;
+        std::vector<std::set<std::uint32_t>>    labels_;
+        std::vector<std::set<std::uint32_t>>    resumePoints_;
+    };
+}
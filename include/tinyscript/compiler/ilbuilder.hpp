@@ -8,13 +8,16 @@
 #pragma once
 #include <iostream>
 #include <cstdint>
+#include <deque>
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
 
 #include <tinyscript/opcodes.hpp>
 #include <tinyscript/runtime/program.hpp>
 #include <tinyscript/runtime/value.hpp>
+#include <tinyscript/runtime/stringtable.hpp>
 
 namespace tinyscript {
     
@@ -31,74 +34,123 @@ namespace tinyscript {
         //void moveAddress(std::int64_t offset) { address_ += offset; }
         void nop() { code_ = Opcode::nop; complete_ = true; resolved_ = true; }
         
-        void setLabel(const std::string& label);
+        void setLabel(const std::string& label, std::uint32_t prefix = 0);
         void replaceLabel(std::uint16_t op);
+        void setBackward(bool backward);
         void setOperand8(std::uint8_t op);
         void setOperand16(std::uint16_t op);
+        void setOperand24(std::uint32_t op);
+        void remapConstant(const std::vector<std::uint8_t>& map);
+        void setCall(std::uint8_t arity, Type result) { callArity_ = arity; callType_ = result; }
+        void setSlot(std::uint8_t local);
         
         bool isComplete() const { return complete_; }
         bool isResolved() const { return resolved_; }
+        bool hasSignedOffset() const;
         //std::uint64_t address() const { return address_; }
         
         const std::string& label() const { return label_; }
         Opcode code() const { return code_; }
-        std::uint16_t operand() const { return operand_; }
+        std::uint64_t operand() const { return operand_; }
+        std::int16_t slot() const;
+        std::uint8_t callArity() const { return callArity_; }
+        bool callResult() const { return callType_ != Type::Void; }
+        Type callType() const { return callType_; }
+        void effect(int& pops, int& pushes) const;
         void write(Program::Function& function) const;
         
         std::uint64_t address;
     private:
         Opcode          code_;
-        std::uint16_t   operand_;
+        std::uint64_t   operand_;
         std::string     label_;
         bool            complete_;
         bool            resolved_;
+        std::uint8_t    callArity_ = 0;
+        Type            callType_ = Type::Void;
     };
     
     class ILFunction {
+        friend class MIRFunction;
+        friend class ControlFlowGraph;
+        friend class Inliner;
+        friend class RegisterBuilder;
+        friend class TypedBuilder;
     public:
-        ILFunction(std::uint8_t arity = 0) : arity_(arity) {}
+        ILFunction(const std::string& signature = "", std::uint8_t arity = 0) : signature_(signature), arity_(arity) {}
+        const std::string& signature() const { return signature_; }
+        void setTypes(const std::vector<Type>& paramTypes, Type returnType) { paramTypes_ = paramTypes; returnType_ = returnType; }
+        
         void addSymbol(const std::string& label);
         ILInstruction& addInstruction(Opcode code);
         ILInstruction& addInstruction(Opcode code, std::uint64_t at);
         void finishInstruction();
         void removeInstruction(std::uint64_t at);
         std::uint64_t currentLocation() const;
+        const ILInstruction* peek(std::uint64_t depth) const;
         
         std::uint8_t local(const std::string& symbol);
         std::int64_t getAddress(const std::string& label);
+        bool hasSymbol(const std::string& label) const { return symbols_.find(label) != symbols_.end(); }
+        std::int64_t symbolLocation(const std::string& label) const;
+        void removeSymbol(const std::string& label) { symbols_.erase(label); }
+        void redirectJumps(const std::string& label, const std::string& to);
         
+        void optimize(std::uint8_t level);
+        void tailCalls();
+        void markConstants(std::vector<bool>& used) const;
+        void remapConstants(const std::vector<std::uint8_t>& map);
         void resolveReferences();
+        std::uint16_t stackDepth() const;
         Program::Function build() const;
         void dump(std::ostream &out) const;
         
     private:
+        std::vector<bool> jumpTargets() const;
+        bool peephole(std::uint64_t at, const std::vector<bool>& targets);
+        void peepholePass();
         
         ILInstruction*                          current_ = nullptr;
         std::vector<std::string>                locals_;
         std::map<std::string, std::uint64_t>    symbols_;
         std::vector<ILInstruction>              il_;
         std::uint64_t                           pc_ = 0;
+        std::string                             signature_;
         std::uint8_t                            arity_ = 0;
+        std::vector<Type>                       paramTypes_;
+        Type                                    returnType_ = Type::Void;
     };
     
     class ILBuilder {
     public:
+        ILBuilder(StringTable& strings) : strings_(strings) {}
+        
         ILFunction& openFunction(const std::string& signature, std::uint8_t arity);
+        std::uint16_t function(const std::string& signature);
         ILFunction& currentFunction() { return current_ ? *current_ : script_; }
         void closeFunction();
-        void closeScript();
+        void closeScript(std::uint8_t optLevel);
         
         std::uint8_t constant(std::int64_t num);
-        std::uint8_t constant(float num);
+        std::uint8_t constant(double num);
         std::uint8_t constant(const std::string& str);
+        std::uint8_t import(const std::string& signature);
         
         void dump(std::ostream& out) const;
-        void write(Program& program) const;
+        void write(Program& program, Program::Encoding encoding = Program::Encoding::Stack) const;
         
     private:
+        void pruneConstants();
+        bool writeRegisters(Program& program) const;
+        bool writeTyped(Program& program) const;
+        
         ILFunction*                                 current_ = nullptr;
         ILFunction                                  script_;
-        std::unordered_map<std::string, ILFunction> functions_;
+        std::deque<ILFunction>                      functions_;
+        std::vector<bool>                           defined_;
+        Program::SymbolTable                        symbols_;
         std::vector<Value>                          constants_;
+        std::vector<std::string>                    imports_;
+        StringTable&                                strings_;
     };
 }
@@ -0,0 +1,44 @@
+//
+//  inliner.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/compiler/ilbuilder.hpp>
+
+namespace tinyscript {
+    
+    // Replaces calls to small script functions with a copy of their body. Callees are processed
+    // before their callers, so a function inlined somewhere already has its own calls expanded.
+    // The callee's locals become locals of the caller, shared by every call site of the same
+    // callee, and its returns jump past the copy, leaving the result on the stack.
+    class Inliner {
+    public:
+        Inliner(std::deque<ILFunction>& functions);
+        
+        void run(ILFunction& script);
+    
+    private:
+        enum class State { Pending, Visiting, Done };
+        
+        void visit(std::uint16_t index);
+        void inlineCalls(ILFunction& caller);
+        bool canInline(const ILInstruction& call, const ILFunction& caller) const;
+        void expand(const ILFunction& callee, ILFunction& caller,
+                    std::vector<ILInstruction>& il, std::map<std::string, std::uint64_t>& symbols);
+        
+        std::deque<ILFunction>&     functions_;
+        std::vector<State>          state_;
+        std::vector<bool>           recursive_;
+        std::uint64_t               siteID_ = 0;
+    };
+}
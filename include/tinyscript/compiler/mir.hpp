@@ -0,0 +1,95 @@
+//
+//  mir.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/compiler/ilbuilder.hpp>
+
+namespace tinyscript {
+    
+    // The mid-level IR rebuilds the expression trees out of a function's stack code, splits them
+    // into basic blocks and puts the function's locals in SSA form. Every version of a local
+    // keeps living in the local's slot: the passes only change which slot a tree reads from or
+    // drop trees altogether, so lowering back to IL is a walk over what's left.
+    class MIRFunction {
+    public:
+        MIRFunction(const ILFunction& function);
+        
+        bool isValid() const { return valid_; }
+        void optimize();
+        void lower(ILFunction& function) const;
+    
+    private:
+        struct Node {
+            Node(const ILInstruction& inst) : inst(inst) {}
+            
+            ILInstruction               inst;
+            std::vector<std::uint32_t>  args;
+            std::int32_t                read = -1;  // Value of the local the instruction reads
+            std::int32_t                value = -1; // Value it computes, or stores in its local
+            bool                        pure = false;
+            bool                        removed = false;
+        };
+        
+        struct Block {
+            std::vector<std::uint32_t>              roots;
+            std::vector<std::string>                labels;
+            std::vector<std::uint32_t>              preds;
+            std::vector<std::uint32_t>              succs;
+            std::map<std::uint8_t, std::int32_t>    defs;
+            std::map<std::uint8_t, std::int32_t>    entry;
+            std::map<std::uint8_t, std::int32_t>    incomplete;
+            bool                                    sealed = false;
+        };
+        
+        struct SSAValue {
+            std::int32_t                forward;
+            std::int16_t                home = -1;
+            bool                        isPhi = false;
+            std::uint32_t               block = 0;
+            std::uint8_t                slot = 0;
+            std::vector<std::int32_t>   operands;
+            std::vector<std::int32_t>   users;
+        };
+        
+        bool parse(const ILFunction& function);
+        bool parseBlock(const std::vector<ILInstruction>& il, std::uint64_t begin, std::uint64_t end, Block& block);
+        std::uint32_t addNode(const ILInstruction& inst, std::vector<std::uint32_t> args);
+        
+        void buildSSA();
+        void number(std::uint32_t block, std::uint32_t node);
+        std::int32_t newValue();
+        std::int32_t find(std::int32_t value) const;
+        std::int32_t readVariable(std::uint8_t slot, std::uint32_t block);
+        std::int32_t entryValue(std::uint8_t slot, std::uint32_t block);
+        std::int32_t addPhiOperands(std::int32_t phi);
+        std::int32_t tryRemoveTrivialPhi(std::int32_t phi);
+        void sealBlock(std::uint32_t block);
+        
+        void propagate(std::uint32_t block, std::uint32_t node, std::vector<std::int32_t>& current);
+        std::int32_t currentValue(std::uint32_t block, std::uint8_t slot, std::vector<std::int32_t>& current);
+        bool eliminateDeadStores();
+        void removeUnusedLocals();
+        void markLocals(std::uint32_t node, std::vector<bool>& used) const;
+        void emit(std::uint32_t node, std::vector<ILInstruction>& il) const;
+        
+        bool                                        valid_ = true;
+        std::uint8_t                                arity_;
+        std::uint16_t                               localCount_;
+        std::vector<Node>                           nodes_;
+        std::vector<Block>                          blocks_;
+        std::vector<SSAValue>                       values_;
+        std::vector<std::int32_t>                   undefined_;
+        std::map<std::vector<std::int64_t>, std::int32_t> numbers_;
+        std::vector<std::int16_t>                   slotMap_;
+    };
+}
@@ -0,0 +1,73 @@
+//
+//  registers.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/compiler/ilbuilder.hpp>
+#include <tinyscript/runtime/program.hpp>
+
+namespace tinyscript {
+    
+    // Lowers the stack IL of a function to register bytecode. The operand stack is only simulated:
+    // loading a local or a constant records where the value is, and the instruction consuming it
+    // reads it from there. Each stack depth has a temporary after the locals, which values are
+    // moved to when a label, jump or call needs them in place, and results stored to a local are
+    // written to it directly.
+    class RegisterBuilder {
+    public:
+        RegisterBuilder(const ILFunction& function);
+        
+        // Returns false if the operand stack doesn't have the same depth on every path reaching an
+        // instruction, or the function needs more than 255 registers.
+        bool build(Program::Function& function);
+        
+        static void dump(const Program::Function& function, std::ostream& out);
+    
+    private:
+        struct Operand {
+            enum class Kind { Register, Integer, Constant, Yes, No };
+            Kind            kind;
+            std::int64_t    value;
+        };
+        
+        struct Fixup {
+            std::uint64_t   at;
+            std::uint64_t   target;
+        };
+        
+        bool analyze();
+        void lower(std::uint64_t& at);
+        
+        std::uint8_t temporary(std::uint64_t depth);
+        std::uint8_t reg(const Operand& operand, std::uint64_t depth);
+        std::uint8_t result(std::uint64_t& at);
+        void load(std::uint8_t dst, const Operand& operand);
+        void spill(std::uint8_t slot);
+        void flush();
+        Operand pop();
+        std::uint8_t popRegister();
+        
+        void emit(RegOpcode code) { code_.push_back(static_cast<std::uint8_t>(code)); }
+        void emit8(std::uint8_t operand) { code_.push_back(operand); }
+        void emit16(std::uint16_t operand);
+        void emitJump(const ILInstruction& inst);
+        
+        const ILFunction&           function_;
+        std::vector<bool>           targets_;
+        std::vector<std::int64_t>   depth_;
+        std::vector<Operand>        stack_;
+        std::vector<std::uint8_t>   code_;
+        std::vector<std::uint64_t>  addresses_;
+        std::vector<Fixup>          fixups_;
+        std::uint64_t               registers_ = 0;
+        bool                        valid_ = true;
+    };
+}
@@ -10,6 +10,7 @@
 
 #include <tinyscript/type.hpp>
 #include <tinyscript/opcodes.hpp>
+#include <tinyscript/runtime/value.hpp>
 #include <tinyscript/compiler/codegen.hpp>
 
 namespace tinyscript {
@@ -29,6 +30,7 @@ namespace tinyscript {
             
             bool required() const { return kind_ == Kind::None; }
             void emit(CodeGen& codegen, std::uint64_t at);
+            Value fold(const Value& value) const;
         private:
             Conversion(Kind kind, const std::string& module = "", const std::string& func = "") : kind_(kind), module_(module), func_(func) {}
             Kind kind_;
@@ -38,8 +40,15 @@ namespace tinyscript {
         
         Opcode unaryInstruction(const Token& op, Type operands);
         Opcode binaryInstruction(const Token& op, Type operand);
+        Opcode immediateInstruction(Opcode code);
+        Opcode branchInstruction(Opcode test, bool condition);
         
         Conversion convert(Type source, Type target);
+        
+        // Compile-time evaluation of operators on constants. A nil result means the expression
+        // can't be folded and has to be emitted.
+        Value foldUnary(const Token& op, Type operand, const Value& value);
+        Value foldBinary(const Token& op, Type operand, const Value& lhs, const Value& rhs);
     }
 }
 
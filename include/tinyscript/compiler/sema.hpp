@@ -30,11 +30,15 @@ namespace tinyscript {
         void popScope();
         
         bool declareFunction(const Token& name, const std::vector<VarDecl>& paramTypes, Type returnType);
-        bool declareVariable(const Token& symbol, Type type);
+        bool declareVariable(const Token& symbol, Type type, const Value& constant = Value());
         
         TypeExpr getVarType(const Token& symbol);
         TypeExpr getFuncType(const Token& symbol, std::uint8_t arity);
         TypeExpr getFuncType(const Token& module, const Token& symbol, std::uint8_t arity);
+        std::vector<Type> getParamTypes(const Token& symbol, std::uint8_t arity);
+        std::vector<Type> getParamTypes(const Token& module, const Token& symbol, std::uint8_t arity);
+        
+        bool checkArgument(const Token& arg, TypeExpr type, Type param);
         
         OperatorMapping binaryOpType(const Token& op, TypeExpr lhs, TypeExpr rhs);
         void semanticError(const Token& symbol, const std::string& message) const;
@@ -44,6 +48,7 @@ namespace tinyscript {
         struct Var {
             Type type;
             Token declLocation;
+            Value constant;
         };
         
         struct Func {
@@ -0,0 +1,73 @@
+//
+//  typed.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/type.hpp>
+#include <tinyscript/compiler/ilbuilder.hpp>
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/value.hpp>
+
+namespace tinyscript {
+    
+    // Lowers the stack IL of a function to typed bytecode, which uses the same instructions but
+    // runs on untagged slots. The type of every operand and local is worked out from the IL, and
+    // string references are made explicit: copies of a string are retained, a store releases the
+    // string it replaces, and strings nothing consumes are released before returning.
+    class TypedBuilder {
+    public:
+        TypedBuilder(const ILFunction& function,
+                     const std::vector<Value>& constants,
+                     const std::vector<std::string>& imports);
+        
+        // Foreign calls are remapped to entries of [imports] and [importTypes], one for each
+        // import and argument types it is called with. Returns false if a slot or operand doesn't
+        // have the same type on every path reaching an instruction.
+        bool build(Program::Function& function,
+                   std::vector<std::string>& imports,
+                   std::vector<std::vector<Type>>& importTypes);
+        
+        static void dump(const Program::Function& function, std::ostream& out);
+    
+    private:
+        using Stack = std::vector<Type>;
+        
+        struct Fixup {
+            std::uint64_t   at;
+            std::uint64_t   target;
+            bool            isSigned;
+        };
+        
+        bool analyze();
+        bool step(const ILInstruction& inst, Stack& stack);
+        bool setLocal(std::uint64_t slot, Type type);
+        Type local(std::uint64_t slot) const;
+        
+        bool lower(const ILInstruction& inst, const Stack& stack,
+                   std::vector<std::string>& imports,
+                   std::vector<std::vector<Type>>& importTypes);
+        void cleanup(const Stack& stack);
+        
+        void emit(Opcode code) { code_.push_back(static_cast<std::uint8_t>(code)); }
+        void emitOperand(std::uint64_t operand, std::uint64_t size);
+        
+        const ILFunction&           function_;
+        const std::vector<Value>&   constants_;
+        const std::vector<std::string>& imports_;
+        std::vector<Type>           locals_;
+        std::vector<Stack>          stacks_;
+        std::vector<bool>           reached_;
+        std::vector<std::uint8_t>   code_;
+        std::vector<std::uint64_t>  addresses_;
+        std::vector<Fixup>          fixups_;
+    };
+}
@@ -8,9 +8,11 @@
 #pragma once
 #include <cassert>
 #include <cstdint>
+#include <utility>
 
 #include <tinyscript/type.hpp>
 #include <tinyscript/compiler/token.hpp>
+#include <tinyscript/runtime/value.hpp>
 
 namespace tinyscript {
     
@@ -19,18 +21,39 @@ namespace tinyscript {
         
         TypeExpr(Type type) : type_(type), isLvalue_(false) {}
         TypeExpr(Type type, const Token& var) : type_(type), isLvalue_(true), variable_(var) {}
+        TypeExpr(Type type, const Value& constant) : type_(type), isLvalue_(false), constant_(constant) {}
+        TypeExpr(Type type, Value&& constant) : type_(type), isLvalue_(false), constant_(std::move(constant)) {}
         
-        TypeExpr(const TypeExpr& other) : type_(other.type_), isLvalue_(other.isLvalue_), variable_(other.variable_) {}
+        TypeExpr(const TypeExpr& other)
+            : type_(other.type_), isLvalue_(other.isLvalue_), variable_(other.variable_), constant_(other.constant_) {}
         TypeExpr& operator=(const TypeExpr& other) {
             if(this != &other) {
                 type_ = other.type_;
                 isLvalue_ = other.isLvalue_;
                 variable_ = other.variable_;
+                constant_ = other.constant_;
+            }
+            return *this;
+        }
+        
+        TypeExpr(TypeExpr&& other)
+            : type_(other.type_), isLvalue_(other.isLvalue_), variable_(other.variable_), constant_(std::move(other.constant_)) {}
+        TypeExpr& operator=(TypeExpr&& other) {
+            if(this != &other) {
+                type_ = other.type_;
+                isLvalue_ = other.isLvalue_;
+                variable_ = other.variable_;
+                constant_ = std::move(other.constant_);
             }
             return *this;
         }
         
         void setLValue(const Token& var) { isLvalue_ = true; variable_ = var; }
+        void setConstant(const Value& constant) { constant_ = constant; }
+        
+        // Expressions whose value is known at compile time carry it, so operators can be folded.
+        bool isConstant() const { return constant_.kind != Value::Kind::Nil; }
+        const Value& constant() const { return constant_; }
         
         const Token& lvalue() const {
             assert(isLvalue_ && "type isn't an l-value");
@@ -46,6 +69,7 @@ namespace tinyscript {
         Type type_;
         bool isLvalue_;
         Token variable_;
+        Value constant_;
     };
     
     static inline bool qualifiedEq(const TypeExpr& a, const TypeExpr& b) {
@@ -17,9 +17,21 @@ namespace tinyscript {
     };
 #undef OPCODE
     
+    // Instructions of the register encoding (see Program::Encoding).
+#define REGOP(name, _) name,
+    enum class RegOpcode {
+#include <tinyscript/x-regops.hpp>
+    };
+#undef REGOP
+    
     std::string mnemonic(Opcode code);
     int stackEffect(Opcode code);
     int operandSize(Opcode code);
+    Opcode invertedBranch(Opcode code);
+    
+    std::string mnemonic(RegOpcode code);
+    int operandSize(RegOpcode code);
 }
 
 std::ostream& operator<<(std::ostream& oit, tinyscript::Opcode code);
+std::ostream& operator<<(std::ostream& out, tinyscript::RegOpcode code);
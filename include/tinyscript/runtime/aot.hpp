@@ -0,0 +1,71 @@
+//
+//  aot.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <tinyscript/type.hpp>
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/task.hpp>
+#include <tinyscript/runtime/value.hpp>
+#include <tinyscript/runtime/vm.hpp>
+
+namespace tinyscript {
+    
+    // Runtime support for the C++ translation units written by `tinyscript --emit-cpp`. Generated
+    // code runs on the task's own stack and frames, saving the program counter the interpreter would
+    // have at each call and yield. When the task is resumed, or a call returns, the function and
+    // bytecode offset of the frame on top select the label to jump back to: that [point] is the
+    // state of a single state machine covering every function of the program. Backward jumps and
+    // calls are checkpoints, like in the interpreter, and the targets of the jumps are resume points.
+    class AOT {
+    public:
+        using Result = std::pair<VM::Result, Value>;
+        
+        // Functions are numbered from 1, 0 being the top-level script.
+        static constexpr std::uint64_t point(std::uint32_t function, std::uint32_t offset) {
+            return (static_cast<std::uint64_t>(function) << 32) | offset;
+        }
+        static std::uint64_t resumePoint(const Task& task);
+        
+        static const Program& program(const Task& task) { return task.program_; }
+        static Value* stack(const Task& task) { return task.sp_; }
+        static Value* base(const Task& task) { return task.fp_[-1].base; }
+        static void save(Task& task, const std::uint8_t* ip, Value* sp) { task.ip_ = ip; task.sp_ = sp; }
+        
+        static Value* callForeign(VM& vm, Task& task, const VM::Function& func, const std::uint8_t* ip, Value* sp);
+        static Result error(const std::string& message) { return std::make_pair(VM::Result::Error, Value(message)); }
+        
+        static bool preempted(Task& task) { return task.budget_-- == 0 && (task.budget_ = task.extension()) == 0; }
+        static Result preempt() { return std::make_pair(VM::Result::Preempted, Value()); }
+    };
+    
+    inline std::uint64_t AOT::resumePoint(const Task& task) {
+        const auto* function = task.fp_[-1].function;
+        const auto& program = task.program_;
+        std::uint32_t index = function == &program.script ? 0 : (function - program.functions.data()) + 1;
+        return point(index, static_cast<std::uint32_t>(task.ip_ - function->bytecode.data()));
+    }
+    
+    inline Value* AOT::callForeign(VM& vm, Task& task, const VM::Function& func, const std::uint8_t* ip, Value* sp) {
+        if(func.native) {
+            Value* args = sp - func.arity;
+            func.native(vm, args);
+            return args + (func.returnType != Type::Void);
+        }
+        save(task, ip, sp);
+        func.code(vm, task);
+        return task.sp_;
+    }
+}
+
+// Declares the function defined by a script translated to C++, which builds the script's Program
+// and links it against [vm]. Tasks run it like any other program.
+#define TINYSCRIPT_DECLARE_SCRIPT(name) \
+    namespace tinyscript { namespace scripts { Program name(VM& vm); } }
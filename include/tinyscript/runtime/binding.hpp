@@ -0,0 +1,91 @@
+//
+//  binding.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tinyscript/type.hpp>
+#include <tinyscript/runtime/value.hpp>
+
+namespace tinyscript {
+    class VM;
+    
+    namespace binding {
+        
+        // Marshal<T> gives the script type of a C++ type, and converts between it and stack values.
+        template <typename T, typename = void>
+        struct Marshal;
+        
+        template <>
+        struct Marshal<void> {
+            static constexpr Type type = Type::Void;
+        };
+        
+        template <>
+        struct Marshal<bool> {
+            static constexpr Type type = Type::Bool;
+            static bool get(const Value& value) { return value.asBool(); }
+            static Value make(bool value) { return Value::boolean(value); }
+        };
+        
+        template <typename T>
+        struct Marshal<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+            static constexpr Type type = Type::Integer;
+            static T get(const Value& value) { return static_cast<T>(value.asInt()); }
+            static Value make(T value) { return Value::Integer(static_cast<std::int64_t>(value)); }
+        };
+        
+        template <typename T>
+        struct Marshal<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+            static constexpr Type type = Type::Number;
+            static T get(const Value& value) { return static_cast<T>(value.asNumber()); }
+            static Value make(T value) { return Value::Float(static_cast<double>(value)); }
+        };
+        
+        template <>
+        struct Marshal<std::string> {
+            static constexpr Type type = Type::String;
+            static const std::string& get(const Value& value) { return value.asString(); }
+            static Value make(std::string value) { return Value(std::move(value)); }
+        };
+        
+        template <typename T>
+        using Arg = Marshal<std::decay_t<T>>;
+        
+        // Binding<&func> works out the script signature of a C++ function at compile time, and
+        // provides a trampoline that reads the arguments straight from the caller's stack window and
+        // writes the result over the first one.
+        template <auto Func>
+        struct Binding;
+        
+        template <typename R, typename... Args, R (*Func)(Args...)>
+        struct Binding<Func> {
+            static constexpr std::uint8_t arity = sizeof...(Args);
+            static constexpr Type returnType = Arg<R>::type;
+            
+            static std::vector<Type> paramTypes() { return {Arg<Args>::type...}; }
+            
+            static void call(VM& vm, Value* args) {
+                invoke(args, std::index_sequence_for<Args...>{});
+            }
+            
+        private:
+            template <std::size_t... I>
+            static void invoke([[maybe_unused]] Value* args, std::index_sequence<I...>) {
+                if constexpr(std::is_void_v<R>) {
+                    Func(Arg<Args>::get(args[I])...);
+                } else {
+                    args[0] = Arg<R>::make(Func(Arg<Args>::get(args[I])...));
+                }
+            }
+        };
+    }
+}
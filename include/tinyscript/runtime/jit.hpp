@@ -0,0 +1,40 @@
+//
+//  jit.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+
+namespace tinyscript {
+    class Program;
+    
+    // Baseline compiler from function bytecode to x86-64 machine code (Linux only). Values stay
+    // unboxed: integers, reals (as their bit pattern) and booleans are all passed around as a
+    // single machine word, and the static types are only needed to box and unbox them at the
+    // boundary with the interpreter. Functions that use strings, foreign calls, yield or more than
+    // [maxArity] parameters are left to the interpreter, as are the functions that call them.
+    class JIT {
+    public:
+        // [error] is set when the call stack overflowed, in which case [value] is meaningless.
+        struct Result {
+            std::uint64_t value;
+            std::uint64_t error;
+        };
+        
+        // Native functions take the number of call frames they may still use, then their
+        // arguments. Extra arguments are ignored.
+        using Entry = Result (*)(std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t);
+        
+        static constexpr std::uint8_t maxArity = 5;
+        
+        static bool isAvailable();
+        
+        // Compiles every function of [program] it can, and fills program.native and program.bounded.
+        // Returns the number of functions compiled, which is 0 for programs in the register or typed
+        // encoding.
+        static std::uint32_t compile(Program& program);
+    };
+}
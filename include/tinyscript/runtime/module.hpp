@@ -11,7 +11,9 @@
 #include <functional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <tinyscript/type.hpp>
+#include <tinyscript/runtime/binding.hpp>
 #include <tinyscript/runtime/vm.hpp>
 #include <tinyscript/runtime/value.hpp>
 
@@ -19,6 +21,8 @@ namespace tinyscript {
 
     class Task;
     
+    // Functions added to a module run on whichever thread runs the calling task, and have to be
+    // thread-safe when tasks run on a ThreadPool.
     class Module {
     public:
         
@@ -28,6 +32,15 @@ namespace tinyscript {
         Module(const std::string& name) : name_(name) {}
         
         void addFunction(const std::string& symbol, uint8_t arity, Type returnType, VM::Foreign func);
+        void addFunction(const std::string& symbol, Type returnType, const std::vector<Type>& params, VM::Native func);
+        
+        // Binds a plain C++ function, e.g. `module.bind<&myFunc>("name")`. Arity, parameter and
+        // return types are deduced from its signature.
+        template <auto Func>
+        void bind(const std::string& symbol) {
+            using B = binding::Binding<Func>;
+            addFunction(symbol, B::returnType, B::paramTypes(), &B::call);
+        }
         void addVariable(const std::string& symbol, const Value& value);
         
         const std::string& name() const { return name_; }
@@ -7,25 +7,79 @@
 //
 #pragma once
 #include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
+#include <tinyscript/type.hpp>
+#include <tinyscript/runtime/jit.hpp>
 #include <tinyscript/runtime/value.hpp>
+#include <tinyscript/runtime/vm.hpp>
 
 namespace tinyscript {
     class Program {
     public:
+        // Stack bytecode runs on an operand stack above each frame's locals (x-opcodes.hpp). In
+        // the register encoding (x-regops.hpp), the locals are followed by the temporaries the
+        // operand stack would have used, and every instruction names the slots it reads and writes.
+        // [variableCount] covers both. Typed programs use the stack instructions on untagged slots
+        // (see Slot), with the ownership of strings made explicit by the compiler.
+        enum class Encoding { Stack, Registers, Typed };
+        
         struct Function {
             std::uint8_t                variableCount;
             std::uint8_t                arity;
             std::vector<std::uint8_t>   bytecode;
+            std::vector<Type>           paramTypes;
+            Type                        returnType = Type::Void;
+            
+            // Typed encoding: the locals holding strings, released when the frame is popped.
+            std::vector<std::uint8_t>   strings;
+            
+            // The most operands the function has on the stack above its locals at once; a frame
+            // needs [variableCount] + [stackDepth] slots. Always 0 in the register encoding.
+            std::uint16_t               stackDepth = 0;
         };
         
-        using FunctionTable = std::unordered_map<std::string, Function>;
+        using FunctionTable = std::vector<Function>;
+        using SymbolTable = std::unordered_map<std::string, std::uint16_t>;
         
+        // call_n operands are indices into [functions]; [symbols] maps mangled names to those indices
+        // for the host.
+        Encoding                    encoding = Encoding::Stack;
         Function                    script;
         FunctionTable               functions;
+        SymbolTable                 symbols;
         std::vector<Value>          constants;
+        
+        // call_f operands index into the program's import table. VM::link() resolves each imported
+        // signature once, so calls are a single indexed load from [foreign].
+        std::vector<std::string>            imports;
+        std::vector<const VM::Function*>    foreign;
+        const VM*                           linkedVM = nullptr;
+        
+        // Typed encoding: the types of the arguments passed to each import, which are boxed into
+        // Values for the call. An import called with different types has an entry for each.
+        std::vector<std::vector<Type>>      importTypes;
+        
+        // Entry points of the functions JIT::compile() turned into machine code, indexed like
+        // [functions]. call_n runs functions without one (or all of them, if [native] is empty) in
+        // the interpreter. [nativeCode] keeps the executable memory alive.
+        std::vector<JIT::Entry>             native;
+        std::shared_ptr<const void>         nativeCode;
+        
+        // [native] without the functions that loop or call, so that the others can't keep a task
+        // from being preempted. Runs with a budget or deadline use this instead, and interpret the
+        // functions it leaves out.
+        std::vector<JIT::Entry>             bounded;
+        
+        // Set by programs translated to C++ (`tinyscript --emit-cpp`): VM::run() hands tasks over to
+        // [compiled] instead of interpreting the bytecode, which still provides the return addresses
+        // saved in call frames.
+        using Compiled = std::pair<VM::Result, Value> (*)(VM& vm, Task& task);
+        Compiled                            compiled = nullptr;
+
         std::vector<std::uint8_t>   bytecode;
         std::uint16_t               variableCount;
     };
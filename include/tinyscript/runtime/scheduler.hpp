@@ -0,0 +1,65 @@
+//
+//  scheduler.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/task.hpp>
+#include <tinyscript/runtime/value.hpp>
+#include <tinyscript/runtime/vm.hpp>
+
+namespace tinyscript {
+    
+    // Runs any number of tasks on one VM, round-robin. Each tick resumes the tasks at the front of
+    // the run queue: the ones that yield or are preempted go to the back of it, and the ones that
+    // return or fail are destroyed once the exit handler has seen them.
+    class Scheduler {
+    public:
+        using YieldHandler = std::function<void(Task&, const Value&)>;
+        using ExitHandler = std::function<void(Task&, VM::Result, const Value&)>;
+        
+        Scheduler(VM& vm) : vm_(vm) {}
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+        
+        Task& spawn(const Program& program, std::uint32_t stackSize = 256, std::uint32_t frameCount = 64);
+        Task& spawn(std::unique_ptr<Task> task);
+        
+        // Resumes every task in the run queue once, or at most [count] of them, and returns how many
+        // were. Tasks spawned during a tick first run on the next one.
+        std::size_t tick();
+        std::size_t tick(std::size_t count);
+        
+        // Ticks until every task has returned or failed.
+        void run();
+        
+        // Checkpoints each resume may go through before the task is preempted (see VM::run). 0, the
+        // default, lets tasks run until they yield.
+        void setBudget(std::uint64_t budget) { budget_ = budget; }
+        
+        void onYield(YieldHandler handler) { onYield_ = std::move(handler); }
+        void onExit(ExitHandler handler) { onExit_ = std::move(handler); }
+        
+        std::size_t size() const { return ready_.size(); }
+        bool empty() const { return ready_.empty(); }
+        
+        // Number of times a task was resumed since the scheduler was created.
+        std::uint64_t resumes() const { return resumes_; }
+    
+    private:
+        VM&                                 vm_;
+        std::deque<std::unique_ptr<Task>>   ready_;
+        YieldHandler                        onYield_;
+        ExitHandler                         onExit_;
+        std::uint64_t                       budget_ = 0;
+        std::uint64_t                       resumes_ = 0;
+    };
+}
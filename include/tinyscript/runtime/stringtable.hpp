@@ -0,0 +1,36 @@
+//
+//  stringtable.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <tinyscript/runtime/value.hpp>
+
+namespace tinyscript {
+    
+    // Stores a single copy of every string interned through it. Interned strings from the same table
+    // compare by identity, which makes string equality between constants O(1). Foreign functions may
+    // intern strings from any thread running a task. The table owns its strings and deletes them
+    // when it is destroyed, whatever still refers to them.
+    class StringTable {
+    public:
+        StringTable() = default;
+        StringTable(const StringTable&) = delete;
+        StringTable& operator=(const StringTable&) = delete;
+        ~StringTable();
+        
+        Value intern(const std::string& str);
+        std::size_t size() const;
+        
+    private:
+        mutable std::mutex                                  mutex_;
+        std::unordered_map<std::string_view, StringObject*> strings_;
+    };
+}
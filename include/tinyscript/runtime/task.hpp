@@ -8,8 +8,10 @@
 
 #pragma once
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <random>
 #include <string>
 
 #include <tinyscript/opcodes.hpp>
@@ -20,13 +22,23 @@ namespace tinyscript {
     class Task {
     public:
         friend class VM;
+        friend class AOT;
         
-        Task(const Program& program, std::uint32_t stackSize);
+        Task(const Program& program, std::uint32_t stackSize, std::uint32_t frameCount = 64);
         Task(const Program& program, Task* caller, const std::string& function);
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
         ~Task();
         
         const Task* caller() const { return caller_; }
         
+        // The task the calling thread is running, if any, which is how foreign functions reach the
+        // task that called them.
+        static Task* running() { return running_; }
+        
+        // The generator the Random module draws from. Each task starts from its own seed.
+        std::minstd_rand& random() { return random_; }
+        
         // MARK: - Stack Management
         
         void push(const Value& value);
@@ -48,27 +60,61 @@ namespace tinyscript {
         
         // MARK: - Stack Management
         
-        void pushFrame(const Program::Function& func);
-        void pushFrame(const std::string& name);
+        bool pushFrame(const Program::Function& func);
+        bool pushFrame(const std::string& name);
         bool popFrame();
         bool returnFrame();
+        bool tailFrame(const Program::Function& func);
+        
+        // Frames of typed programs, whose locals and operands live in [slots_]. The string locals
+        // of a frame are cleared when it is pushed, and released when it is popped.
+        bool pushTypedFrame(const Program::Function& func);
+        bool popTypedFrame();
+        bool returnTypedFrame();
+        bool tailTypedFrame(const Program::Function& func);
         
     private:
         struct Frame {
-            const Program::Function&    function;
-            std::uint64_t               callerIP;
+            const Program::Function*    function;
+            const std::uint8_t*         callerIP;
             Value*                      base;
             Value*                      stack;
+            Slot*                       slots;
         };
         
+        static void releaseStrings(const Frame& frame);
+        static std::uint32_t nextSeed();
+        
+        // Set by VM::run for the duration of a run.
+        static thread_local Task* running_;
+        
+        // Called by the interpreters when the budget of checkpoints (backward jumps and calls) they
+        // were given ran out, and returns the checkpoints left, 0 once the task should be preempted.
+        // A task run with a deadline gets another [clockInterval] until it has passed, which is the
+        // only time the clock is read.
+        static constexpr std::uint64_t clockInterval = 1024;
+        std::uint64_t extension() const;
+        
         const Program&      program_;
         const std::uint32_t stackSize_;
+        const std::uint32_t frameCount_;
         const Task*         caller_ = nullptr;
+        std::minstd_rand    random_;
         
         Value*              stack_;
         Value*              sp_;
-        std::vector<Frame>  callStack_;
-        std::uint64_t       ip_ = 0;
+        Frame*              frames_;
+        Frame*              fp_;
+        const std::uint8_t* ip_ = nullptr;
+        
+        // Set by VM::run for the duration of a run.
+        std::uint64_t                           budget_ = 0;
+        bool                                    timed_ = false;
+        std::chrono::steady_clock::time_point   deadline_;
+        
+        // Typed programs only use [stack_] to pass arguments to foreign functions.
+        Slot*               slots_ = nullptr;
+        Slot*               ssp_ = nullptr;
     };
     
     inline void Task::push(const Value& value) {
@@ -86,21 +132,19 @@ namespace tinyscript {
     }
     
     inline Opcode Task::next() {
-        assert(callStack_.size() > 0 && "No function on call stack");
-        return static_cast<Opcode>(callStack_.back().function.bytecode[ip_++]);
+        assert(ip_ && "No function on call stack");
+        return static_cast<Opcode>(*(ip_++));
     }
     
     inline std::uint8_t Task::read8() {
-        assert(callStack_.size() > 0 && "No function on call stack");
-        const auto& bytecode = callStack_.back().function.bytecode;
-        return bytecode[ip_++];
+        assert(ip_ && "No function on call stack");
+        return *(ip_++);
     }
     
     inline std::uint16_t Task::read16() {
-        assert(callStack_.size() > 0 && "No function on call stack");
+        assert(ip_ && "No function on call stack");
         ip_ += 2;
-        const auto& bytecode = callStack_.back().function.bytecode;
-        return (bytecode[ip_-2] << 8) | (bytecode[ip_-1]);
+        return (ip_[-2] << 8) | (ip_[-1]);
     }
     
     inline std::uint32_t Task::stackSize() const {
@@ -112,12 +156,119 @@ namespace tinyscript {
     }
     
     inline void Task::load() {
-        assert(callStack_.size() > 0 && "No function on call stack");
-        push(callStack_.back().base[read8()]);
+        assert(fp_ > frames_ && "No function on call stack");
+        push(fp_[-1].base[read8()]);
     }
     
     inline void Task::store() {
-        assert(callStack_.size() > 0 && "No function on call stack");
-        callStack_.back().base[read8()] = pop();
+        assert(fp_ > frames_ && "No function on call stack");
+        fp_[-1].base[read8()] = pop();
+    }
+    
+    // Frames live in a fixed array allocated with the task: calls never reallocate, and overflowing
+    // it is reported to the caller instead of growing the call stack. The same goes for the value
+    // stack, which must hold the callee's locals and the deepest its operand stack gets, so that
+    // the interpreters never have to check pushes.
+    inline bool Task::pushFrame(const Program::Function& func) {
+        if(fp_ == frames_ + frameCount_) return false;
+        auto* base = sp_ - func.arity;
+        auto* stack = base + func.variableCount;
+        if(stack + func.stackDepth > stack_ + stackSize_) return false;
+        *(fp_++) = Frame{&func, ip_, base, stack};
+        ip_ = func.bytecode.data();
+        sp_ = stack;
+        return true;
+    }
+    
+    inline bool Task::popFrame() {
+        assert(fp_ > frames_ && "Call stack underflow");
+        --fp_;
+        ip_ = fp_->callerIP;
+        sp_ = fp_->base;
+        return fp_ == frames_;
+    }
+    
+    inline bool Task::returnFrame() {
+        assert(fp_ > frames_ && "Call stack underflow");
+        Value* ret = sp_ - 1;
+        --fp_;
+        ip_ = fp_->callerIP;
+        sp_ = fp_->base;
+        *(sp_++) = std::move(*ret);
+        return fp_ == frames_;
+    }
+    
+    // Tail calls move the arguments down to the current frame's locals, which the caller doesn't
+    // need anymore, and the callee returns straight to the caller's caller.
+    inline bool Task::tailFrame(const Program::Function& func) {
+        assert(fp_ > frames_ && "No function on call stack");
+        auto& frame = fp_[-1];
+        if(frame.base + func.variableCount + func.stackDepth > stack_ + stackSize_) return false;
+        auto* args = sp_ - func.arity;
+        for(std::uint8_t i = 0; i < func.arity; ++i) {
+            frame.base[i] = std::move(args[i]);
+        }
+        frame.function = &func;
+        frame.stack = frame.base + func.variableCount;
+        ip_ = func.bytecode.data();
+        sp_ = frame.stack;
+        return true;
+    }
+    
+    inline bool Task::pushTypedFrame(const Program::Function& func) {
+        if(fp_ == frames_ + frameCount_) return false;
+        auto* slots = ssp_ - func.arity;
+        if(slots + func.variableCount + func.stackDepth > slots_ + stackSize_) return false;
+        for(auto slot: func.strings) {
+            if(slot >= func.arity) slots[slot].stringValue = nullptr;
+        }
+        *(fp_++) = Frame{&func, ip_, nullptr, nullptr, slots};
+        ip_ = func.bytecode.data();
+        ssp_ = slots + func.variableCount;
+        return true;
+    }
+    
+    inline void Task::releaseStrings(const Frame& frame) {
+        for(auto slot: frame.function->strings) {
+            if(auto* string = frame.slots[slot].stringValue) string->release();
+        }
+    }
+    
+    inline bool Task::popTypedFrame() {
+        assert(fp_ > frames_ && "Call stack underflow");
+        --fp_;
+        releaseStrings(*fp_);
+        ip_ = fp_->callerIP;
+        ssp_ = fp_->slots;
+        return fp_ == frames_;
+    }
+    
+    inline bool Task::returnTypedFrame() {
+        assert(fp_ > frames_ && "Call stack underflow");
+        Slot ret = ssp_[-1];
+        --fp_;
+        releaseStrings(*fp_);
+        ip_ = fp_->callerIP;
+        ssp_ = fp_->slots;
+        *(ssp_++) = ret;
+        return fp_ == frames_;
+    }
+    
+    inline bool Task::tailTypedFrame(const Program::Function& func) {
+        assert(fp_ > frames_ && "No function on call stack");
+        auto& frame = fp_[-1];
+        if(frame.slots + func.variableCount + func.stackDepth > slots_ + stackSize_) return false;
+        releaseStrings(frame);
+        auto* args = ssp_ - func.arity;
+        for(std::uint8_t i = 0; i < func.arity; ++i) {
+            frame.slots[i] = args[i];
+        }
+        for(auto slot: func.strings) {
+            if(slot >= func.arity) frame.slots[slot].stringValue = nullptr;
+        }
+        frame.function = &func;
+        ip_ = func.bytecode.data();
+        ssp_ = frame.slots + func.variableCount;
+        return true;
     }
 }
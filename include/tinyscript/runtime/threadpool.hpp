@@ -0,0 +1,96 @@
+//
+//  threadpool.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/scheduler.hpp>
+#include <tinyscript/runtime/task.hpp>
+#include <tinyscript/runtime/vm.hpp>
+
+namespace tinyscript {
+    
+    // Runs tasks on worker threads sharing one VM. Each worker has its own deque of ready tasks: it
+    // resumes the one at the front, and puts it back at the end when it yields or is preempted, so
+    // workers only contend when one of them runs dry and steals from the back of another's deque.
+    // Handlers are called on the worker that ran the task, and have to be thread-safe.
+    class ThreadPool {
+    public:
+        using YieldHandler = Scheduler::YieldHandler;
+        using ExitHandler = Scheduler::ExitHandler;
+        
+        ThreadPool(VM& vm, unsigned threads = std::thread::hardware_concurrency());
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        
+        // Stops the workers once their current task returns, yields or is preempted. Tasks that
+        // didn't finish are destroyed.
+        ~ThreadPool();
+        
+        // Tasks are handed out to the workers in turn.
+        void spawn(const Program& program, std::uint32_t stackSize = 256, std::uint32_t frameCount = 64);
+        void spawn(std::unique_ptr<Task> task);
+        
+        // Blocks until every task spawned so far has returned or failed.
+        void wait();
+        
+        // Handlers and budget (see Scheduler) must be set before the first task is spawned.
+        void setBudget(std::uint64_t budget) { budget_ = budget; }
+        void onYield(YieldHandler handler) { onYield_ = std::move(handler); }
+        void onExit(ExitHandler handler) { onExit_ = std::move(handler); }
+        
+        std::size_t threads() const { return workers_.size(); }
+        
+        // Totals over every worker, only exact once wait() returned.
+        std::uint64_t resumes() const;
+        std::uint64_t steals() const;
+    
+    private:
+        // Workers are aligned to cache lines, so that the ones running don't touch each other's.
+        // [size] mirrors the size of the deque for thieves, which only lock deques that have tasks.
+        struct alignas(64) Worker {
+            std::mutex                          mutex;
+            std::deque<std::unique_ptr<Task>>   ready;
+            std::atomic<std::size_t>            size{0};
+            std::atomic<std::uint64_t>          resumes{0};
+            std::atomic<std::uint64_t>          steals{0};
+            std::size_t                         index;
+            std::thread                         thread;
+        };
+        
+        void work(Worker& self);
+        std::unique_ptr<Task> take(Worker& self);
+        std::size_t push(Worker& worker, std::unique_ptr<Task> task);
+        bool queued() const;
+        void wakeOne();
+        
+        VM&                                     vm_;
+        std::vector<std::unique_ptr<Worker>>    workers_;
+        std::uint64_t                           budget_ = 0;
+        YieldHandler                            onYield_;
+        ExitHandler                             onExit_;
+        
+        // Workers sleep when every deque is empty, and wait() until no task is [live_]. Workers
+        // adding to their deque only wake a sleeping one when there's more than they can run.
+        std::mutex                              mutex_;
+        std::condition_variable                 wake_;
+        std::condition_variable                 done_;
+        std::atomic<std::uint32_t>              sleeping_{0};
+        std::atomic<std::uint64_t>              live_{0};
+        std::atomic<std::size_t>                next_{0};
+        std::atomic<bool>                       stopping_{false};
+    };
+}
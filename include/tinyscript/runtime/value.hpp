@@ -6,90 +6,162 @@
 //  Copyright © 2018 Amy Parent. All rights reserved.
 //
 #pragma once
+#include <atomic>
 #include <cstdint>
 #include <string>
-#include <memory>
+#include <utility>
+
+#include <tinyscript/type.hpp>
 
 namespace tinyscript {
+    class StringTable;
+    
+    // Strings are immutable and shared between every Value that holds them: copying a string value
+    // only bumps the reference count of its StringObject. Strings made at runtime are only ever used
+    // by one task at a time, so the count doesn't need to be atomic.
+    //
+    // Interned strings, which include every constant, belong to their table instead, so that tasks
+    // running on different threads can share them without touching the count. The table deletes
+    // them with the VM: programs, tasks and values must not outlive it. A debug build of the library
+    // has its tables count references to their strings in [references_], atomically, so that they
+    // can assert that nothing does. Neither the layout nor retain() and release() depend on NDEBUG,
+    // so code built with and without it can share strings.
+    class StringObject {
+    public:
+        friend class StringTable;
+        
+        static StringObject* create(std::string value) { return new StringObject(std::move(value)); }
+        
+        void retain() {
+            if(!table_) ++refCount_;
+            else if(references_.load(std::memory_order_relaxed)) references_.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        void release() {
+            if(!table_) {
+                if(--refCount_ == 0) delete this;
+            }
+            else if(references_.load(std::memory_order_relaxed)) references_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        
+        std::uint32_t refCount() const { return refCount_; }
+        const std::string& str() const { return value_; }
+        const StringTable* table() const { return table_; }
+        
+        // Two strings interned in the same table are equal only if they are the same object.
+        static bool equal(const StringObject* a, const StringObject* b) {
+            if(a == b) return true;
+            if(a->table_ && a->table_ == b->table_) return false;
+            return a->value_ == b->value_;
+        }
+        
+    private:
+        StringObject(std::string value) : refCount_(1), value_(std::move(value)) {}
+        
+        // Tables only count references when they start [references_] at 1, for their own.
+        std::uint32_t               refCount_;
+        std::atomic<std::uint32_t>  references_{0};
+        const StringTable*          table_ = nullptr;
+        const std::string   value_;
+    };
+    
+    // Typed programs (Program::Encoding::Typed) run on untagged slots, whose type the compiler
+    // guarantees. A slot holding a string owns a reference to it, or is null.
+    union Slot {
+        bool            boolValue;
+        std::int64_t    intValue;
+        double          floatValue;
+        StringObject*   stringValue;
+    };
+    
     struct Value {
-        enum class Kind { Nil, Bool, Int, Number, String };
+        enum class Kind : std::uint8_t { Nil, Bool, Int, Number, String };
         Kind kind;
         
-        Value() : kind(Kind::Nil) {}
-        explicit Value(const std::string& value) : kind(Kind::String) {
-            new (&stringValue) std::string{value};
-        }
+        Value() : kind(Kind::Nil), intValue(0) {}
+        explicit Value(std::string value) : kind(Kind::String), stringValue(StringObject::create(std::move(value))) {}
+        explicit Value(StringObject* object) : kind(Kind::String), stringValue(object) { object->retain(); }
         
         static Value Float(double value);
         static Value Integer(std::int64_t value);
         static Value boolean(bool value);
         
-        Value(const Value& other) : kind(other.kind) {
-            switch(kind) {
-                case Kind::String: new (&stringValue) std::string{other.stringValue}; break;
-                case Kind::Bool: boolValue = other.boolValue; break;
-                case Kind::Int: intValue = other.intValue; break;
-                case Kind::Number: floatValue = other.floatValue; break;
-                default: break;
-            }
+        Value(const Value& other) : kind(other.kind), intValue(other.intValue) {
+            retain();
+        }
+        
+        Value(Value&& other) : kind(other.kind), intValue(other.intValue) {
+            other.kind = Kind::Nil;
         }
         
         Value& operator=(const Value& other) {
             if(this != &other) {
-                destroy();
+                other.retain();
+                release();
                 kind = other.kind;
-                
-                switch(kind) {
-                    case Kind::String: new (&stringValue) std::string{other.stringValue}; break;
-                    case Kind::Bool: boolValue = other.boolValue; break;
-                    case Kind::Int: intValue = other.intValue; break;
-                    case Kind::Number: floatValue = other.floatValue; break;
-                    default: break;
-                }
+                intValue = other.intValue;
             }
             return *this;
         }
         
-        ~Value() { destroy(); }
+        Value& operator=(Value&& other) {
+            if(this != &other) {
+                release();
+                kind = other.kind;
+                intValue = other.intValue;
+                other.kind = Kind::Nil;
+            }
+            return *this;
+        }
+        
+        ~Value() { release(); }
+        
+        // Manual ownership control for the string a value points to. Values manage their own
+        // reference counts; these are only needed when a string must outlive every Value holding it.
+        void retain() const { if(kind == Kind::String) stringValue->retain(); }
+        void release() const { if(kind == Kind::String) stringValue->release(); }
         
         bool asBool() const;
         double asNumber() const;
         std::int64_t asInt() const;
         const std::string& asString() const;
         std::string repr() const;
-    private:
         
-        void destroy() {
-            using std::string;
-            if(kind == Kind::String) {
-                (&stringValue)->string::~string();
-            }
-        }
+        const StringObject* stringObject() const { return kind == Kind::String ? stringValue : nullptr; }
+        
+        // Boxing a string slot takes a new reference to it, adopting one takes over the slot's, and
+        // unboxing a value doesn't take one.
+        static Value box(Slot slot, Type type);
+        static Value adopt(Slot slot, Type type);
+        Slot unbox() const;
         
+    private:
         union {
-            std::string stringValue;
-            bool boolValue;
-            std::int64_t intValue;
-            double floatValue;
+            bool            boolValue;
+            std::int64_t    intValue;
+            double          floatValue;
+            StringObject*   stringValue;
         };
     };
     
+    static_assert(sizeof(Value) == 16, "Values should fit in two machine words");
+    
     inline Value Value::Integer(std::int64_t value) {
-        static Value v;
+        Value v;
         v.kind = Kind::Int;
         v.intValue = value;
         return v;
     }
     
     inline Value Value::Float(double value) {
-        static Value v;
+        Value v;
         v.kind = Kind::Number;
         v.floatValue = value;
         return v;
     }
     
     inline Value Value::boolean(bool value) {
-        static Value v;
+        Value v;
         v.kind = Kind::Bool;
         v.boolValue = value;
         return v;
@@ -108,14 +180,38 @@ namespace tinyscript {
     }
     
     inline const std::string& Value::asString() const {
-        return stringValue;
+        return stringValue->str();
+    }
+    
+    inline Value Value::box(Slot slot, Type type) {
+        switch(type) {
+            case Type::Bool: return boolean(slot.boolValue);
+            case Type::Integer: return Integer(slot.intValue);
+            case Type::Number: return Float(slot.floatValue);
+            case Type::String: return slot.stringValue ? Value(slot.stringValue) : Value();
+            default: return Value();
+        }
+    }
+    
+    inline Value Value::adopt(Slot slot, Type type) {
+        if(type != Type::String || !slot.stringValue) return box(slot, type);
+        Value v;
+        v.kind = Kind::String;
+        v.stringValue = slot.stringValue;
+        return v;
+    }
+    
+    inline Slot Value::unbox() const {
+        Slot slot;
+        slot.intValue = intValue;
+        return slot;
     }
     
     inline std::string Value::repr() const {
         switch (kind) {
             case Kind::Nil: return "<nil>";
             case Value::Kind::Bool: return boolValue ? "true" : "false";
-            case Value::Kind::String: return stringValue;
+            case Value::Kind::String: return stringValue->str();
             case Value::Kind::Int: return std::to_string(intValue);
             case Value::Kind::Number: return std::to_string(floatValue);
         }
@@ -133,8 +229,7 @@ namespace tinyscript {
             case Value::Kind::Number:
                 return a.asNumber() == b.asNumber();
             case Value::Kind::String:
-                return a.asString() == b.asString();
+                return StringObject::equal(a.stringObject(), b.stringObject());
         }
     }
 }
-
@@ -7,15 +7,19 @@
 //
 
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <string>
 #include <unordered_map>
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include <tinyscript/type.hpp>
 //#include <tinyscript/runtime/module.hpp>
 #include <tinyscript/runtime/value.hpp>
+#include <tinyscript/runtime/stringtable.hpp>
 
 namespace tinyscript {
     class Task;
@@ -24,14 +28,20 @@ namespace tinyscript {
     
     class VM {
     public:
-        enum class Result {Done, Continue, Error};
+        enum class Result {Done, Continue, Error, Preempted};
         using Foreign = std::function<void(VM&, Task&)>;
+        using Native = void (*)(VM&, Value*);
         
+        // Foreign functions are either untyped [code] that pops its own arguments from the task, or
+        // a [native] trampoline generated by Module::bind, which reads [arity] arguments in place and
+        // overwrites the first with its result.
         struct Function {
-            std::string     symbol;
-            std::uint8_t    arity;
-            Type            returnType;
-            Foreign         code;
+            std::string         symbol;
+            std::uint8_t        arity;
+            Type                returnType;
+            Foreign             code;
+            Native              native = nullptr;
+            std::vector<Type>   paramTypes = {};
         };
         
         using DispatchTable = std::unordered_map<std::string, Function>;
@@ -45,14 +55,43 @@ namespace tinyscript {
         static std::string mangleVar(const std::string& module, const std::string& symbol);
         
         void registerModule(const Module& module);
+        bool link(Program& program) const;
         Type functionType(const std::string& module, const std::string& symbol, std::uint8_t arity) const;
+        const Function* function(const std::string& module, const std::string& symbol, std::uint8_t arity) const;
         bool functionExists(const std::string& module, const std::string& symbol, std::uint8_t arity) const;
         
+        // The intern table is shared with compilers targeting this VM, so that the constants of every
+        // program it runs (and strings the host interns) compare by identity. Its strings die with
+        // the VM, so programs compiled or linked for it, their tasks, and values they returned must
+        // be destroyed first.
+        StringTable& strings() const { return strings_; }
+        
+        // Several threads may run tasks on the same VM, and tasks of the same program, at once: running
+        // only writes to the task. Modules must be registered and programs linked beforehand.
         std::pair<Result, Value> run(Task& co);
         
+        // Runs [co] like run(), but preempts it once it went through [budget] checkpoints or past
+        // [deadline]. Checkpoints are the backward jumps and calls, so the cost is only paid once per
+        // loop iteration or call, and no loop runs unbounded between two of them. A preempted task
+        // resumes where it stopped on the next run. Functions compiled by the JIT only run as
+        // machine code if they neither loop nor call (see Program::bounded).
+        std::pair<Result, Value> run(Task& co, std::uint64_t budget);
+        std::pair<Result, Value> run(Task& co, std::chrono::steady_clock::time_point deadline);
+        
+        // Instructions dispatched by the interpreters since the VM was created, by every thread. Only
+        // counted when built with TINYSCRIPT_COUNT_DISPATCH.
+        std::uint64_t dispatchCount() const { return dispatched_; }
+        
     private:
+        std::pair<Result, Value> resume(Task& co);
+        std::pair<Result, Value> execute(Task& co);
+        std::pair<Result, Value> runRegisters(Task& co);
+        std::pair<Result, Value> runTyped(Task& co);
+        
         //ModuleTable modules_;
         DispatchTable functions_;
+        mutable StringTable strings_;
+        std::atomic<std::uint64_t> dispatched_{0};
     };
 }
 
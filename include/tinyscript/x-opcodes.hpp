@@ -9,10 +9,14 @@
 OPCODE(halt,0,0)
 
 OPCODE(load_c,1,1)
+OPCODE(load_i,1,2)     // Signed 16-bit immediate
 OPCODE(load_yes,1,0)
 OPCODE(load_no,1,0)
 OPCODE(load,1,1)
 OPCODE(store,0,1)
+OPCODE(store_s,-1,1)   // Releases the string the local held (typed encoding)
+OPCODE(dup,1,0)
+OPCODE(pop,-1,0)
 
 OPCODE(fmin,0,0)
 OPCODE(fadd,-1,0)
@@ -25,6 +29,9 @@ OPCODE(iadd,-1,0)
 OPCODE(isub,-1,0)
 OPCODE(imul,-1,0)
 OPCODE(idiv,-1,0)
+OPCODE(iadd_i,0,2)
+OPCODE(isub_i,0,2)
+OPCODE(inc_l,0,2)      // Local slot, signed 8-bit delta
 
 OPCODE(i2f,0,0)
 OPCODE(f2i,0,0)
@@ -43,21 +50,55 @@ OPCODE(test_ilteq,-1,0)
 OPCODE(test_igt,-1,0)
 OPCODE(test_igteq,-1,0)
 OPCODE(test_ieq,-1,0)
+OPCODE(test_ilt_li,1,3)    // Local slot, signed 16-bit immediate
+OPCODE(test_ilteq_li,1,3)
+OPCODE(test_igt_li,1,3)
+OPCODE(test_igteq_li,1,3)
+OPCODE(test_ieq_li,1,3)
 OPCODE(test_seq, -1, 0)
 
 OPCODE(jmp,0,2)
 OPCODE(rjmp,0,2)
 OPCODE(jnz,0,2)
 OPCODE(rjnz,0,2)
+OPCODE(jz,0,2)
+OPCODE(rjz,0,2)
+
+// Compare and branch, with a signed offset
+OPCODE(jilt,-2,2)
+OPCODE(jilteq,-2,2)
+OPCODE(jigt,-2,2)
+OPCODE(jigteq,-2,2)
+OPCODE(jieq,-2,2)
+OPCODE(jine,-2,2)
+OPCODE(jflt,-2,2)
+OPCODE(jflteq,-2,2)
+OPCODE(jfgt,-2,2)
+OPCODE(jfgteq,-2,2)
+OPCODE(jfeq,-2,2)
+OPCODE(jfne,-2,2)
+OPCODE(jseq,-2,2)
+OPCODE(jsne,-2,2)
+OPCODE(jilt_li,0,5)        // Local slot, signed 16-bit immediate, signed offset
+OPCODE(jilteq_li,0,5)
+OPCODE(jigt_li,0,5)
+OPCODE(jigteq_li,0,5)
+OPCODE(jieq_li,0,5)
+OPCODE(jine_li,0,5)
+
+OPCODE(loop_enter,-1,3)     // Local slot, signed offset
+OPCODE(loop_next,0,3)
 
 OPCODE(retain,0,0)
 OPCODE(release,0,0)
 
-OPCODE(call_n,-1,1) // Native bytecode call
+OPCODE(call_n,-1,2) // Native bytecode call
+OPCODE(tail_n,-1,2) // call_n followed by a return, reusing the caller's frame
 //OPCODE(call_c,-1,1) // Native coroutine bytecode call
 OPCODE(call_f,-1,1)
 OPCODE(yield,0,0)
 OPCODE(yield_v,0,0)
+OPCODE(yield_t,0,1)   // Boxes the value as the type in its operand (typed encoding)
 OPCODE(ret,0,0)
 OPCODE(ret_v,-1,0)
 
@@ -0,0 +1,90 @@
+//
+//  x-regops.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+
+// Register instructions name frame slots with one byte operands. dst comes first, jump offsets
+// are signed and always last.
+REGOP(halt,0)
+
+REGOP(move,2)           // dst, src
+REGOP(loadk,2)          // dst, constant
+REGOP(loadi,3)          // dst, signed 16-bit immediate
+REGOP(loadyes,1)
+REGOP(loadno,1)
+
+REGOP(fneg,2)
+REGOP(fadd,3)           // dst, a, b
+REGOP(fsub,3)
+REGOP(fmul,3)
+REGOP(fdiv,3)
+
+REGOP(ineg,2)
+REGOP(iadd,3)
+REGOP(isub,3)
+REGOP(imul,3)
+REGOP(idiv,3)
+REGOP(iaddi,4)          // dst, a, signed 16-bit immediate
+REGOP(isubi,4)
+
+REGOP(i2f,2)
+REGOP(f2i,2)
+
+REGOP(sadd,3)
+
+REGOP(land,3)
+REGOP(lor,3)
+REGOP(flt,3)
+REGOP(flteq,3)
+REGOP(fgt,3)
+REGOP(fgteq,3)
+REGOP(feq,3)
+REGOP(ilt,3)
+REGOP(ilteq,3)
+REGOP(igt,3)
+REGOP(igteq,3)
+REGOP(ieq,3)
+REGOP(seq,3)
+
+REGOP(jmp,2)
+REGOP(jt,3)             // a, offset
+REGOP(jf,3)
+REGOP(jilt,4)           // a, b, offset
+REGOP(jilteq,4)
+REGOP(jigt,4)
+REGOP(jigteq,4)
+REGOP(jieq,4)
+REGOP(jine,4)
+REGOP(jflt,4)
+REGOP(jflteq,4)
+REGOP(jfgt,4)
+REGOP(jfgteq,4)
+REGOP(jfeq,4)
+REGOP(jfne,4)
+REGOP(jseq,4)
+REGOP(jsne,4)
+REGOP(jilti,5)          // a, signed 16-bit immediate, offset
+REGOP(jilteqi,5)
+REGOP(jigti,5)
+REGOP(jigteqi,5)
+REGOP(jieqi,5)
+REGOP(jinei,5)
+
+REGOP(loopenter,4)      // counter, count, offset
+REGOP(loopnext,3)       // counter, offset
+
+REGOP(retain,1)
+REGOP(release,1)
+
+REGOP(call,3)           // first argument, function index
+REGOP(tailcall,3)
+REGOP(callf,2)          // first argument, import index
+REGOP(yield,0)
+REGOP(yieldv,1)
+REGOP(ret,0)
+REGOP(retv,1)
+
+REGOP(fail,1)
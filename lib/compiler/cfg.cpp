@@ -0,0 +1,243 @@
+//
+//  cfg.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cassert>
+#include <tinyscript/compiler/cfg.hpp>
+
+namespace tinyscript {
+    
+    // Blocks small enough to be copied in place of a jump to them.
+    static constexpr std::uint64_t maxTailSize = 4;
+    static constexpr int maxTailCopies = 2;
+    
+    static bool isJump(Opcode code) {
+        return code == Opcode::jmp || code == Opcode::rjmp;
+    }
+    
+    static bool fallsThrough(const ILInstruction& inst) {
+        switch(inst.code()) {
+            case Opcode::halt:
+            case Opcode::ret:
+            case Opcode::ret_v:
+            case Opcode::fail:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+                return false;
+            default:
+                return true;
+        }
+    }
+    
+    static bool endsBlock(const ILInstruction& inst) {
+        return !fallsThrough(inst) || !inst.label().empty();
+    }
+    
+    ControlFlowGraph::ControlFlowGraph(const ILFunction& function) {
+        const auto& il = function.il_;
+        auto targets = function.jumpTargets();
+        
+        std::map<std::uint64_t, std::uint32_t> blockAt;
+        for(std::uint64_t i = 0; i < il.size(); ++i) {
+            if(i == 0 || targets[i] || endsBlock(il[i-1])) {
+                blockAt[i] = blocks_.size();
+                blocks_.emplace_back();
+            }
+            blocks_.back().code.push_back(il[i]);
+        }
+        if(blocks_.empty() || targets[il.size()]) {
+            blockAt[il.size()] = blocks_.size();
+            blocks_.emplace_back();
+        }
+        
+        for(const auto& pair: function.symbols_) {
+            if(!targets[pair.second]) continue;
+            blocks_[blockAt[pair.second]].labels.push_back(pair.first);
+            blockOf_[pair.first] = blockAt[pair.second];
+        }
+        
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            auto& block = blocks_[b];
+            if(!block.code.empty() && !fallsThrough(block.code.back())) continue;
+            // Code that runs off the end of the function can't be moved around.
+            if(b + 1 == blocks_.size()) {
+                valid_ = block.code.empty() && block.labels.empty();
+                continue;
+            }
+            block.next = b + 1;
+        }
+    }
+    
+    // Empty blocks and blocks that only jump somewhere else can be skipped.
+    std::int64_t ControlFlowGraph::forward(std::uint32_t b) const {
+        const auto& block = blocks_[b];
+        if(block.code.empty()) return block.next;
+        if(block.code.size() == 1 && isJump(block.code.back().code())) return target(block.code.back());
+        return -1;
+    }
+    
+    const std::string& ControlFlowGraph::label(std::uint32_t b) {
+        auto& block = blocks_[b];
+        if(block.labels.empty()) {
+            block.labels.push_back("block_" + std::to_string(labelID_++));
+            blockOf_[block.labels.back()] = b;
+        }
+        return block.labels.front();
+    }
+    
+    std::vector<bool> ControlFlowGraph::reachable() const {
+        std::vector<bool> reached(blocks_.size(), false);
+        std::vector<std::uint32_t> pending{0};
+        while(!pending.empty()) {
+            auto b = pending.back();
+            pending.pop_back();
+            if(reached[b]) continue;
+            reached[b] = true;
+            
+            const auto& block = blocks_[b];
+            if(block.next >= 0) pending.push_back(block.next);
+            if(!block.code.empty() && !block.code.back().label().empty())
+                pending.push_back(target(block.code.back()));
+        }
+        return reached;
+    }
+    
+    // Jumps (and fall-throughs) to a jump go straight to its target.
+    void ControlFlowGraph::threadJumps() {
+        auto destination = [this](std::uint32_t b) {
+            std::vector<bool> visited(blocks_.size(), false);
+            while(!visited[b] && forward(b) >= 0) {
+                visited[b] = true;
+                b = forward(b);
+            }
+            return b;
+        };
+        
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            auto& block = blocks_[b];
+            if(block.next >= 0) block.next = destination(block.next);
+            if(block.code.empty() || block.code.back().label().empty()) continue;
+            
+            auto& inst = block.code.back();
+            auto to = destination(target(inst));
+            if(to != target(inst)) inst.setLabel(label(to), inst.operand());
+        }
+    }
+    
+    // A jump to a small block is replaced by a copy of the block, as long as the copy can fall
+    // through to the code that follows the jump. This is what inverts loops: the jump back to the
+    // test at the top of an `until` loop becomes a copy of the test, with its branch inverted to
+    // go back to the body. Back edges are always inverted, since leaving the loop through an
+    // extra jump is cheaper than taking two branches on every iteration.
+    void ControlFlowGraph::duplicateTails() {
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            for(auto copies = 0; copies < maxTailCopies; ++copies) {
+                if(!duplicateTail(b)) break;
+            }
+        }
+    }
+    
+    bool ControlFlowGraph::duplicateTail(std::uint32_t b) {
+        auto& block = blocks_[b];
+        if(block.code.empty() || !isJump(block.code.back().code())) return false;
+        
+        auto t = target(block.code.back());
+        const auto& tail = blocks_[t];
+        if(t == b || tail.code.empty() || tail.code.size() > maxTailSize) return false;
+        
+        std::int64_t follows = b + 1 < blocks_.size() ? b + 1 : -1;
+        auto code = tail.code;
+        auto next = tail.next;
+        auto& last = code.back();
+        
+        if(next >= 0 && next != follows) {
+            auto inverted = last.label().empty() ? Opcode::nop : invertedBranch(last.code());
+            if(inverted == Opcode::nop || (target(last) != follows && t > b)) return false;
+            
+            ILInstruction branch(inverted, 0);
+            branch.setLabel(label(next), last.operand());
+            next = target(last);
+            last = branch;
+        }
+        
+        block.code.pop_back();
+        block.code.insert(block.code.end(), code.begin(), code.end());
+        block.next = next;
+        return true;
+    }
+    
+    // Blocks are placed in their original order, except that a block only reached through jumps
+    // is pulled right after the unconditional jump to it, which then goes away.
+    void ControlFlowGraph::layout() {
+        auto reached = reachable();
+        std::vector<bool> fallenInto(blocks_.size(), false);
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            if(reached[b] && blocks_[b].next >= 0) fallenInto[blocks_[b].next] = true;
+        }
+        
+        std::vector<bool> placed(blocks_.size(), false);
+        order_.clear();
+        std::uint32_t b = 0;
+        std::uint32_t scan = 0;
+        while(true) {
+            order_.push_back(b);
+            placed[b] = true;
+            
+            auto& block = blocks_[b];
+            if(block.next >= 0 && !placed[block.next]) {
+                b = block.next;
+                continue;
+            }
+            if(block.next < 0 && !block.code.empty() && isJump(block.code.back().code())) {
+                auto t = target(block.code.back());
+                if(!placed[t] && !fallenInto[t]) {
+                    block.code.pop_back();
+                    block.next = t;
+                    fallenInto[t] = true;
+                    b = t;
+                    continue;
+                }
+            }
+            
+            while(scan < blocks_.size() && (placed[scan] || !reached[scan])) scan += 1;
+            if(scan == blocks_.size()) break;
+            b = scan;
+        }
+    }
+    
+    void ControlFlowGraph::lower(ILFunction& function) {
+        assert(valid_ && "lowering an invalid control flow graph");
+        // Blocks that don't end up right after the one falling through to them need a jump, and
+        // a label for it.
+        std::vector<bool> jumpsNext(order_.size(), false);
+        for(std::uint64_t i = 0; i < order_.size(); ++i) {
+            auto next = blocks_[order_[i]].next;
+            if(next < 0 || (i + 1 < order_.size() && order_[i+1] == next)) continue;
+            jumpsNext[i] = true;
+            label(next);
+        }
+        
+        std::vector<ILInstruction> il;
+        std::map<std::string, std::uint64_t> symbols;
+        for(std::uint64_t i = 0; i < order_.size(); ++i) {
+            const auto& block = blocks_[order_[i]];
+            for(const auto& label: block.labels) {
+                symbols[label] = il.size();
+            }
+            il.insert(il.end(), block.code.begin(), block.code.end());
+            
+            if(!jumpsNext[i]) continue;
+            ILInstruction jump(Opcode::jmp, 0);
+            jump.setLabel(blocks_[block.next].labels.front());
+            il.push_back(jump);
+        }
+        
+        function.il_ = std::move(il);
+        function.symbols_ = std::move(symbols);
+        function.pc_ = function.il_.size();
+        function.current_ = nullptr;
+    }
+}
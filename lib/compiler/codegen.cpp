@@ -5,15 +5,21 @@
 //  Created by Amy Parent on 04/07/2018.
 //  Copyright © 2018 Amy Parent. All rights reserved.
 //
+#include <cassert>
 #include <iostream>
 #include <tinyscript/compiler/codegen.hpp>
+#include <tinyscript/compiler/registers.hpp>
+#include <tinyscript/compiler/selector.hpp>
 #include <tinyscript/compiler/sourcemanager.hpp>
 #include <tinyscript/compiler/token.hpp>
+#include <tinyscript/compiler/typed.hpp>
 #include <tinyscript/runtime/vm.hpp>
 
 namespace tinyscript {
     
-    CodeGen::CodeGen(const SourceManager& manager) : manager_(manager) {}
+    CodeGen::CodeGen(const SourceManager& manager, StringTable& strings)
+    : builder_(strings)
+    , manager_(manager) {}
     
     void CodeGen::openIf() {
         ifStack_.push_back(ifID_++);
@@ -24,7 +30,6 @@ namespace tinyscript {
         ifStack_.pop_back();
     }
     
-    std::string CodeGen::ifLabel() const { return "if_" + std::to_string(ifStack_.back()); }
     std::string CodeGen::elseLabel() const { return "else_" + std::to_string(ifStack_.back());}
     std::string CodeGen::endifLabel() const { return "endif_" + std::to_string(ifStack_.back());}
     
@@ -38,9 +43,25 @@ namespace tinyscript {
     }
     
     std::string CodeGen::loopLabel() const { return "loop_" + std::to_string(loopStack_.back()); }
+    std::string CodeGen::nextLabel() const { return "next_" + std::to_string(loopStack_.back()); }
     std::string CodeGen::endLoopLabel() const { return "endloop_" + std::to_string(loopStack_.back()); }
     std::string CodeGen::loopVariable() const { return "$counter_loop_" + std::to_string(loopStack_.back()); }
     
+    // `a and b` is `a; jz skip; b; jmp end; skip: load_no; end:`, and `a or b` the same with jnz
+    // and load_yes: the right operand only runs when the left one doesn't decide the result.
+    void CodeGen::openLogical(bool isAnd) {
+        openIf();
+        emitBranch(!isAnd, elseLabel());
+    }
+    
+    void CodeGen::closeLogical(bool isAnd) {
+        emitJump(Opcode::jmp, endifLabel());
+        emitLabel(elseLabel());
+        emitInstruction(isAnd ? Opcode::load_no : Opcode::load_yes);
+        logicals_.push_back({elseLabel(), endifLabel(), !isAnd});
+        closeIf();
+    }
+    
     std::uint64_t CodeGen::patchPoint() {
         return builder_.currentFunction().currentLocation();
     }
@@ -52,7 +73,8 @@ namespace tinyscript {
     
     void CodeGen::patchCall(Opcode code, const std::string& symbol, std::uint64_t at) {
         auto& inst = builder_.currentFunction().addInstruction(code, at);
-        inst.setOperand8(builder_.constant(symbol));
+        inst.setOperand8(code == Opcode::call_f ? builder_.import(symbol) : builder_.constant(symbol));
+        inst.setCall(1, Type::String);
         builder_.currentFunction().finishInstruction();
     }
     
@@ -60,9 +82,13 @@ namespace tinyscript {
         builder_.currentFunction().removeInstruction(at);
     }
     
-    void CodeGen::openFunction(const Token& symbol, std::uint8_t arity) {
-        auto signature = VM::mangleFunc(manager_.tokenAsString(symbol), arity);
-        builder_.openFunction(signature, arity);
+    void CodeGen::discardCode(std::uint64_t from) {
+        while(patchPoint() > from) dropCode(from);
+    }
+    
+    void CodeGen::openFunction(const Token& symbol, const std::vector<Type>& paramTypes, Type returnType) {
+        auto signature = VM::mangleFunc(manager_.tokenAsString(symbol), paramTypes.size());
+        builder_.openFunction(signature, paramTypes.size()).setTypes(paramTypes, returnType);
     }
     
     void CodeGen::closeFunction() {
@@ -86,17 +112,30 @@ namespace tinyscript {
     }
     
     void CodeGen::emitLocal(tinyscript::Opcode code, const std::string &symbol) {
+        if(code == Opcode::store && fuseIncrement(builder_.currentFunction().local(symbol))) return;
         auto& inst = builder_.currentFunction().addInstruction(code);
         inst.setOperand8(builder_.currentFunction().local(symbol));
         builder_.currentFunction().finishInstruction();
     }
     
+    void CodeGen::emitLocalJump(tinyscript::Opcode code, const std::string& symbol, const std::string& label) {
+        auto& function = builder_.currentFunction();
+        function.addInstruction(code).setLabel(label, function.local(symbol));
+        function.finishInstruction();
+    }
+    
     void CodeGen::emitConstantI(tinyscript::Opcode code, const Token& symbol) {
         int64_t num = manager_.tokenAsInt(symbol);
         emitConstantI(code, num);
     }
     
     void CodeGen::emitConstantI(tinyscript::Opcode code, std::int64_t symbol) {
+        if(code == Opcode::load_c && symbol >= INT16_MIN && symbol <= INT16_MAX) {
+            auto& inst = builder_.currentFunction().addInstruction(Opcode::load_i);
+            inst.setOperand16(static_cast<std::uint16_t>(symbol));
+            builder_.currentFunction().finishInstruction();
+            return;
+        }
         auto& inst = builder_.currentFunction().addInstruction(code);
         inst.setOperand8(builder_.constant(symbol));
         builder_.currentFunction().finishInstruction();
@@ -107,7 +146,7 @@ namespace tinyscript {
         emitConstantF(code, num);
     }
     
-    void CodeGen::emitConstantF(tinyscript::Opcode code, float symbol) {
+    void CodeGen::emitConstantF(tinyscript::Opcode code, double symbol) {
         auto& inst = builder_.currentFunction().addInstruction(code);
         inst.setOperand8(builder_.constant(symbol));
         builder_.currentFunction().finishInstruction();
@@ -123,7 +162,18 @@ namespace tinyscript {
         builder_.currentFunction().finishInstruction();
     }
     
+    void CodeGen::emitConstant(const Value& value) {
+        switch(value.kind) {
+            case Value::Kind::Bool: emitInstruction(value.asBool() ? Opcode::load_yes : Opcode::load_no); break;
+            case Value::Kind::Int: emitConstantI(Opcode::load_c, value.asInt()); break;
+            case Value::Kind::Number: emitConstantF(Opcode::load_c, value.asNumber()); break;
+            case Value::Kind::String: emitConstantS(Opcode::load_c, value.asString()); break;
+            default: assert(false && "cannot emit a nil constant"); break;
+        }
+    }
+    
     void CodeGen::emitInstruction(tinyscript::Opcode code) {
+        if(fuseImmediate(code)) return;
         builder_.currentFunction().addInstruction(code);
         builder_.currentFunction().finishInstruction();
     }
@@ -134,11 +184,138 @@ namespace tinyscript {
         builder_.currentFunction().finishInstruction();
     }
     
-    Program CodeGen::generate(bool dump) {
+    // Branches to `label` if the boolean on top of the stack equals `condition`. When it was just
+    // pushed by a test instruction, the two are fused into a single compare-and-branch.
+    void CodeGen::emitBranch(bool condition, const std::string& label) {
+        if(branchLogical(condition, label)) return;
+        auto& function = builder_.currentFunction();
+        const auto* test = function.peek(1);
+        auto branch = test ? Selector::branchInstruction(test->code(), condition) : Opcode::nop;
+        if(branch == Opcode::nop) {
+            emitJump(condition ? Opcode::jnz : Opcode::jz, label);
+            return;
+        }
+        
+        std::uint32_t operand = test->operand();
+        function.removeInstruction(function.currentLocation()-1);
+        function.addInstruction(branch).setLabel(label, operand);
+        function.finishInstruction();
+    }
+    
+    // Branching on the result of `and`/`or` doesn't need the result: the jumps taken when the left
+    // operand decides it go where the branch would, and the branch tests the right operand.
+    bool CodeGen::branchLogical(bool condition, const std::string& label) {
+        if(logicals_.empty()) return false;
+        auto& function = builder_.currentFunction();
+        auto logical = logicals_.back();
+        std::int64_t end = function.currentLocation();
+        if(function.symbolLocation(logical.end) != end || function.symbolLocation(logical.skip) != end - 1)
+            return false;
+        
+        logicals_.pop_back();
+        function.removeInstruction(end - 1);
+        function.removeInstruction(end - 2);
+        function.removeSymbol(logical.skip);
+        function.removeSymbol(logical.end);
+        
+        if(logical.value == condition) {
+            function.redirectJumps(logical.skip, label);
+            emitBranch(condition, label);
+        } else {
+            emitBranch(condition, label);
+            emitLabel(logical.skip);
+        }
+        return true;
+    }
+    
+    // `next` jumps back to the top of until loops, but forward to the decrement in count loops.
+    void CodeGen::emitNext() {
+        auto label = nextLabel();
+        emitJump(builder_.currentFunction().hasSymbol(label) ? Opcode::rjmp : Opcode::jmp, label);
+    }
+    
+    void CodeGen::emitCall(const std::string& signature, std::uint8_t arity, Type result) {
+        auto& inst = builder_.currentFunction().addInstruction(Opcode::call_n);
+        inst.setOperand16(builder_.function(signature));
+        inst.setCall(arity, result);
+        builder_.currentFunction().finishInstruction();
+    }
+    
+    void CodeGen::emitForeignCall(const std::string& signature, std::uint8_t arity, Type result) {
+        auto& inst = builder_.currentFunction().addInstruction(Opcode::call_f);
+        inst.setOperand8(builder_.import(signature));
+        inst.setCall(arity, result);
+        builder_.currentFunction().finishInstruction();
+    }
+    
+    // `load_i n; iadd` becomes `iadd_i n`, and `load x; load_i n; test_ilt` becomes
+    // `test_ilt_li x, n`.
+    bool CodeGen::fuseImmediate(Opcode code) {
+        auto immediate = Selector::immediateInstruction(code);
+        if(immediate == Opcode::nop) return false;
+        
+        auto& function = builder_.currentFunction();
+        const auto* rhs = function.peek(1);
+        if(!rhs || rhs->code() != Opcode::load_i) return false;
+        std::uint32_t operand = rhs->operand();
+        
+        if(operandSize(immediate) == 2) {
+            function.removeInstruction(function.currentLocation()-1);
+            function.addInstruction(immediate).setOperand16(operand);
+            function.finishInstruction();
+            return true;
+        }
+        
+        const auto* lhs = function.peek(2);
+        if(!lhs || lhs->code() != Opcode::load) return false;
+        operand |= lhs->operand() << 16;
+        
+        function.removeInstruction(function.currentLocation()-1);
+        function.removeInstruction(function.currentLocation()-1);
+        function.addInstruction(immediate).setOperand24(operand);
+        function.finishInstruction();
+        return true;
+    }
+    
+    // `load x; iadd_i n; store x` becomes `inc_l x, n` when n fits in a signed byte.
+    bool CodeGen::fuseIncrement(std::uint8_t slot) {
+        auto& function = builder_.currentFunction();
+        const auto* op = function.peek(1);
+        const auto* load = function.peek(2);
+        if(!op || !load || load->code() != Opcode::load || load->operand() != slot) return false;
+        if(op->code() != Opcode::iadd_i && op->code() != Opcode::isub_i) return false;
+        
+        std::int32_t delta = static_cast<std::int16_t>(op->operand());
+        if(op->code() == Opcode::isub_i) delta = -delta;
+        if(delta < INT8_MIN || delta > INT8_MAX) return false;
+        
+        function.removeInstruction(function.currentLocation()-1);
+        function.removeInstruction(function.currentLocation()-1);
+        function.addInstruction(Opcode::inc_l).setOperand16((slot << 8) | static_cast<std::uint8_t>(delta));
+        function.finishInstruction();
+        return true;
+    }
+    
+    Program CodeGen::generate(bool dump, std::uint8_t optLevel, Program::Encoding encoding) {
         Program prog;
-        builder_.closeScript();
-        builder_.write(prog);
+        builder_.closeScript(optLevel);
+        builder_.write(prog, encoding);
         if(dump) builder_.dump(std::cerr);
+        if(dump && prog.encoding != Program::Encoding::Stack) {
+            bool registers = prog.encoding == Program::Encoding::Registers;
+            auto disassemble = registers ? &RegisterBuilder::dump : &TypedBuilder::dump;
+            std::vector<std::string> names(prog.functions.size());
+            for(const auto& pair: prog.symbols) {
+                names[pair.second] = pair.first;
+            }
+            std::cerr << (registers ? "--registers" : "--typed") << " (main script):" << std::endl;
+            disassemble(prog.script, std::cerr);
+            for(std::uint64_t i = 0; i < names.size(); ++i) {
+                std::cerr << (registers ? "--registers" : "--typed") << " (" << names[i] << "):" << std::endl;
+                disassemble(prog.functions[i], std::cerr);
+            }
+            std::cerr << "--done" << std::endl;
+        }
         return prog;
     }
 }
@@ -20,15 +20,38 @@ namespace tinyscript {
     , vm_(vm)
     , scanner_(manager)
     , sema_(vm, manager)
-    , codegen_(manager_) {
+    , codegen_(manager_, vm.strings()) {
         
     }
     
-    Program Compiler::compile(bool dump) {
+    Program Compiler::compile(bool dump, std::uint8_t optLevel, Program::Encoding encoding) {
+        scanAssignments();
         scanner_.consumeToken();
         recProgram();
         codegen_.emitInstruction(Opcode::ret);
-        return codegen_.generate(dump);
+        auto program = codegen_.generate(dump, optLevel, encoding);
+        vm_.link(program);
+        return program;
+    }
+    
+    // Variables initialised with a constant and never assigned again are replaced by their value.
+    // Scopes are ignored here: a name assigned anywhere in the source is never propagated.
+    void Compiler::scanAssignments() {
+        Scanner scanner(manager_);
+        Token::Kind before = Token::Kind::eof;
+        Token previous;
+        previous.kind = Token::Kind::eof;
+        
+        for(scanner.consumeToken(); ; scanner.consumeToken()) {
+            const auto& token = scanner.currentToken();
+            if(token.kind == Token::Kind::eof || token.kind == Token::Kind::invalid) break;
+            if(token.kind == Token::Kind::op_eq && previous.kind == Token::Kind::identifier
+               && before != Token::Kind::kw_var && before != Token::Kind::kw_func) {
+                assigned_.insert(manager_.tokenAsString(previous));
+            }
+            before = previous.kind;
+            previous = token;
+        }
     }
     
     void Compiler::compilerError(const std::string &message) {
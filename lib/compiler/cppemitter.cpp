@@ -0,0 +1,558 @@
+//
+//  cppemitter.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <tinyscript/compiler/cppemitter.hpp>
+
+namespace tinyscript {
+    
+    static std::uint16_t read16(const std::vector<std::uint8_t>& code, std::uint32_t at) {
+        return static_cast<std::uint16_t>((code[at] << 8) | code[at+1]);
+    }
+    
+    static std::string intLiteral(std::int64_t value) {
+        if(value == INT64_MIN) return "(-9223372036854775807 - 1)";
+        if(value < 0) return "(" + std::to_string(value) + ")";
+        return std::to_string(value);
+    }
+    
+    static std::string floatLiteral(double value) {
+        if(std::isnan(value)) return "std::numeric_limits<double>::quiet_NaN()";
+        if(std::isinf(value)) return value < 0 ? "-std::numeric_limits<double>::infinity()"
+                                               : "std::numeric_limits<double>::infinity()";
+        std::ostringstream out;
+        out << std::hexfloat << value;
+        return out.str();
+    }
+    
+    static std::string stringLiteral(const std::string& value) {
+        std::string literal = "\"";
+        for(unsigned char c: value) {
+            if(c == '"' || c == '\\') {
+                literal += '\\';
+                literal += c;
+            } else if(c < 0x20 || c >= 0x7f) {
+                char escape[5];
+                std::snprintf(escape, sizeof(escape), "\\%03o", c);
+                literal += escape;
+            } else {
+                literal += c;
+            }
+        }
+        return literal + "\"";
+    }
+    
+    static std::string typeName(Type type) {
+        switch(type) {
+            case Type::Void:    return "Type::Void";
+            case Type::Bool:    return "Type::Bool";
+            case Type::Integer: return "Type::Integer";
+            case Type::Number:  return "Type::Number";
+            case Type::String:  return "Type::String";
+            default:            return "Type::Invalid";
+        }
+    }
+    
+    static std::string constantLiteral(const Value& value) {
+        switch(value.kind) {
+            case Value::Kind::Nil:      return "Value()";
+            case Value::Kind::Bool:     return value.asBool() ? "Value::boolean(true)" : "Value::boolean(false)";
+            case Value::Kind::Int:      return "Value::Integer(" + intLiteral(value.asInt()) + ")";
+            case Value::Kind::Number:   return "Value::Float(" + floatLiteral(value.asNumber()) + ")";
+            case Value::Kind::String:   return "vm.strings().intern(" + stringLiteral(value.asString()) + ")";
+        }
+        return "Value()";
+    }
+    
+    static bool isJump(Opcode code) {
+        return code >= Opcode::jmp && code <= Opcode::loop_next;
+    }
+    
+    // The comparison each test and branch opcode makes, and the accessor for its operands.
+    static const char* comparison(Opcode code) {
+        switch(code) {
+            case Opcode::test_flt: case Opcode::test_ilt: case Opcode::test_ilt_li:
+            case Opcode::jflt: case Opcode::jilt: case Opcode::jilt_li:
+                return "<";
+            case Opcode::test_flteq: case Opcode::test_ilteq: case Opcode::test_ilteq_li:
+            case Opcode::jflteq: case Opcode::jilteq: case Opcode::jilteq_li:
+                return "<=";
+            case Opcode::test_fgt: case Opcode::test_igt: case Opcode::test_igt_li:
+            case Opcode::jfgt: case Opcode::jigt: case Opcode::jigt_li:
+                return ">";
+            case Opcode::test_fgteq: case Opcode::test_igteq: case Opcode::test_igteq_li:
+            case Opcode::jfgteq: case Opcode::jigteq: case Opcode::jigteq_li:
+                return ">=";
+            case Opcode::test_feq: case Opcode::test_ieq: case Opcode::test_ieq_li:
+            case Opcode::jfeq: case Opcode::jieq: case Opcode::jieq_li:
+                return "==";
+            default:
+                return "!=";
+        }
+    }
+    
+    static const char* accessor(Opcode code) {
+        switch(code) {
+            case Opcode::test_flt: case Opcode::test_flteq: case Opcode::test_fgt:
+            case Opcode::test_fgteq: case Opcode::test_feq:
+            case Opcode::jflt: case Opcode::jflteq: case Opcode::jfgt:
+            case Opcode::jfgteq: case Opcode::jfeq: case Opcode::jfne:
+                return "asNumber()";
+            default:
+                return "asInt()";
+        }
+    }
+    
+    CppEmitter::CppEmitter(const Program& program, const std::string& name)
+    : program_(program)
+    , name_(name) {
+        
+    }
+    
+    std::string CppEmitter::scriptName(const std::string& path) {
+        auto start = path.find_last_of("/\\");
+        auto file = path.substr(start == std::string::npos ? 0 : start + 1);
+        auto name = file.substr(0, file.find('.'));
+        for(auto& c: name) {
+            if(!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+        }
+        if(name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) name = "_" + name;
+        return name;
+    }
+    
+    const Program::Function& CppEmitter::function(std::uint32_t index) const {
+        return index == 0 ? program_.script : program_.functions[index - 1];
+    }
+    
+    std::string CppEmitter::label(std::uint32_t index, std::int64_t offset) const {
+        return "f" + std::to_string(index) + "_" + std::to_string(offset);
+    }
+    
+    bool CppEmitter::decode(std::uint32_t index) {
+        const auto& bytecode = function(index).bytecode;
+        auto& code = code_[index];
+        auto& labels = labels_[index];
+        labels.insert(0);
+        
+        std::set<std::uint32_t> starts;
+        for(std::uint32_t pc = 0; pc < bytecode.size();) {
+            Instruction inst;
+            inst.code = static_cast<Opcode>(bytecode[pc]);
+            if(inst.code > Opcode::nop) return false;
+            inst.offset = pc;
+            inst.next = pc + 1 + operandSize(inst.code);
+            if(inst.next > bytecode.size()) return false;
+            
+            auto at = pc + 1;
+            switch(inst.code) {
+                case Opcode::load_c:
+                case Opcode::load:
+                case Opcode::store:
+                case Opcode::call_f:
+                case Opcode::fail:
+                    inst.operand = bytecode[at];
+                    break;
+                
+                case Opcode::load_i:
+                case Opcode::iadd_i:
+                case Opcode::isub_i:
+                    inst.operand = static_cast<std::int16_t>(read16(bytecode, at));
+                    break;
+                
+                case Opcode::call_n:
+                case Opcode::tail_n:
+                    inst.operand = read16(bytecode, at);
+                    if(inst.operand >= static_cast<std::int64_t>(program_.functions.size())) return false;
+                    if(inst.code == Opcode::call_n) resumePoints_[index].insert(inst.next);
+                    break;
+                
+                case Opcode::yield:
+                case Opcode::yield_v:
+                case Opcode::yield_t:
+                    resumePoints_[index].insert(inst.next);
+                    break;
+                
+                case Opcode::inc_l:
+                    inst.slot = bytecode[at];
+                    inst.operand = static_cast<std::int8_t>(bytecode[at+1]);
+                    break;
+                
+                case Opcode::test_ilt_li:
+                case Opcode::test_ilteq_li:
+                case Opcode::test_igt_li:
+                case Opcode::test_igteq_li:
+                case Opcode::test_ieq_li:
+                    inst.slot = bytecode[at];
+                    inst.operand = static_cast<std::int16_t>(read16(bytecode, at+1));
+                    break;
+                
+                case Opcode::jmp:
+                case Opcode::jnz:
+                case Opcode::jz:
+                    inst.target = inst.next + read16(bytecode, at);
+                    break;
+                
+                case Opcode::rjmp:
+                case Opcode::rjnz:
+                case Opcode::rjz:
+                    inst.target = static_cast<std::int64_t>(inst.next) - read16(bytecode, at);
+                    break;
+                
+                case Opcode::jilt:
+                case Opcode::jilteq:
+                case Opcode::jigt:
+                case Opcode::jigteq:
+                case Opcode::jieq:
+                case Opcode::jine:
+                case Opcode::jflt:
+                case Opcode::jflteq:
+                case Opcode::jfgt:
+                case Opcode::jfgteq:
+                case Opcode::jfeq:
+                case Opcode::jfne:
+                case Opcode::jseq:
+                case Opcode::jsne:
+                    inst.target = inst.next + static_cast<std::int16_t>(read16(bytecode, at));
+                    break;
+                
+                case Opcode::jilt_li:
+                case Opcode::jilteq_li:
+                case Opcode::jigt_li:
+                case Opcode::jigteq_li:
+                case Opcode::jieq_li:
+                case Opcode::jine_li:
+                    inst.slot = bytecode[at];
+                    inst.operand = static_cast<std::int16_t>(read16(bytecode, at+1));
+                    inst.target = inst.next + static_cast<std::int16_t>(read16(bytecode, at+3));
+                    break;
+                
+                case Opcode::loop_enter:
+                case Opcode::loop_next:
+                    inst.slot = bytecode[at];
+                    inst.target = inst.next + static_cast<std::int16_t>(read16(bytecode, at+1));
+                    break;
+                
+                default:
+                    break;
+            }
+            if(isJump(inst.code)) {
+                if(inst.target < 0) return false;
+                labels.insert(inst.target);
+                if(inst.target <= inst.offset) resumePoints_[index].insert(inst.target);
+            }
+            starts.insert(pc);
+            code.push_back(inst);
+            pc = inst.next;
+        }
+        
+        starts.insert(bytecode.size());
+        labels.insert(resumePoints_[index].begin(), resumePoints_[index].end());
+        for(auto offset: labels) {
+            if(!starts.count(offset)) return false;
+        }
+        return true;
+    }
+    
+    bool CppEmitter::emit(std::ostream& out) {
+        if(program_.encoding != Program::Encoding::Stack) return false;
+        auto count = program_.functions.size() + 1;
+        code_.assign(count, {});
+        labels_.assign(count, {});
+        resumePoints_.assign(count, {});
+        for(std::uint32_t i = 0; i < count; ++i) {
+            if(!decode(i)) return false;
+        }
+        
+        out << "// Generated by tinyscript --emit-cpp. Do not edit.\n";
+        out << "#include <cstdint>\n";
+        out << "#include <limits>\n";
+        out << "#include <tinyscript/runtime/aot.hpp>\n\n";
+        out << "namespace {\n";
+        out << "    using namespace tinyscript;\n\n";
+        out << "    AOT::Result run([[maybe_unused]] VM& vm, Task& task) {\n";
+        out << "        const auto& program = AOT::program(task);\n";
+        out << "        [[maybe_unused]] const Program::Function* functions = program.functions.data();\n";
+        out << "        [[maybe_unused]] const Value* constants = program.constants.data();\n";
+        out << "        [[maybe_unused]] const VM::Function* const* foreign = program.foreign.data();\n";
+        out << "        [[maybe_unused]] const std::uint8_t* code[] = {\n";
+        out << "            program.script.bytecode.data(),\n";
+        for(std::uint32_t i = 0; i < program_.functions.size(); ++i) {
+            out << "            functions[" << i << "].bytecode.data(),\n";
+        }
+        out << "        };\n";
+        out << "        [[maybe_unused]] Value* sp;\n";
+        out << "        [[maybe_unused]] Value* base;\n\n";
+        
+        out << "    resume:\n";
+        out << "        sp = AOT::stack(task);\n";
+        out << "        base = AOT::base(task);\n";
+        out << "        switch(AOT::resumePoint(task)) {\n";
+        for(std::uint32_t i = 0; i < count; ++i) {
+            out << "            case AOT::point(" << i << ", 0): goto " << label(i, 0) << ";\n";
+            for(auto offset: resumePoints_[i]) {
+                out << "            case AOT::point(" << i << ", " << offset << "): goto " << label(i, offset) << ";\n";
+            }
+        }
+        out << "            default: return AOT::error(\"invalid resume point\");\n";
+        out << "        }\n";
+        
+        for(std::uint32_t i = 0; i < count; ++i) {
+            emitFunction(out, i);
+        }
+        // Not reached, since functions end with a return or a jump. Programs that never return still
+        // need the resume label to be used.
+        out << "        goto resume;\n";
+        out << "    }\n";
+        out << "}\n\n";
+        emitProgram(out);
+        return true;
+    }
+    
+    void CppEmitter::emitFunction(std::ostream& out, std::uint32_t index) const {
+        std::string name = "script";
+        for(const auto& pair: program_.symbols) {
+            if(static_cast<std::uint32_t>(pair.second) + 1 == index) name = pair.first;
+        }
+        out << "\n        // " << name << "\n";
+        const auto& labels = labels_[index];
+        for(const auto& inst: code_[index]) {
+            if(labels.count(inst.offset)) out << "    " << label(index, inst.offset) << ":\n";
+            emitInstruction(out, index, inst);
+        }
+        auto end = function(index).bytecode.size();
+        if(labels.count(end)) {
+            out << "    " << label(index, end) << ":\n";
+            out << "        return AOT::error(\"ran off the end of a function\");\n";
+        }
+    }
+    
+    void CppEmitter::emitInstruction(std::ostream& out, std::uint32_t index, const Instruction& inst) const {
+        auto save = "AOT::save(task, code[" + std::to_string(index) + "] + " + std::to_string(inst.next) + ", sp);";
+        auto slot = "base[" + std::to_string(inst.slot) + "]";
+        auto operand = intLiteral(inst.operand);
+        auto target = inst.target >= 0 ? "goto " + label(index, inst.target) + ";" : std::string();
+        auto preempt = "if(AOT::preempted(task)) return AOT::preempt();";
+        if(inst.target >= 0 && inst.target <= inst.offset) {
+            target = "{ if(AOT::preempted(task)) { AOT::save(task, code[" + std::to_string(index) + "] + "
+                   + std::to_string(inst.target) + ", sp); return AOT::preempt(); } " + target + " }";
+        }
+        auto binary = [&](const char* make, const char* get, const char* op) {
+            out << "sp[-2] = Value::" << make << "(sp[-2]." << get << " " << op << " sp[-1]." << get << "); --sp;\n";
+        };
+        
+        out << "        ";
+        switch(inst.code) {
+            case Opcode::halt:
+                out << save << " return std::make_pair(VM::Result::Done, Value());\n";
+                break;
+            
+            case Opcode::load_c:    out << "*sp++ = constants[" << inst.operand << "];\n"; break;
+            case Opcode::load_i:    out << "*sp++ = Value::Integer(" << operand << ");\n"; break;
+            case Opcode::load_yes:  out << "*sp++ = Value::boolean(true);\n"; break;
+            case Opcode::load_no:   out << "*sp++ = Value::boolean(false);\n"; break;
+            case Opcode::load:      out << "*sp++ = base[" << inst.operand << "];\n"; break;
+            case Opcode::store:
+            case Opcode::store_s:   out << "base[" << inst.operand << "] = *--sp;\n"; break;
+            case Opcode::dup:       out << "*sp = sp[-1]; ++sp;\n"; break;
+            case Opcode::pop:       out << "--sp;\n"; break;
+            
+            case Opcode::fmin:      out << "sp[-1] = Value::Float(-sp[-1].asNumber());\n"; break;
+            case Opcode::fadd:      binary("Float", "asNumber()", "+"); break;
+            case Opcode::fsub:      binary("Float", "asNumber()", "-"); break;
+            case Opcode::fmul:      binary("Float", "asNumber()", "*"); break;
+            case Opcode::fdiv:      binary("Float", "asNumber()", "/"); break;
+            
+            case Opcode::imin:      out << "sp[-1] = Value::Integer(-sp[-1].asInt());\n"; break;
+            case Opcode::iadd:      binary("Integer", "asInt()", "+"); break;
+            case Opcode::isub:      binary("Integer", "asInt()", "-"); break;
+            case Opcode::imul:      binary("Integer", "asInt()", "*"); break;
+            case Opcode::idiv:      binary("Integer", "asInt()", "/"); break;
+            case Opcode::iadd_i:    out << "sp[-1] = Value::Integer(sp[-1].asInt() + " << operand << ");\n"; break;
+            case Opcode::isub_i:    out << "sp[-1] = Value::Integer(sp[-1].asInt() - " << operand << ");\n"; break;
+            case Opcode::inc_l:     out << slot << " = Value::Integer(" << slot << ".asInt() + " << operand << ");\n"; break;
+            
+            case Opcode::i2f:       out << "sp[-1] = Value::Float(static_cast<double>(sp[-1].asInt()));\n"; break;
+            case Opcode::f2i:       out << "sp[-1] = Value::Integer(static_cast<std::int64_t>(sp[-1].asNumber()));\n"; break;
+            
+            case Opcode::sadd:      out << "sp[-2] = Value(sp[-2].asString() + sp[-1].asString()); --sp;\n"; break;
+            case Opcode::log_and:   binary("boolean", "asBool()", "&&"); break;
+            case Opcode::log_or:    binary("boolean", "asBool()", "||"); break;
+            
+            case Opcode::test_flt:
+            case Opcode::test_flteq:
+            case Opcode::test_fgt:
+            case Opcode::test_fgteq:
+            case Opcode::test_feq:
+            case Opcode::test_ilt:
+            case Opcode::test_ilteq:
+            case Opcode::test_igt:
+            case Opcode::test_igteq:
+            case Opcode::test_ieq:
+                binary("boolean", accessor(inst.code), comparison(inst.code));
+                break;
+            
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+                out << "*sp++ = Value::boolean(" << slot << ".asInt() " << comparison(inst.code) << " " << operand << ");\n";
+                break;
+            
+            case Opcode::test_seq:
+                out << "sp[-2] = Value::boolean(StringObject::equal(sp[-2].stringObject(), sp[-1].stringObject())); --sp;\n";
+                break;
+            
+            case Opcode::jmp:
+            case Opcode::rjmp:
+                out << target << "\n";
+                break;
+            
+            case Opcode::jnz:
+            case Opcode::rjnz:
+                out << "if((--sp)->asBool()) " << target << "\n";
+                break;
+            
+            case Opcode::jz:
+            case Opcode::rjz:
+                out << "if(!(--sp)->asBool()) " << target << "\n";
+                break;
+            
+            case Opcode::jilt:
+            case Opcode::jilteq:
+            case Opcode::jigt:
+            case Opcode::jigteq:
+            case Opcode::jieq:
+            case Opcode::jine:
+            case Opcode::jflt:
+            case Opcode::jflteq:
+            case Opcode::jfgt:
+            case Opcode::jfgteq:
+            case Opcode::jfeq:
+            case Opcode::jfne:
+                out << "sp -= 2; if(sp[0]." << accessor(inst.code) << " " << comparison(inst.code)
+                    << " sp[1]." << accessor(inst.code) << ") " << target << "\n";
+                break;
+            
+            case Opcode::jseq:
+            case Opcode::jsne:
+                out << "sp -= 2; if(" << (inst.code == Opcode::jsne ? "!" : "")
+                    << "StringObject::equal(sp[0].stringObject(), sp[1].stringObject())) " << target << "\n";
+                break;
+            
+            case Opcode::jilt_li:
+            case Opcode::jilteq_li:
+            case Opcode::jigt_li:
+            case Opcode::jigteq_li:
+            case Opcode::jieq_li:
+            case Opcode::jine_li:
+                out << "if(" << slot << ".asInt() " << comparison(inst.code) << " " << operand << ") " << target << "\n";
+                break;
+            
+            case Opcode::loop_enter:
+                out << "{ std::int64_t count = (--sp)->asInt(); " << slot << " = Value::Integer(count); if(count <= 0) " << target << " }\n";
+                break;
+            
+            case Opcode::loop_next:
+                out << "{ std::int64_t count = " << slot << ".asInt() - 1; " << slot << " = Value::Integer(count); if(count > 0) " << target << " }\n";
+                break;
+            
+            case Opcode::retain:    out << "sp[-1].retain();\n"; break;
+            case Opcode::release:   out << "sp[-1].release();\n"; break;
+            
+            case Opcode::call_n:
+                out << save << "\n";
+                out << "        if(!task.pushFrame(functions[" << inst.operand << "])) return AOT::error(\"call stack overflow\");\n";
+                out << "        sp = AOT::stack(task); base = AOT::base(task);\n";
+                out << "        " << preempt << "\n";
+                out << "        goto " << label(inst.operand + 1, 0) << ";\n";
+                break;
+            
+            case Opcode::tail_n:
+                out << save << "\n";
+                out << "        if(!task.tailFrame(functions[" << inst.operand << "])) return AOT::error(\"call stack overflow\");\n";
+                out << "        sp = AOT::stack(task); base = AOT::base(task);\n";
+                out << "        " << preempt << "\n";
+                out << "        goto " << label(inst.operand + 1, 0) << ";\n";
+                break;
+            
+            case Opcode::call_f:
+                out << "sp = AOT::callForeign(vm, task, *foreign[" << inst.operand << "], code["
+                    << index << "] + " << inst.next << ", sp);\n";
+                break;
+            
+            case Opcode::yield:
+                out << save << " return std::make_pair(VM::Result::Continue, Value());\n";
+                break;
+            
+            case Opcode::yield_v:
+            case Opcode::yield_t:
+                out << "--sp; " << save << " return std::make_pair(VM::Result::Continue, *sp);\n";
+                break;
+            
+            case Opcode::ret:
+                out << save << " if(task.popFrame()) return std::make_pair(VM::Result::Done, Value()); goto resume;\n";
+                break;
+            
+            case Opcode::ret_v:
+                out << save << " if(task.returnFrame()) return std::make_pair(VM::Result::Done, task.pop()); goto resume;\n";
+                break;
+            
+            case Opcode::fail:
+                out << save << " return std::make_pair(VM::Result::Error, constants[" << inst.operand << "]);\n";
+                break;
+            
+            case Opcode::nop:
+                out << ";\n";
+                break;
+        }
+    }
+    
+    void CppEmitter::emitProgram(std::ostream& out) const {
+        auto write = [&](const Program::Function& function) {
+            out << "{" << static_cast<int>(function.variableCount) << ", " << static_cast<int>(function.arity) << ", {";
+            for(std::uint64_t i = 0; i < function.bytecode.size(); ++i) {
+                if(i % 16 == 0) out << "\n            ";
+                out << static_cast<int>(function.bytecode[i]) << ",";
+            }
+            out << "\n        }, {";
+            for(std::uint64_t i = 0; i < function.paramTypes.size(); ++i) {
+                out << (i ? ", " : "") << typeName(function.paramTypes[i]);
+            }
+            out << "}, " << typeName(function.returnType) << ", {}, " << function.stackDepth << "}";
+        };
+        
+        out << "namespace tinyscript { namespace scripts {\n";
+        out << "    Program " << name_ << "(VM& vm) {\n";
+        out << "        Program program;\n";
+        out << "        program.script = ";
+        write(program_.script);
+        out << ";\n";
+        for(const auto& function: program_.functions) {
+            out << "        program.functions.push_back(";
+            write(function);
+            out << ");\n";
+        }
+        for(const auto& pair: program_.symbols) {
+            out << "        program.symbols[" << stringLiteral(pair.first) << "] = " << pair.second << ";\n";
+        }
+        for(const auto& constant: program_.constants) {
+            out << "        program.constants.push_back(" << constantLiteral(constant) << ");\n";
+        }
+        for(const auto& import: program_.imports) {
+            out << "        program.imports.push_back(" << stringLiteral(import) << ");\n";
+        }
+        out << "        program.compiled = &run;\n";
+        out << "        vm.link(program);\n";
+        out << "        return program;\n";
+        out << "    }\n";
+        out << "}}\n";
+    }
+}
@@ -9,30 +9,77 @@
 #include <iostream>
 #include <algorithm>
 #include <tinyscript/compiler/ilbuilder.hpp>
+#include <tinyscript/compiler/mir.hpp>
+#include <tinyscript/compiler/cfg.hpp>
+#include <tinyscript/compiler/inliner.hpp>
+#include <tinyscript/compiler/registers.hpp>
+#include <tinyscript/compiler/typed.hpp>
 
 namespace tinyscript {
     ILInstruction::ILInstruction(Opcode code, std::uint64_t address) {
         code_ = code;
+        operand_ = 0;
         //address_ = address;
         complete_ = operandSize(code) == 0;
         resolved_ = complete_;
     }
     
-    void ILInstruction::setLabel(const std::string &label) {
-        assert(operandSize(code_) == 2 && "Invalid operand size");
+    // Jump offsets are always the last two bytes of the operand. Compare-and-branch instructions
+    // on a local carry the slot and immediate before it.
+    void ILInstruction::setLabel(const std::string &label, std::uint32_t prefix) {
+        assert(operandSize(code_) >= 2 && "Invalid operand size");
         label_ = label;
+        operand_ = prefix;
         complete_ = true;
         resolved_ = false;
     }
     
     void ILInstruction::replaceLabel(std::uint16_t op) {
-        assert(operandSize(code_) == 2 && "Invalid operand size");
+        assert(operandSize(code_) >= 2 && "Invalid operand size");
         assert(!resolved_ && "instruction is already resolved");
         assert(complete_ && "instruction is not complete");
-        operand_ = op;
+        operand_ = (operand_ << 16) | op;
         resolved_ = true;
     }
     
+    // The original jumps encode their direction in the opcode and take an unsigned offset, the
+    // compare-and-branch family uses a signed one.
+    bool ILInstruction::hasSignedOffset() const {
+        switch(code_) {
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::jnz:
+            case Opcode::rjnz:
+            case Opcode::jz:
+            case Opcode::rjz:
+                return false;
+            default:
+                return true;
+        }
+    }
+    
+    // The direction of unsigned jumps is part of their opcode, so it can only be picked once the
+    // code is laid out.
+    void ILInstruction::setBackward(bool backward) {
+        switch(code_) {
+            case Opcode::jmp:
+            case Opcode::rjmp:
+                code_ = backward ? Opcode::rjmp : Opcode::jmp;
+                break;
+            case Opcode::jnz:
+            case Opcode::rjnz:
+                code_ = backward ? Opcode::rjnz : Opcode::jnz;
+                break;
+            case Opcode::jz:
+            case Opcode::rjz:
+                code_ = backward ? Opcode::rjz : Opcode::jz;
+                break;
+            default:
+                assert(hasSignedOffset() && "not a jump instruction");
+                break;
+        }
+    }
+    
     void ILInstruction::setOperand8(std::uint8_t op) {
         assert(operandSize(code_) == 1 && "Invalid operand size");
         assert(!complete_ && "instruction is already complete");
@@ -47,25 +94,182 @@ namespace tinyscript {
         complete_ = resolved_ = true;
     }
     
-    void ILInstruction::write(Program::Function& function) const {
-        if(!isResolved() || !isComplete()) return;
-        function.bytecode.push_back(static_cast<std::uint8_t>(code_));
-        
-        switch (operandSize(code_)) {
-            case 1:
-                function.bytecode.push_back(operand_ & 0x00ff);
+    void ILInstruction::setOperand24(std::uint32_t op) {
+        assert(operandSize(code_) == 3 && "Invalid operand size");
+        assert(!complete_ && "instruction is already complete");
+        operand_ = op & 0x00ffffff;
+        complete_ = resolved_ = true;
+    }
+    
+    // Operands the instruction pops and pushes. Binary operators are the default.
+    void ILInstruction::effect(int& pops, int& pushes) const {
+        switch(code_) {
+            case Opcode::load_c:
+            case Opcode::load_i:
+            case Opcode::load_yes:
+            case Opcode::load_no:
+            case Opcode::load:
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+                pops = 0;
+                pushes = 1;
+                break;
+            
+            case Opcode::fmin:
+            case Opcode::imin:
+            case Opcode::iadd_i:
+            case Opcode::isub_i:
+            case Opcode::i2f:
+            case Opcode::f2i:
+            case Opcode::retain:
+            case Opcode::release:
+                pops = 1;
+                pushes = 1;
+                break;
+            
+            case Opcode::store:
+            case Opcode::store_s:
+            case Opcode::pop:
+            case Opcode::jnz:
+            case Opcode::rjnz:
+            case Opcode::rjz:
+            case Opcode::jz:
+            case Opcode::loop_enter:
+            case Opcode::yield_v:
+            case Opcode::yield_t:
+            case Opcode::ret_v:
+                pops = 1;
+                pushes = 0;
+                break;
+            
+            case Opcode::jilt:
+            case Opcode::jilteq:
+            case Opcode::jigt:
+            case Opcode::jigteq:
+            case Opcode::jieq:
+            case Opcode::jine:
+            case Opcode::jflt:
+            case Opcode::jflteq:
+            case Opcode::jfgt:
+            case Opcode::jfgteq:
+            case Opcode::jfeq:
+            case Opcode::jfne:
+            case Opcode::jseq:
+            case Opcode::jsne:
+                pops = 2;
+                pushes = 0;
+                break;
+            
+            case Opcode::dup:
+                pops = 1;
+                pushes = 2;
+                break;
+            
+            case Opcode::call_n:
+            case Opcode::call_f:
+                pops = callArity_;
+                pushes = callResult();
+                break;
+            
+            case Opcode::tail_n:
+                pops = callArity_;
+                pushes = 0;
                 break;
-                
-            case 2:
-                function.bytecode.push_back((operand_ >> 8) & 0x00ff);
-                function.bytecode.push_back(operand_ & 0x00ff);
+            
+            case Opcode::halt:
+            case Opcode::inc_l:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::jilt_li:
+            case Opcode::jilteq_li:
+            case Opcode::jigt_li:
+            case Opcode::jigteq_li:
+            case Opcode::jieq_li:
+            case Opcode::jine_li:
+            case Opcode::loop_next:
+            case Opcode::yield:
+            case Opcode::ret:
+            case Opcode::fail:
+            case Opcode::nop:
+                pops = 0;
+                pushes = 0;
                 break;
-                
+            
             default:
+                pops = 2;
+                pushes = 1;
                 break;
         }
     }
     
+    static bool usesConstant(Opcode code) {
+        return code == Opcode::load_c || code == Opcode::fail;
+    }
+    
+    void ILInstruction::remapConstant(const std::vector<std::uint8_t>& map) {
+        if(!usesConstant(code_)) return;
+        operand_ = map[operand_];
+    }
+    
+    // Before references are resolved, instructions that jump on a local still only hold the
+    // prefix in their operand.
+    std::int16_t ILInstruction::slot() const {
+        switch(code_) {
+            case Opcode::load:
+            case Opcode::store:
+            case Opcode::loop_enter:
+            case Opcode::loop_next:
+                return operand_ & 0x00ff;
+            case Opcode::inc_l:
+                return (operand_ >> 8) & 0x00ff;
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+            case Opcode::jilt_li:
+            case Opcode::jilteq_li:
+            case Opcode::jigt_li:
+            case Opcode::jigteq_li:
+            case Opcode::jieq_li:
+            case Opcode::jine_li:
+                return (operand_ >> 16) & 0x00ff;
+            default:
+                return -1;
+        }
+    }
+    
+    void ILInstruction::setSlot(std::uint8_t local) {
+        assert(slot() >= 0 && "instruction doesn't access a local");
+        assert((label_.empty() || !resolved_) && "instruction is already resolved");
+        switch(code_) {
+            case Opcode::load:
+            case Opcode::store:
+            case Opcode::loop_enter:
+            case Opcode::loop_next:
+                operand_ = local;
+                break;
+            case Opcode::inc_l:
+                operand_ = (operand_ & 0x00ff) | (local << 8);
+                break;
+            default:
+                operand_ = (operand_ & 0xffff) | (local << 16);
+                break;
+        }
+    }
+    
+    void ILInstruction::write(Program::Function& function) const {
+        if(!isResolved() || !isComplete()) return;
+        function.bytecode.push_back(static_cast<std::uint8_t>(code_));
+        
+        for(int i = operandSize(code_)-1; i >= 0; --i) {
+            function.bytecode.push_back((operand_ >> (8 * i)) & 0x00ff);
+        }
+    }
+    
     // MARK: - ILFunction
     
     void ILFunction::addSymbol(const std::string& label) {
@@ -73,6 +277,17 @@ namespace tinyscript {
         symbols_[label] = pc_;
     }
     
+    std::int64_t ILFunction::symbolLocation(const std::string& label) const {
+        auto it = symbols_.find(label);
+        return it != symbols_.end() ? static_cast<std::int64_t>(it->second) : -1;
+    }
+    
+    void ILFunction::redirectJumps(const std::string& label, const std::string& to) {
+        for(auto& inst: il_) {
+            if(inst.label() == label) inst.setLabel(to, inst.operand());
+        }
+    }
+    
     ILInstruction& ILFunction::addInstruction(Opcode code) {
         il_.push_back(ILInstruction(code, 0));
         current_ = &il_.back();
@@ -117,6 +332,16 @@ namespace tinyscript {
         return il_.size();
     }
     
+    // Instructions can only be fused with the ones that follow if no label points in between.
+    const ILInstruction* ILFunction::peek(std::uint64_t depth) const {
+        if(depth == 0 || depth > il_.size()) return nullptr;
+        std::uint64_t at = il_.size() - depth;
+        for(const auto& pair: symbols_) {
+            if(pair.second > at) return nullptr;
+        }
+        return &il_[at];
+    }
+    
     std::uint8_t ILFunction::local(const std::string& symbol) {
         for(uint8_t i = 0; i < locals_.size(); ++i) {
             if(locals_[i] == symbol) return i;
@@ -132,6 +357,166 @@ namespace tinyscript {
         return il_[it->second].address;
     }
     
+    // MARK: - Peephole optimizations
+    
+    static bool isTerminator(Opcode code) {
+        switch(code) {
+            case Opcode::halt:
+            case Opcode::ret:
+            case Opcode::ret_v:
+            case Opcode::fail:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::tail_n:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    static bool isPush(Opcode code) {
+        switch(code) {
+            case Opcode::load_c:
+            case Opcode::load_i:
+            case Opcode::load_yes:
+            case Opcode::load_no:
+            case Opcode::load:
+            case Opcode::dup:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    // Labels that no instruction jumps to don't make the code they point to reachable.
+    std::vector<bool> ILFunction::jumpTargets() const {
+        std::vector<bool> targets(il_.size() + 1, false);
+        for(const auto& inst: il_) {
+            if(inst.label().empty()) continue;
+            auto it = symbols_.find(inst.label());
+            assert(it != symbols_.end() && "Wrong label found");
+            targets[it->second] = true;
+        }
+        return targets;
+    }
+    
+    bool ILFunction::peephole(std::uint64_t at, const std::vector<bool>& targets) {
+        const auto& inst = il_[at];
+        const auto* next = at + 1 < il_.size() ? &il_[at + 1] : nullptr;
+        
+        if(inst.code() == Opcode::nop) {
+            removeInstruction(at);
+            return true;
+        }
+        
+        // Nothing can reach the code that follows a return or an unconditional jump until the
+        // next jump target.
+        if(isTerminator(inst.code()) && next && !targets[at + 1]) {
+            removeInstruction(at + 1);
+            return true;
+        }
+        
+        // jmp L; L:
+        if(inst.code() == Opcode::jmp && symbols_[inst.label()] == at + 1) {
+            removeInstruction(at);
+            return true;
+        }
+        
+        if(!next || targets[at + 1]) return false;
+        
+        // store x; load x -> dup; store x
+        if(inst.code() == Opcode::store && next->code() == Opcode::load && next->operand() == inst.operand()) {
+            il_[at + 1] = inst;
+            il_[at] = ILInstruction(Opcode::dup, 0);
+            return true;
+        }
+        
+        // load x; pop -> nothing, left behind by inlined calls whose result isn't used
+        if(next->code() == Opcode::pop && isPush(inst.code())) {
+            removeInstruction(at + 1);
+            removeInstruction(at);
+            return true;
+        }
+        
+        // jnz L1; jmp L2; L1: -> jz L2
+        auto inverted = invertedBranch(inst.code());
+        if(inverted != Opcode::nop && (next->code() == Opcode::jmp || next->code() == Opcode::rjmp)
+           && symbols_[inst.label()] == at + 2) {
+            ILInstruction branch(inverted, 0);
+            branch.setLabel(next->label(), inst.operand());
+            il_[at] = branch;
+            removeInstruction(at + 1);
+            return true;
+        }
+        return false;
+    }
+    
+    void ILFunction::peepholePass() {
+        bool changed = true;
+        while(changed) {
+            changed = false;
+            auto targets = jumpTargets();
+            for(std::uint64_t i = 0; i < il_.size() && !changed; ++i) {
+                changed = peephole(i, targets);
+            }
+        }
+    }
+    
+    // Level 2 runs the mid-level IR passes between two rounds of peephole optimizations: the
+    // first one cleans up the code for the IR builder, the second one the code it lowers to.
+    // Blocks are then laid out again, which leaves another round of clean up.
+    void ILFunction::optimize(std::uint8_t level) {
+        peepholePass();
+        
+        if(level > 1) {
+            MIRFunction mir(*this);
+            if(mir.isValid()) {
+                mir.optimize();
+                mir.lower(*this);
+                peepholePass();
+            }
+        }
+        
+        ControlFlowGraph cfg(*this);
+        if(!cfg.isValid()) return;
+        cfg.threadJumps();
+        cfg.duplicateTails();
+        cfg.layout();
+        cfg.lower(*this);
+        peepholePass();
+    }
+    
+    // A call that returns whatever the callee returns doesn't need its own frame anymore. Runs
+    // after the other passes, which don't know about tail calls.
+    void ILFunction::tailCalls() {
+        auto targets = jumpTargets();
+        for(std::uint64_t i = 0; i + 1 < il_.size(); ++i) {
+            const auto& call = il_[i];
+            if(call.code() != Opcode::call_n) continue;
+            if(il_[i + 1].code() != (call.callResult() ? Opcode::ret_v : Opcode::ret)) continue;
+            
+            ILInstruction tail(Opcode::tail_n, 0);
+            tail.setOperand16(call.operand());
+            tail.setCall(call.callArity(), call.callType());
+            il_[i] = tail;
+            if(targets[i + 1]) continue;
+            removeInstruction(i + 1);
+            targets.erase(targets.begin() + i + 1);
+        }
+    }
+    
+    void ILFunction::markConstants(std::vector<bool>& used) const {
+        for(const auto& inst: il_) {
+            if(usesConstant(inst.code())) used[inst.operand()] = true;
+        }
+    }
+    
+    void ILFunction::remapConstants(const std::vector<std::uint8_t>& map) {
+        for(auto& inst: il_) {
+            inst.remapConstant(map);
+        }
+    }
+    
     void ILFunction::resolveReferences() {
         auto rem = std::remove_if(il_.begin(), il_.end(), [](const ILInstruction& a) { return a.code() == Opcode::nop; });
         il_.erase(rem, il_.end());
@@ -148,16 +533,59 @@ namespace tinyscript {
             std::int64_t target = getAddress(inst.label());
             assert(target >= 0 && "Wrong label found");
             std::int64_t pc = inst.address + inst.size();
-            std::uint16_t jump = std::abs(pc-target);
-            inst.replaceLabel(jump);
+            if(inst.hasSignedOffset()) {
+                assert(target-pc >= INT16_MIN && target-pc <= INT16_MAX && "jump is too far");
+                inst.replaceLabel(static_cast<std::uint16_t>(target-pc));
+            } else {
+                inst.setBackward(target < pc);
+                inst.replaceLabel(std::abs(pc-target));
+            }
         }
     }
     
+    // The most operands on the stack at once. Paths reaching an instruction with different depths
+    // keep the deepest, and a loop that keeps growing the stack gives up at the largest depth.
+    std::uint16_t ILFunction::stackDepth() const {
+        std::vector<std::int64_t> depths(il_.size() + 1, -1);
+        std::vector<std::uint64_t> work{0};
+        std::int64_t deepest = 0;
+        depths[0] = 0;
+        
+        auto visit = [&](std::uint64_t at, std::int64_t depth) {
+            if(depth <= depths[at]) return;
+            depths[at] = depth;
+            work.push_back(at);
+        };
+        
+        while(!work.empty()) {
+            auto at = work.back();
+            work.pop_back();
+            if(at == il_.size()) continue;
+            
+            const auto& inst = il_[at];
+            auto depth = depths[at];
+            if(inst.isResolved() && inst.isComplete() && inst.code() != Opcode::nop) {
+                int pops = 0, pushes = 0;
+                inst.effect(pops, pushes);
+                depth = std::max<std::int64_t>(depth - pops, 0) + pushes;
+                deepest = std::max(deepest, depth);
+                if(deepest >= UINT16_MAX) return UINT16_MAX;
+                if(!inst.label().empty()) visit(symbols_.at(inst.label()), depth);
+                if(isTerminator(inst.code())) continue;
+            }
+            visit(at + 1, depth);
+        }
+        return deepest;
+    }
+    
     Program::Function ILFunction::build() const {
         Program::Function function;
         function.bytecode.clear();
         function.variableCount = locals_.size();
+        function.stackDepth = stackDepth();
         function.arity = arity_;
+        function.paramTypes = paramTypes_;
+        function.returnType = returnType_;
         for(const auto& inst: il_) {
             inst.write(function);
         }
@@ -167,10 +595,38 @@ namespace tinyscript {
     void ILFunction::dump(std::ostream &out) const {
         for(const auto& inst: il_) {
             out << "\t" << inst.code();
-            switch (inst.size()) {
-                case 2: out << " \t#" << (inst.operand() & 0x00ff); break;
-                case 3: out << " \t->" << (inst.operand() & 0xffff); break;
-                default: break;
+            if(!inst.label().empty() && inst.hasSignedOffset()) {
+                if(inst.size() == 4) {
+                    out << " \t#" << ((inst.operand() >> 16) & 0x00ff) << ",";
+                }
+                else if(inst.size() == 6) {
+                    out << " \t#" << ((inst.operand() >> 32) & 0x00ff)
+                        << ", $" << static_cast<std::int16_t>(inst.operand() >> 16) << ",";
+                }
+                out << " \t->" << static_cast<std::int16_t>(inst.operand()) << std::endl;
+                continue;
+            }
+            switch (inst.code()) {
+                case Opcode::load_i:
+                case Opcode::iadd_i:
+                case Opcode::isub_i:
+                    out << " \t$" << static_cast<std::int16_t>(inst.operand());
+                    break;
+                case Opcode::inc_l:
+                    out << " \t#" << ((inst.operand() >> 8) & 0x00ff)
+                        << ", $" << static_cast<int>(static_cast<std::int8_t>(inst.operand()));
+                    break;
+                default:
+                    switch (inst.size()) {
+                        case 2: out << " \t#" << (inst.operand() & 0x00ff); break;
+                        case 3: out << (inst.code() == Opcode::call_n || inst.code() == Opcode::tail_n ? " \t@" : " \t->") << (inst.operand() & 0xffff); break;
+                        case 4:
+                            out << " \t#" << ((inst.operand() >> 16) & 0x00ff)
+                                << ", $" << static_cast<std::int16_t>(inst.operand());
+                            break;
+                        default: break;
+                    }
+                    break;
             }
             out << std::endl;
         }
@@ -181,20 +637,81 @@ namespace tinyscript {
     
     ILFunction& ILBuilder::openFunction(const std::string& signature, std::uint8_t arity) {
         assert(current_ == nullptr && "a function is already opened");
-        assert(functions_.find(signature) == functions_.end() && "function already exists");
-        functions_[signature] = ILFunction(arity);
-        current_ = &functions_.at(signature);
+        auto index = function(signature);
+        assert(!defined_[index] && "function already exists");
+        functions_[index] = ILFunction(signature, arity);
+        defined_[index] = true;
+        current_ = &functions_[index];
         return *current_;
     }
     
+    // Functions are numbered in the order they are first referenced, so calls can be emitted with
+    // their final index even before the callee's body is compiled.
+    std::uint16_t ILBuilder::function(const std::string& signature) {
+        auto it = symbols_.find(signature);
+        if(it != symbols_.end()) return it->second;
+        assert(functions_.size() < 0x10000 && "functions overflow");
+        std::uint16_t index = functions_.size();
+        functions_.emplace_back(signature);
+        defined_.push_back(false);
+        symbols_[signature] = index;
+        return index;
+    }
+    
     void ILBuilder::closeFunction() {
         assert(current_ != nullptr && "no open function");
-        current_->resolveReferences();
         current_ = nullptr;
     }
     
-    void ILBuilder::closeScript() {
+    void ILBuilder::closeScript(std::uint8_t optLevel) {
+        // Calls to functions that were never defined (already reported by Sema) fail at runtime
+        // rather than jumping into an empty body.
+        for(std::uint16_t i = 0; i < functions_.size(); ++i) {
+            if(defined_[i]) continue;
+            auto message = constant("undefined function '" + functions_[i].signature() + "'");
+            auto& function = openFunction(functions_[i].signature(), 0);
+            function.addInstruction(Opcode::fail).setOperand8(message);
+            function.finishInstruction();
+            closeFunction();
+        }
+        
+        if(optLevel > 0) {
+            Inliner(functions_).run(script_);
+            script_.optimize(optLevel);
+            for(auto& function: functions_) {
+                function.optimize(optLevel);
+            }
+            pruneConstants();
+        }
+        script_.tailCalls();
         script_.resolveReferences();
+        for(auto& function: functions_) {
+            function.tailCalls();
+            function.resolveReferences();
+        }
+    }
+    
+    // Folding and dead code removal can leave constants that nothing loads anymore.
+    void ILBuilder::pruneConstants() {
+        std::vector<bool> used(constants_.size(), false);
+        script_.markConstants(used);
+        for(const auto& function: functions_) {
+            function.markConstants(used);
+        }
+        
+        std::vector<std::uint8_t> map(constants_.size(), 0);
+        std::vector<Value> constants;
+        for(std::uint64_t i = 0; i < constants_.size(); ++i) {
+            if(!used[i]) continue;
+            map[i] = constants.size();
+            constants.push_back(constants_[i]);
+        }
+        constants_ = std::move(constants);
+        
+        script_.remapConstants(map);
+        for(auto& function: functions_) {
+            function.remapConstants(map);
+        }
     }
     
     std::uint8_t ILBuilder::constant(std::int64_t num) {
@@ -207,7 +724,7 @@ namespace tinyscript {
         return constants_.size()-1;
     }
     
-    std::uint8_t ILBuilder::constant(float num) {
+    std::uint8_t ILBuilder::constant(double num) {
         auto val = Value::Float(num);
         for(uint8_t i = 0; i < constants_.size(); ++i) {
             if(constants_[i] == val) return i;
@@ -218,7 +735,7 @@ namespace tinyscript {
     }
     
     std::uint8_t ILBuilder::constant(const std::string& str) {
-        Value val(str);
+        auto val = strings_.intern(str);
         for(uint8_t i = 0; i < constants_.size(); ++i) {
             if(constants_[i] == val) return i;
         }
@@ -227,6 +744,15 @@ namespace tinyscript {
         return constants_.size()-1;
     }
     
+    std::uint8_t ILBuilder::import(const std::string& signature) {
+        for(uint8_t i = 0; i < imports_.size(); ++i) {
+            if(imports_[i] == signature) return i;
+        }
+        assert(imports_.size() < 256 && "imports overflow");
+        imports_.push_back(signature);
+        return imports_.size()-1;
+    }
+    
     void ILBuilder::dump(std::ostream &out) const {
         out << "Constants:" << std::endl;
         int i = 0;
@@ -241,27 +767,78 @@ namespace tinyscript {
             out << std::endl;
         }
         
+        out << "Imports:" << std::endl;
+        i = 0;
+        for(const auto& signature: imports_) {
+            out << "  " << i++ << ":\t" << signature << std::endl;
+        }
+        
         out << "--bytecode (main script):" << std::endl;
         script_.dump(out);
         
-        for(const auto& pair: functions_) {
-            out << "--bytecode (" << pair.first << "):" << std::endl;
-            pair.second.dump(out);
+        for(const auto& function: functions_) {
+            out << "--bytecode (" << function.signature() << "):" << std::endl;
+            function.dump(out);
         }
         out << "--done" << std::endl;
     }
     
-    void ILBuilder::write(tinyscript::Program &program) const {
+    void ILBuilder::write(tinyscript::Program &program, Program::Encoding encoding) const {
         program.constants.clear();
         program.functions.clear();
         
         for(const auto& c: constants_) {
             program.constants.push_back(c);
         }
+        program.imports = imports_;
         
+        program.encoding = Program::Encoding::Stack;
         program.script = script_.build();
-        for(const auto& pair: functions_) {
-            program.functions[pair.first] = pair.second.build();
+        for(const auto& function: functions_) {
+            program.functions.push_back(function.build());
+        }
+        program.symbols = symbols_;
+        
+        if(encoding == Program::Encoding::Registers && !writeRegisters(program)) {
+            std::cerr << "warning: program cannot be lowered to registers, using stack bytecode" << std::endl;
+        }
+        if(encoding == Program::Encoding::Typed && !writeTyped(program)) {
+            std::cerr << "warning: program cannot be lowered to typed bytecode, using stack bytecode" << std::endl;
+        }
+    }
+    
+    // Both encodings use different calling conventions, so the whole program is lowered or none of it.
+    bool ILBuilder::writeRegisters(Program& program) const {
+        Program::Function script;
+        if(!RegisterBuilder(script_).build(script)) return false;
+        
+        Program::FunctionTable functions(functions_.size());
+        for(std::uint64_t i = 0; i < functions_.size(); ++i) {
+            if(!RegisterBuilder(functions_[i]).build(functions[i])) return false;
+        }
+        program.encoding = Program::Encoding::Registers;
+        program.script = std::move(script);
+        program.functions = std::move(functions);
+        return true;
+    }
+    
+    // Imports are split by the argument types they are called with, which typed code boxes them from.
+    bool ILBuilder::writeTyped(Program& program) const {
+        std::vector<std::string> imports;
+        std::vector<std::vector<Type>> importTypes;
+        
+        Program::Function script;
+        if(!TypedBuilder(script_, constants_, imports_).build(script, imports, importTypes)) return false;
+        
+        Program::FunctionTable functions(functions_.size());
+        for(std::uint64_t i = 0; i < functions_.size(); ++i) {
+            if(!TypedBuilder(functions_[i], constants_, imports_).build(functions[i], imports, importTypes)) return false;
         }
+        program.encoding = Program::Encoding::Typed;
+        program.script = std::move(script);
+        program.functions = std::move(functions);
+        program.imports = std::move(imports);
+        program.importTypes = std::move(importTypes);
+        return true;
     }
 }
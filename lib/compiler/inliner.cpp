@@ -0,0 +1,141 @@
+//
+//  inliner.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <tinyscript/compiler/inliner.hpp>
+
+namespace tinyscript {
+    
+    // Bodies are counted in IL instructions, after peephole optimizations.
+    static constexpr std::uint64_t maxInlineSize = 16;
+    // Callers stop growing past this size, well before jumps in them get too far.
+    static constexpr std::uint64_t maxCallerSize = 2048;
+    
+    static std::multimap<std::uint64_t, std::string> labelsAt(const std::map<std::string, std::uint64_t>& symbols) {
+        std::multimap<std::uint64_t, std::string> labels;
+        for(const auto& pair: symbols) {
+            labels.emplace(pair.second, pair.first);
+        }
+        return labels;
+    }
+    
+    Inliner::Inliner(std::deque<ILFunction>& functions)
+    : functions_(functions)
+    , state_(functions.size(), State::Pending)
+    , recursive_(functions.size(), false) {}
+    
+    void Inliner::run(ILFunction& script) {
+        for(std::uint16_t i = 0; i < functions_.size(); ++i) {
+            if(state_[i] == State::Pending) visit(i);
+        }
+        script.peepholePass();
+        inlineCalls(script);
+    }
+    
+    // A call to a function still being visited closes a cycle, which is never inlined.
+    void Inliner::visit(std::uint16_t index) {
+        auto& function = functions_[index];
+        state_[index] = State::Visiting;
+        for(const auto& inst: function.il_) {
+            if(inst.code() != Opcode::call_n) continue;
+            auto callee = inst.operand();
+            if(state_[callee] == State::Visiting) recursive_[callee] = true;
+            else if(state_[callee] == State::Pending) visit(callee);
+        }
+        function.peepholePass();
+        inlineCalls(function);
+        state_[index] = State::Done;
+    }
+    
+    // Statements leave the operand stack empty, so the result is the only thing on it when the
+    // callee returns. Functions returning a value that can still reach a plain `ret` (or the
+    // other way around) are left alone.
+    bool Inliner::canInline(const ILInstruction& call, const ILFunction& caller) const {
+        auto index = call.operand();
+        if(state_[index] != State::Done || recursive_[index]) return false;
+        
+        const auto& callee = functions_[index];
+        if(callee.il_.size() > maxInlineSize) return false;
+        if(callee.arity_ != call.callArity() || callee.locals_.size() < callee.arity_) return false;
+        if(caller.locals_.size() + callee.locals_.size() > 256) return false;
+        
+        bool returns = callee.returnType_ != Type::Void;
+        if(call.callResult() != returns) return false;
+        for(const auto& inst: callee.il_) {
+            if(!inst.isComplete() || inst.code() == Opcode::halt) return false;
+            if(inst.code() == (returns ? Opcode::ret : Opcode::ret_v)) return false;
+        }
+        return true;
+    }
+    
+    void Inliner::inlineCalls(ILFunction& caller) {
+        auto labels = labelsAt(caller.symbols_);
+        std::vector<ILInstruction> il;
+        std::map<std::string, std::uint64_t> symbols;
+        bool changed = false;
+        
+        for(std::uint64_t i = 0; i <= caller.il_.size(); ++i) {
+            auto range = labels.equal_range(i);
+            for(auto it = range.first; it != range.second; ++it) {
+                symbols[it->second] = il.size();
+            }
+            if(i == caller.il_.size()) break;
+            
+            const auto& inst = caller.il_[i];
+            if(inst.code() == Opcode::call_n && il.size() < maxCallerSize && canInline(inst, caller)) {
+                expand(functions_[inst.operand()], caller, il, symbols);
+                changed = true;
+                continue;
+            }
+            il.push_back(inst);
+        }
+        if(!changed) return;
+        
+        caller.il_ = std::move(il);
+        caller.symbols_ = std::move(symbols);
+        caller.pc_ = caller.il_.size();
+        caller.current_ = nullptr;
+        caller.peepholePass();
+    }
+    
+    // The arguments are on the stack in order, so they are stored to the parameters last first.
+    void Inliner::expand(const ILFunction& callee, ILFunction& caller,
+                         std::vector<ILInstruction>& il, std::map<std::string, std::uint64_t>& symbols) {
+        auto prefix = "inline_" + std::to_string(siteID_++) + "_";
+        auto end = prefix + "end";
+        
+        std::vector<std::uint8_t> slots;
+        for(const auto& name: callee.locals_) {
+            slots.push_back(caller.local(callee.signature() + "." + name));
+        }
+        for(auto i = callee.arity_; i > 0; --i) {
+            ILInstruction store(Opcode::store, 0);
+            store.setOperand8(slots[i-1]);
+            il.push_back(store);
+        }
+        
+        auto labels = labelsAt(callee.symbols_);
+        for(std::uint64_t i = 0; i <= callee.il_.size(); ++i) {
+            auto range = labels.equal_range(i);
+            for(auto it = range.first; it != range.second; ++it) {
+                symbols[prefix + it->second] = il.size();
+            }
+            if(i == callee.il_.size()) break;
+            
+            auto inst = callee.il_[i];
+            if(inst.code() == Opcode::ret || inst.code() == Opcode::ret_v) {
+                ILInstruction jump(Opcode::jmp, 0);
+                jump.setLabel(end);
+                il.push_back(jump);
+                continue;
+            }
+            if(!inst.label().empty()) inst.setLabel(prefix + inst.label(), inst.operand());
+            if(inst.slot() >= 0) inst.setSlot(slots[inst.slot()]);
+            il.push_back(inst);
+        }
+        symbols[end] = il.size();
+    }
+}
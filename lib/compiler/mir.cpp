@@ -0,0 +1,693 @@
+//
+//  mir.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cassert>
+#include <algorithm>
+#include <tinyscript/compiler/mir.hpp>
+
+namespace tinyscript {
+    
+    // Number of stack values an instruction consumes, or -1 for the ones the IR doesn't model.
+    static int popCount(const ILInstruction& inst) {
+        switch(inst.code()) {
+            case Opcode::halt:
+            case Opcode::load_c:
+            case Opcode::load_i:
+            case Opcode::load_yes:
+            case Opcode::load_no:
+            case Opcode::load:
+            case Opcode::inc_l:
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::jilt_li:
+            case Opcode::jilteq_li:
+            case Opcode::jigt_li:
+            case Opcode::jigteq_li:
+            case Opcode::jieq_li:
+            case Opcode::jine_li:
+            case Opcode::loop_next:
+            case Opcode::yield:
+            case Opcode::ret:
+            case Opcode::fail:
+                return 0;
+            
+            case Opcode::store:
+            case Opcode::pop:
+            case Opcode::fmin:
+            case Opcode::imin:
+            case Opcode::iadd_i:
+            case Opcode::isub_i:
+            case Opcode::i2f:
+            case Opcode::f2i:
+            case Opcode::jnz:
+            case Opcode::rjnz:
+            case Opcode::jz:
+            case Opcode::rjz:
+            case Opcode::loop_enter:
+            case Opcode::yield_v:
+            case Opcode::ret_v:
+                return 1;
+            
+            case Opcode::fadd:
+            case Opcode::fsub:
+            case Opcode::fmul:
+            case Opcode::fdiv:
+            case Opcode::iadd:
+            case Opcode::isub:
+            case Opcode::imul:
+            case Opcode::idiv:
+            case Opcode::sadd:
+            case Opcode::log_and:
+            case Opcode::log_or:
+            case Opcode::test_flt:
+            case Opcode::test_flteq:
+            case Opcode::test_fgt:
+            case Opcode::test_fgteq:
+            case Opcode::test_feq:
+            case Opcode::test_ilt:
+            case Opcode::test_ilteq:
+            case Opcode::test_igt:
+            case Opcode::test_igteq:
+            case Opcode::test_ieq:
+            case Opcode::test_seq:
+            case Opcode::jilt:
+            case Opcode::jilteq:
+            case Opcode::jigt:
+            case Opcode::jigteq:
+            case Opcode::jieq:
+            case Opcode::jine:
+            case Opcode::jflt:
+            case Opcode::jflteq:
+            case Opcode::jfgt:
+            case Opcode::jfgteq:
+            case Opcode::jfeq:
+            case Opcode::jfne:
+            case Opcode::jseq:
+            case Opcode::jsne:
+                return 2;
+            
+            case Opcode::call_n:
+            case Opcode::call_f:
+                return inst.callArity();
+            
+            default:
+                return -1;
+        }
+    }
+    
+    // Instructions without side effects, that only compute a value out of their operands.
+    static bool isPure(Opcode code) {
+        switch(code) {
+            case Opcode::load_c:
+            case Opcode::load_i:
+            case Opcode::load_yes:
+            case Opcode::load_no:
+            case Opcode::load:
+            case Opcode::fmin:
+            case Opcode::fadd:
+            case Opcode::fsub:
+            case Opcode::fmul:
+            case Opcode::fdiv:
+            case Opcode::imin:
+            case Opcode::iadd:
+            case Opcode::isub:
+            case Opcode::imul:
+            case Opcode::iadd_i:
+            case Opcode::isub_i:
+            case Opcode::i2f:
+            case Opcode::f2i:
+            case Opcode::sadd:
+            case Opcode::log_and:
+            case Opcode::log_or:
+            case Opcode::test_flt:
+            case Opcode::test_flteq:
+            case Opcode::test_fgt:
+            case Opcode::test_fgteq:
+            case Opcode::test_feq:
+            case Opcode::test_ilt:
+            case Opcode::test_ilteq:
+            case Opcode::test_igt:
+            case Opcode::test_igteq:
+            case Opcode::test_ieq:
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+            case Opcode::test_seq:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    static bool pushesValue(const ILInstruction& inst) {
+        if(inst.code() == Opcode::call_n || inst.code() == Opcode::call_f) return inst.callResult();
+        return isPure(inst.code()) || inst.code() == Opcode::idiv;
+    }
+    
+    static bool isLeaf(Opcode code) {
+        switch(code) {
+            case Opcode::load_c:
+            case Opcode::load_i:
+            case Opcode::load_yes:
+            case Opcode::load_no:
+            case Opcode::load:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    static bool readsSlot(Opcode code) {
+        return code != Opcode::store && code != Opcode::loop_enter;
+    }
+    
+    static bool writesSlot(Opcode code) {
+        switch(code) {
+            case Opcode::store:
+            case Opcode::inc_l:
+            case Opcode::loop_enter:
+            case Opcode::loop_next:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    static bool endsBlock(const ILInstruction& inst) {
+        switch(inst.code()) {
+            case Opcode::halt:
+            case Opcode::ret:
+            case Opcode::ret_v:
+            case Opcode::fail:
+                return true;
+            default:
+                return !inst.label().empty();
+        }
+    }
+    
+    static bool fallsThrough(Opcode code) {
+        switch(code) {
+            case Opcode::halt:
+            case Opcode::ret:
+            case Opcode::ret_v:
+            case Opcode::fail:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+                return false;
+            default:
+                return true;
+        }
+    }
+    
+    MIRFunction::MIRFunction(const ILFunction& function)
+        : arity_(function.arity_), localCount_(function.locals_.size()) {
+        valid_ = parse(function);
+        if(!valid_) return;
+        buildSSA();
+    }
+    
+    // MARK: - Building the IR
+    
+    std::uint32_t MIRFunction::addNode(const ILInstruction& inst, std::vector<std::uint32_t> args) {
+        Node node{inst};
+        node.pure = isPure(inst.code());
+        for(auto arg: args) node.pure = node.pure && nodes_[arg].pure;
+        node.args = std::move(args);
+        nodes_.push_back(node);
+        return nodes_.size() - 1;
+    }
+    
+    // The function's entry gets an empty block of its own, so the first instruction can be the
+    // target of a jump without losing the values locals have when the function is called.
+    bool MIRFunction::parse(const ILFunction& function) {
+        const auto& il = function.il_;
+        auto targets = function.jumpTargets();
+        
+        std::vector<std::uint64_t> starts;
+        for(std::uint64_t i = 0; i < il.size(); ++i) {
+            if(i == 0 || targets[i] || endsBlock(il[i-1])) starts.push_back(i);
+        }
+        if(starts.empty() || targets[il.size()]) starts.push_back(il.size());
+        
+        std::map<std::uint64_t, std::uint32_t> blockAt;
+        blocks_.resize(starts.size() + 1);
+        for(std::uint32_t i = 0; i < starts.size(); ++i) {
+            blockAt[starts[i]] = i + 1;
+            auto end = i + 1 < starts.size() ? starts[i+1] : il.size();
+            if(!parseBlock(il, starts[i], end, blocks_[i+1])) return false;
+        }
+        
+        for(const auto& pair: function.symbols_) {
+            if(!targets[pair.second]) continue;
+            blocks_[blockAt[pair.second]].labels.push_back(pair.first);
+        }
+        
+        auto link = [this](std::uint32_t from, std::uint32_t to) {
+            blocks_[from].succs.push_back(to);
+            blocks_[to].preds.push_back(from);
+        };
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            auto& block = blocks_[b];
+            bool falls = true;
+            if(!block.roots.empty()) {
+                const auto& inst = nodes_[block.roots.back()].inst;
+                if(!inst.label().empty()) link(b, blockAt[function.symbols_.at(inst.label())]);
+                falls = fallsThrough(inst.code());
+            }
+            if(falls && b + 1 < blocks_.size()) link(b, b + 1);
+        }
+        return true;
+    }
+    
+    // Trees are only rebuilt for statements that leave the stack empty: anything else (values
+    // left over by expression statements, or on the stack across jumps) isn't handled.
+    bool MIRFunction::parseBlock(const std::vector<ILInstruction>& il, std::uint64_t begin, std::uint64_t end, Block& block) {
+        std::vector<std::uint32_t> stack;
+        
+        for(std::uint64_t i = begin; i < end; ++i) {
+            const auto& inst = il[i];
+            if(inst.code() == Opcode::nop) continue;
+            
+            // dup; ...; dup; store x -> store x; load x; ...; load x
+            if(inst.code() == Opcode::dup) {
+                auto count = 0;
+                while(i + count < end && il[i + count].code() == Opcode::dup) count += 1;
+                if(i + count >= end || il[i + count].code() != Opcode::store || stack.size() != 1) return false;
+                
+                const auto& store = il[i + count];
+                block.roots.push_back(addNode(store, {stack.back()}));
+                stack.pop_back();
+                for(auto j = 0; j < count; ++j) {
+                    ILInstruction load(Opcode::load, 0);
+                    load.setOperand8(store.slot());
+                    stack.push_back(addNode(load, {}));
+                }
+                i += count;
+                continue;
+            }
+            
+            auto pops = popCount(inst);
+            if(pops < 0 || stack.size() < static_cast<std::uint64_t>(pops)) return false;
+            std::vector<std::uint32_t> args(stack.end() - pops, stack.end());
+            stack.erase(stack.end() - pops, stack.end());
+            
+            auto node = addNode(inst, std::move(args));
+            if(pushesValue(inst)) {
+                stack.push_back(node);
+            } else {
+                if(!stack.empty()) return false;
+                block.roots.push_back(node);
+            }
+        }
+        return stack.empty();
+    }
+    
+    // MARK: - SSA construction
+    
+    // Locals are put in SSA form on the fly as blocks are filled in, sealing each block once all
+    // its predecessors have been visited (Braun et al., "Simple and Efficient Construction of
+    // Static Single Assignment Form").
+    void MIRFunction::buildSSA() {
+        for(std::uint16_t slot = 0; slot < localCount_; ++slot) {
+            undefined_.push_back(newValue());
+            values_.back().home = slot;
+        }
+        
+        std::vector<bool> filled(blocks_.size(), false);
+        for(auto& block: blocks_) {
+            block.sealed = block.preds.empty();
+        }
+        
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            for(auto root: blocks_[b].roots) {
+                number(b, root);
+            }
+            filled[b] = true;
+            
+            for(auto succ: blocks_[b].succs) {
+                if(blocks_[succ].sealed) continue;
+                const auto& preds = blocks_[succ].preds;
+                if(std::all_of(preds.begin(), preds.end(), [&](std::uint32_t p) { return filled[p]; }))
+                    sealBlock(succ);
+            }
+        }
+    }
+    
+    void MIRFunction::number(std::uint32_t block, std::uint32_t n) {
+        for(auto arg: nodes_[n].args) {
+            number(block, arg);
+        }
+        
+        auto& node = nodes_[n];
+        auto code = node.inst.code();
+        auto slot = node.inst.slot();
+        if(slot >= 0 && readsSlot(code)) node.read = readVariable(slot, block);
+        
+        if(code == Opcode::load) {
+            node.value = node.read;
+        } else if(code == Opcode::store || code == Opcode::loop_enter) {
+            node.value = find(nodes_[node.args[0]].value);
+        } else if(node.pure || code == Opcode::inc_l) {
+            // Pure instructions are numbered by their operands' values, which is what lets
+            // redundant computations be found.
+            std::int64_t operand = node.inst.operand();
+            if(code == Opcode::inc_l) operand &= 0x00ff;
+            else if(slot >= 0) operand &= 0xffff;
+            
+            std::vector<std::int64_t> key{code, operand, node.read};
+            for(auto arg: node.args) {
+                key.push_back(find(nodes_[arg].value));
+            }
+            auto it = numbers_.find(key);
+            if(it != numbers_.end()) {
+                node.value = it->second;
+            } else {
+                node.value = newValue();
+                numbers_[key] = node.value;
+            }
+        } else if(pushesValue(node.inst) || code == Opcode::loop_next) {
+            node.value = newValue();
+        }
+        
+        if(slot >= 0 && writesSlot(code)) {
+            blocks_[block].defs[slot] = node.value;
+            auto& value = values_[find(node.value)];
+            if(value.home < 0) value.home = slot;
+        }
+    }
+    
+    std::int32_t MIRFunction::newValue() {
+        SSAValue value;
+        value.forward = values_.size();
+        values_.push_back(value);
+        return values_.size() - 1;
+    }
+    
+    std::int32_t MIRFunction::find(std::int32_t value) const {
+        while(values_[value].forward != value) value = values_[value].forward;
+        return value;
+    }
+    
+    std::int32_t MIRFunction::readVariable(std::uint8_t slot, std::uint32_t b) {
+        auto& block = blocks_[b];
+        auto it = block.defs.find(slot);
+        if(it != block.defs.end()) return find(it->second);
+        
+        std::int32_t value;
+        if(!block.sealed) {
+            value = newValue();
+            values_[value].isPhi = true;
+            values_[value].block = b;
+            values_[value].slot = slot;
+            values_[value].home = slot;
+            block.incomplete[slot] = value;
+            block.entry[slot] = value;
+        } else {
+            value = entryValue(slot, b);
+        }
+        blocks_[b].defs[slot] = value;
+        return value;
+    }
+    
+    // Value of a local when a block starts. It can be asked for after the block is filled in,
+    // while readVariable() only knows about the value the local ends the block with.
+    std::int32_t MIRFunction::entryValue(std::uint8_t slot, std::uint32_t b) {
+        auto it = blocks_[b].entry.find(slot);
+        if(it != blocks_[b].entry.end()) return find(it->second);
+        
+        std::int32_t value;
+        const auto preds = blocks_[b].preds;
+        if(preds.empty()) {
+            value = undefined_[slot];
+        } else if(preds.size() == 1) {
+            value = readVariable(slot, preds[0]);
+        } else {
+            value = newValue();
+            values_[value].isPhi = true;
+            values_[value].block = b;
+            values_[value].slot = slot;
+            values_[value].home = slot;
+            blocks_[b].entry[slot] = value;
+            value = addPhiOperands(value);
+        }
+        blocks_[b].entry[slot] = value;
+        return value;
+    }
+    
+    std::int32_t MIRFunction::addPhiOperands(std::int32_t phi) {
+        const auto preds = blocks_[values_[phi].block].preds;
+        auto slot = values_[phi].slot;
+        for(auto pred: preds) {
+            auto operand = readVariable(slot, pred);
+            values_[phi].operands.push_back(operand);
+            if(values_[operand].isPhi) values_[operand].users.push_back(phi);
+        }
+        return tryRemoveTrivialPhi(phi);
+    }
+    
+    std::int32_t MIRFunction::tryRemoveTrivialPhi(std::int32_t phi) {
+        std::int32_t same = -1;
+        for(auto operand: values_[phi].operands) {
+            operand = find(operand);
+            if(operand == same || operand == phi) continue;
+            if(same >= 0) return phi;
+            same = operand;
+        }
+        if(same < 0) same = undefined_[values_[phi].slot];
+        
+        values_[phi].forward = same;
+        const auto users = values_[phi].users;
+        for(auto user: users) {
+            if(user != phi && find(user) == user) tryRemoveTrivialPhi(user);
+        }
+        return find(same);
+    }
+    
+    void MIRFunction::sealBlock(std::uint32_t b) {
+        const auto incomplete = blocks_[b].incomplete;
+        blocks_[b].sealed = true;
+        for(const auto& pair: incomplete) {
+            addPhiOperands(pair.second);
+        }
+        blocks_[b].incomplete.clear();
+    }
+    
+    // MARK: - Passes
+    
+    void MIRFunction::optimize() {
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            std::vector<std::int32_t> current(localCount_, -1);
+            for(auto root: blocks_[b].roots) {
+                propagate(b, root, current);
+            }
+        }
+        while(eliminateDeadStores()) {}
+        removeUnusedLocals();
+    }
+    
+    std::int32_t MIRFunction::currentValue(std::uint32_t block, std::uint8_t slot, std::vector<std::int32_t>& current) {
+        if(current[slot] < 0) current[slot] = entryValue(slot, block);
+        return find(current[slot]);
+    }
+    
+    // Walks a block's trees in evaluation order, keeping track of the value each local holds.
+    // A pure computation whose value is already held by a local (common subexpression), or a
+    // load of a copy whose original still holds the same value (copy propagation), both become
+    // loads of that local. Storing the value a local already holds is dropped.
+    void MIRFunction::propagate(std::uint32_t block, std::uint32_t n, std::vector<std::int32_t>& current) {
+        auto code = nodes_[n].inst.code();
+        if(nodes_[n].pure && !isLeaf(code)) {
+            auto value = find(nodes_[n].value);
+            auto home = values_[value].home;
+            if(home >= 0 && currentValue(block, home, current) == value) {
+                ILInstruction load(Opcode::load, 0);
+                load.setOperand8(home);
+                nodes_[n].inst = load;
+                nodes_[n].args.clear();
+                nodes_[n].read = value;
+                return;
+            }
+        }
+        
+        for(auto arg: nodes_[n].args) {
+            propagate(block, arg, current);
+        }
+        
+        auto& node = nodes_[n];
+        auto slot = node.inst.slot();
+        if(slot < 0) return;
+        
+        if(!writesSlot(code)) {
+            auto value = find(node.read);
+            auto home = values_[value].home;
+            if(home >= 0 && home != slot && currentValue(block, home, current) == value) {
+                node.inst.setSlot(home);
+            }
+            return;
+        }
+        
+        auto value = find(node.value);
+        if(code == Opcode::store && nodes_[node.args[0]].pure && currentValue(block, slot, current) == value) {
+            node.removed = true;
+        }
+        current[slot] = value;
+    }
+    
+    // Stores to locals that aren't read anymore before being overwritten are removed, as long as
+    // the value stored has no side effects.
+    bool MIRFunction::eliminateDeadStores() {
+        std::vector<std::vector<bool>> use(blocks_.size(), std::vector<bool>(localCount_, false));
+        std::vector<std::vector<bool>> def(blocks_.size(), std::vector<bool>(localCount_, false));
+        
+        std::vector<std::uint32_t> order;
+        auto visit = [&](std::uint32_t root) {
+            order.clear();
+            std::vector<std::uint32_t> pending{root};
+            while(!pending.empty()) {
+                auto n = pending.back();
+                pending.pop_back();
+                order.push_back(n);
+                for(auto arg: nodes_[n].args) pending.push_back(arg);
+            }
+        };
+        
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            for(auto root: blocks_[b].roots) {
+                if(nodes_[root].removed) continue;
+                visit(root);
+                for(auto it = order.rbegin(); it != order.rend(); ++it) {
+                    const auto& node = nodes_[*it];
+                    auto slot = node.inst.slot();
+                    if(slot < 0) continue;
+                    if(readsSlot(node.inst.code()) && !def[b][slot]) use[b][slot] = true;
+                    if(writesSlot(node.inst.code())) def[b][slot] = true;
+                }
+            }
+        }
+        
+        std::vector<std::vector<bool>> liveOut(blocks_.size(), std::vector<bool>(localCount_, false));
+        std::vector<std::vector<bool>> liveIn = use;
+        bool changed = true;
+        while(changed) {
+            changed = false;
+            for(std::int64_t b = blocks_.size() - 1; b >= 0; --b) {
+                for(auto succ: blocks_[b].succs) {
+                    for(std::uint16_t slot = 0; slot < localCount_; ++slot) {
+                        if(!liveIn[succ][slot] || liveOut[b][slot]) continue;
+                        liveOut[b][slot] = true;
+                        if(!def[b][slot] && !liveIn[b][slot]) liveIn[b][slot] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        
+        bool removed = false;
+        for(std::uint32_t b = 0; b < blocks_.size(); ++b) {
+            auto live = liveOut[b];
+            const auto& roots = blocks_[b].roots;
+            for(auto root = roots.rbegin(); root != roots.rend(); ++root) {
+                auto& node = nodes_[*root];
+                if(node.removed) continue;
+                auto code = node.inst.code();
+                auto slot = node.inst.slot();
+                
+                if(slot >= 0 && !live[slot]
+                   && ((code == Opcode::store && nodes_[node.args[0]].pure) || code == Opcode::inc_l)) {
+                    node.removed = true;
+                    removed = true;
+                    continue;
+                }
+                
+                visit(*root);
+                for(auto n: order) {
+                    const auto& inst = nodes_[n].inst;
+                    if(inst.slot() >= 0 && writesSlot(inst.code())) live[inst.slot()] = false;
+                }
+                for(auto n: order) {
+                    const auto& inst = nodes_[n].inst;
+                    if(inst.slot() >= 0 && readsSlot(inst.code())) live[inst.slot()] = true;
+                }
+            }
+        }
+        return removed;
+    }
+    
+    void MIRFunction::markLocals(std::uint32_t n, std::vector<bool>& used) const {
+        auto slot = nodes_[n].inst.slot();
+        if(slot >= 0) used[slot] = true;
+        for(auto arg: nodes_[n].args) {
+            markLocals(arg, used);
+        }
+    }
+    
+    // Locals that nothing reads or writes anymore are compacted away. Parameters keep their slot.
+    void MIRFunction::removeUnusedLocals() {
+        std::vector<bool> used(localCount_, false);
+        for(std::uint16_t slot = 0; slot < arity_ && slot < localCount_; ++slot) {
+            used[slot] = true;
+        }
+        for(const auto& block: blocks_) {
+            for(auto root: block.roots) {
+                if(!nodes_[root].removed) markLocals(root, used);
+            }
+        }
+        
+        std::int16_t next = 0;
+        slotMap_.assign(localCount_, -1);
+        for(std::uint16_t slot = 0; slot < localCount_; ++slot) {
+            if(used[slot]) slotMap_[slot] = next++;
+        }
+    }
+    
+    // MARK: - Lowering
+    
+    void MIRFunction::emit(std::uint32_t n, std::vector<ILInstruction>& il) const {
+        for(auto arg: nodes_[n].args) {
+            emit(arg, il);
+        }
+        auto inst = nodes_[n].inst;
+        if(inst.slot() >= 0) {
+            assert(slotMap_[inst.slot()] >= 0 && "local was removed");
+            inst.setSlot(slotMap_[inst.slot()]);
+        }
+        il.push_back(inst);
+    }
+    
+    void MIRFunction::lower(ILFunction& function) const {
+        assert(valid_ && "lowering an invalid function");
+        std::vector<ILInstruction> il;
+        std::map<std::string, std::uint64_t> symbols;
+        
+        for(const auto& block: blocks_) {
+            for(const auto& label: block.labels) {
+                symbols[label] = il.size();
+            }
+            for(auto root: block.roots) {
+                if(!nodes_[root].removed) emit(root, il);
+            }
+        }
+        
+        std::vector<std::string> locals;
+        for(std::uint16_t slot = 0; slot < localCount_; ++slot) {
+            if(slotMap_[slot] >= 0) locals.push_back(function.locals_[slot]);
+        }
+        
+        function.il_ = std::move(il);
+        function.symbols_ = std::move(symbols);
+        function.locals_ = std::move(locals);
+        function.pc_ = function.il_.size();
+        function.current_ = nullptr;
+    }
+}
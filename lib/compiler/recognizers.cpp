@@ -23,7 +23,7 @@ namespace tinyscript {
             else if(have(Token::Kind::kw_func))
                 recFuncDecl();
             else if(haveTerm())
-                recExpression(0);
+                recExpressionStatement();
             else if(have(Token::Kind::kw_until))
                 recUntilLoop();
             else if(have(Token::Kind::kw_loop))
@@ -40,20 +40,28 @@ namespace tinyscript {
         }
     }
     
+    // The value of an expression used as a statement, like the result of a call, is dropped.
+    void Compiler::recExpressionStatement() {
+        if(isConcrete(recExpression(0).unqualifiedType())) {
+            codegen_.emitInstruction(Opcode::pop);
+        }
+    }
+    
     void Compiler::recCountLoop() {
+        Token statement = current();
         expect(Token::Kind::kw_loop);
-        Token loopCount = scanner_.currentToken();
-        expect(Token::Kind::lit_integer);
         
-        codegen_.openLoop();
-        codegen_.emitConstantI(Opcode::load_c, loopCount);
-        codegen_.emitLocal(Opcode::store, codegen_.loopVariable());
+        auto type = recExpression(0);
+        if(type.is(Type::Number)) {
+            Selector::convert(Type::Number, Type::Integer).emit(codegen_, codegen_.patchPoint());
+        }
+        else if(type.isValid() && !type.is(Type::Integer)) {
+            sema_.semanticError(statement, "loop counts must be integer expressions");
+        }
         
+        codegen_.openLoop();
+        codegen_.emitLocalJump(Opcode::loop_enter, codegen_.loopVariable(), codegen_.endLoopLabel());
         codegen_.emitLabel(codegen_.loopLabel());
-        codegen_.emitLocal(Opcode::load, codegen_.loopVariable());
-        codegen_.emitConstantI(Opcode::load_c, 0);
-        codegen_.emitInstruction(Opcode::test_ieq);
-        codegen_.emitJump(Opcode::jnz, codegen_.endLoopLabel());
         
         expect(Token::Kind::brace_l);
         sema_.pushScope();
@@ -61,12 +69,8 @@ namespace tinyscript {
         sema_.popScope();
         expect(Token::Kind::brace_r);
         
-        codegen_.emitLocal(Opcode::load, codegen_.loopVariable());
-        codegen_.emitConstantI(Opcode::load_c, 1);
-        codegen_.emitInstruction(Opcode::isub);
-        codegen_.emitLocal(Opcode::store, codegen_.loopVariable());
-        
-        codegen_.emitJump(Opcode::rjmp, codegen_.loopLabel());
+        codegen_.emitLabel(codegen_.nextLabel());
+        codegen_.emitLocalJump(Opcode::loop_next, codegen_.loopVariable(), codegen_.loopLabel());
         codegen_.closeLoop();
     }
     
@@ -75,11 +79,12 @@ namespace tinyscript {
         expect(Token::Kind::kw_until);
         codegen_.openLoop();
         codegen_.emitLabel(codegen_.loopLabel());
+        codegen_.emitLabel(codegen_.nextLabel());
         
         if(!recExpression(0).is(Type::Bool)) {
             sema_.semanticError(statement, "conditional statements work on boolean expressions");
         }
-        codegen_.emitJump(Opcode::jnz, codegen_.endLoopLabel());
+        codegen_.emitBranch(true, codegen_.endLoopLabel());
         
         expect(Token::Kind::brace_l);
         sema_.pushScope();
@@ -99,7 +104,7 @@ namespace tinyscript {
         }
         
         codegen_.openIf();
-        codegen_.emitJump(Opcode::jnz, codegen_.endifLabel());
+        codegen_.emitBranch(true, codegen_.endifLabel());
         
         expect(Token::Kind::kw_else);
         recFlowStatement();
@@ -116,9 +121,7 @@ namespace tinyscript {
         }
         
         codegen_.openIf();
-        codegen_.emitJump(Opcode::jnz, codegen_.ifLabel());
-        codegen_.emitJump(Opcode::jmp, codegen_.elseLabel());
-        codegen_.emitLabel(codegen_.ifLabel());
+        codegen_.emitBranch(false, codegen_.elseLabel());
         
         expect(Token::Kind::brace_l);
         sema_.pushScope();
@@ -154,8 +157,15 @@ namespace tinyscript {
         Token name = current();
         expect(Token::Kind::identifier);
         expect(Token::Kind::op_eq);
+        auto start = codegen_.patchPoint();
         auto type = recExpression(0);
         
+        if(type.isConstant() && !assigned_.count(manager_.tokenAsString(name))) {
+            codegen_.discardCode(start);
+            sema_.declareVariable(name, type.unqualifiedType(), type.constant());
+            return;
+        }
+        
         sema_.declareVariable(name, type.unqualifiedType());
         codegen_.declareLocal(name);
         codegen_.emitLocal(Opcode::store, name);
@@ -182,7 +192,10 @@ namespace tinyscript {
         
         
         sema_.declareFunction(name, paramTypes, returnType);
-        codegen_.openFunction(name, paramTypes.size());
+        std::vector<Type> types;
+        for(const auto& decl: paramTypes)
+            types.push_back(decl.second);
+        codegen_.openFunction(name, types, returnType);
         for(const auto& decl: paramTypes)
             codegen_.declareLocal(decl.first);
         
@@ -217,7 +230,7 @@ namespace tinyscript {
     void Compiler::recFlowStatement() {
         if(have(Token::Kind::kw_next)) {
             expect(Token::Kind::kw_next);
-            codegen_.emitJump(Opcode::rjmp, codegen_.loopLabel());
+            codegen_.emitNext();
         }
         else if(have(Token::Kind::kw_stoploop)) {
             expect(Token::Kind::kw_stoploop);
@@ -276,6 +289,11 @@ namespace tinyscript {
             int nextMin = right ? prec : prec + 1;
             scanner_.consumeToken();
             
+            if(op.operatorType() == Token::OperatorType::Logical) {
+                type = recLogical(op, type, patchAssignRem, nextMin);
+                continue;
+            }
+            
             auto lhs = type;
             auto rhs = recExpression(nextMin);
             auto mapping = sema_.binaryOpType(op, lhs, rhs);
@@ -284,12 +302,33 @@ namespace tinyscript {
                 if(!lhs.isLValue()) {
                     sema_.semanticError(op, "Cannot assign to a non-variable");
                 }
+                else if(rhs.isConstant() && mapping.from != Type::Invalid) {
+                    auto value = Selector::convert(rhs.unqualifiedType(), mapping.from).fold(rhs.constant());
+                    codegen_.discardCode(patchLHS);
+                    codegen_.dropCode(patchAssignRem);
+                    codegen_.emitConstant(value);
+                    codegen_.emitLocal(Opcode::store, type.lvalue());
+                }
                 else {
                     codegen_.dropCode(patchAssignRem);
                     Selector::convert(rhs.unqualifiedType(), mapping.from).emit(codegen_, codegen_.patchPoint());
                     codegen_.emitLocal(Opcode::store, type.lvalue());
                 }
+                // The value is stored, nothing is left on the stack.
+                type = Type::Void;
+                continue;
             } else {
+                Value folded;
+                if(lhs.isConstant() && rhs.isConstant() && mapping.from != Type::Invalid) {
+                    folded = Selector::foldBinary(op, mapping.from, lhs.constant(), rhs.constant());
+                }
+                if(folded.kind != Value::Kind::Nil) {
+                    codegen_.discardCode(patchAssignRem);
+                    codegen_.emitConstant(folded);
+                    type = TypeExpr(mapping.to, folded);
+                    continue;
+                }
+                
                 Selector::convert(lhs.unqualifiedType(), mapping.from).emit(codegen_, patchLHS);
                 Selector::convert(rhs.unqualifiedType(), mapping.from).emit(codegen_, codegen_.patchPoint());
                 codegen_.emitInstruction(Selector::binaryInstruction(op, mapping.from));
@@ -299,6 +338,30 @@ namespace tinyscript {
         return type;
     }
     
+    // The right operand of `and` and `or` is only evaluated when the left one doesn't decide the
+    // result. A constant left operand leaves either nothing or only the right operand.
+    TypeExpr Compiler::recLogical(const Token& op, TypeExpr lhs, std::uint64_t start, int min) {
+        bool isAnd = op.kind == Token::Kind::kw_and;
+        if(lhs.isConstant() && lhs.is(Type::Bool)) {
+            codegen_.discardCode(start);
+            auto rhs = recExpression(min);
+            auto mapping = sema_.binaryOpType(op, lhs, rhs);
+            if(mapping.to == Type::Invalid) return mapping.to;
+            if(lhs.constant().asBool() != isAnd) {
+                codegen_.discardCode(start);
+                codegen_.emitConstant(lhs.constant());
+                return TypeExpr(mapping.to, lhs.constant());
+            }
+            return rhs.isConstant() ? TypeExpr(mapping.to, rhs.constant()) : TypeExpr(mapping.to);
+        }
+        
+        codegen_.openLogical(isAnd);
+        auto rhs = recExpression(min);
+        auto mapping = sema_.binaryOpType(op, lhs, rhs);
+        codegen_.closeLogical(isAnd);
+        return mapping.to;
+    }
+    
     TypeExpr Compiler::recTerm() {
         bool hasUnary = false;
         Token unary;
@@ -310,6 +373,7 @@ namespace tinyscript {
         
         TypeExpr type = Type::Invalid;
         auto symbol = current();
+        auto start = codegen_.patchPoint();
         
         if(match(Token::Kind::paren_l)) {
             type = recExpression(0);
@@ -324,27 +388,30 @@ namespace tinyscript {
                 type = recFuncCall(symbol);
             } else {
                 type = sema_.getVarType(symbol);
-                codegen_.emitLocal(Opcode::load, symbol);
+                if(type.isConstant())
+                    codegen_.emitConstant(type.constant());
+                else
+                    codegen_.emitLocal(Opcode::load, symbol);
             }
         }
         else if(match(Token::Kind::kw_yes)) {
-            type = Type::Bool;
+            type = TypeExpr(Type::Bool, Value::boolean(true));
             codegen_.emitInstruction(Opcode::load_yes);
         }
         else if(match(Token::Kind::kw_no)) {
-            type = Type::Bool;
+            type = TypeExpr(Type::Bool, Value::boolean(false));
             codegen_.emitInstruction(Opcode::load_no);
         }
         else if(match(Token::Kind::lit_floating)) {
-            type = Type::Number;
+            type = TypeExpr(Type::Number, Value::Float(manager_.tokenAsFloat(symbol)));
             codegen_.emitConstantF(Opcode::load_c, symbol);
         }
         else if(match(Token::Kind::lit_integer)) {
-            type = Type::Integer;
+            type = TypeExpr(Type::Integer, Value::Integer(manager_.tokenAsInt(symbol)));
             codegen_.emitConstantI(Opcode::load_c, symbol);
         }
         else if(match(Token::Kind::lit_string)) {
-            type = Type::String;
+            type = TypeExpr(Type::String, Value(manager_.tokenAsString(symbol)));
             codegen_.emitConstantS(Opcode::load_c, symbol);
         }
         else {
@@ -352,50 +419,62 @@ namespace tinyscript {
             return TypeExpr(Type::Invalid);
         }
         
-        if(hasUnary) {
+        if(hasUnary && type.isConstant()) {
+            auto value = Selector::foldUnary(unary, type.unqualifiedType(), type.constant());
+            codegen_.discardCode(start);
+            codegen_.emitConstant(value);
+            type = TypeExpr(type.unqualifiedType(), value);
+        }
+        else if(hasUnary) {
             codegen_.emitInstruction(Selector::unaryInstruction(unary, type.unqualifiedType()));
         }
         
         return type;
     }
     
-    TypeExpr Compiler::recFuncCall(const Token& func) {
-        std::uint8_t arity = 0;
+    std::vector<Compiler::Argument> Compiler::recArguments() {
+        std::vector<Argument> args;
         expect(Token::Kind::paren_l);
         
         if(haveTerm()) {
-            arity = 1;
-            recExpression(0);
-            while(match(Token::Kind::comma)) {
-                arity += 1;
-                recExpression(0);
-            }
+            do {
+                auto token = current();
+                auto type = recExpression(0);
+                args.push_back(Argument{token, type, codegen_.patchPoint()});
+            } while(match(Token::Kind::comma));
         }
         
         expect(Token::Kind::paren_r);
+        return args;
+    }
+    
+    void Compiler::convertArguments(const std::vector<Argument>& args, const std::vector<Type>& params) {
+        if(params.size() != args.size()) return;
+        // Patch back to front so earlier patch points stay valid.
+        for(std::int64_t i = args.size()-1; i >= 0; --i) {
+            const auto& arg = args[i];
+            if(!sema_.checkArgument(arg.token, arg.type, params[i])) continue;
+            Selector::convert(arg.type.unqualifiedType(), params[i]).emit(codegen_, arg.end);
+        }
+    }
+    
+    TypeExpr Compiler::recFuncCall(const Token& func) {
+        auto args = recArguments();
+        std::uint8_t arity = args.size();
         auto type = sema_.getFuncType(func, arity);
-        codegen_.emitConstantS(Opcode::call_n, VM::mangleFunc(manager_.tokenAsString(func), arity));
+        convertArguments(args, sema_.getParamTypes(func, arity));
+        codegen_.emitCall(VM::mangleFunc(manager_.tokenAsString(func), arity), arity, type.unqualifiedType());
         return type;
     }
 
     TypeExpr Compiler::recFuncCall(const Token& module, const Token& func) {
-        
-        std::uint8_t arity = 0;
         expect(Token::Kind::identifier);
-        expect(Token::Kind::paren_l);
-        
-        if(haveTerm()) {
-            arity = 1;
-            recExpression(0);
-            while(match(Token::Kind::comma)) {
-                arity += 1;
-                recExpression(0);
-            }
-        }
-        
-        expect(Token::Kind::paren_r);
+        auto args = recArguments();
+        std::uint8_t arity = args.size();
         auto type = sema_.getFuncType(module, func, arity);
-        codegen_.emitConstantS(Opcode::call_f, VM::mangleFunc(manager_.tokenAsString(module), manager_.tokenAsString(func), arity));
+        convertArguments(args, sema_.getParamTypes(module, func, arity));
+        codegen_.emitForeignCall(VM::mangleFunc(manager_.tokenAsString(module), manager_.tokenAsString(func), arity),
+                                 arity, type.unqualifiedType());
         return type;
     }
 }
@@ -0,0 +1,734 @@
+//
+//  registers.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cassert>
+#include <iostream>
+#include <tinyscript/compiler/registers.hpp>
+
+namespace tinyscript {
+    
+    RegisterBuilder::RegisterBuilder(const ILFunction& function) : function_(function) {
+        registers_ = function.locals_.size();
+    }
+    
+    // Labelled instructions keep what came before the jump offset in the upper bits once resolved.
+    static std::uint64_t prefix(const ILInstruction& inst) {
+        return inst.label().empty() ? inst.operand() : inst.operand() >> 16;
+    }
+    
+    // ILInstruction::write() drops instructions that were never completed.
+    static bool isEmitted(const ILInstruction& inst) {
+        return inst.isResolved() && inst.isComplete() && inst.code() != Opcode::nop;
+    }
+    
+    static bool fallsThrough(Opcode code) {
+        switch(code) {
+            case Opcode::halt:
+            case Opcode::ret:
+            case Opcode::ret_v:
+            case Opcode::fail:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::tail_n:
+                return false;
+            default:
+                return true;
+        }
+    }
+    
+    // The stack depth before each reachable instruction.
+    bool RegisterBuilder::analyze() {
+        const auto& il = function_.il_;
+        depth_.assign(il.size() + 1, -1);
+        depth_[0] = 0;
+        
+        std::vector<std::uint64_t> work{0};
+        auto visit = [&](std::uint64_t at, std::int64_t depth) {
+            if(depth_[at] < 0) {
+                depth_[at] = depth;
+                work.push_back(at);
+                return true;
+            }
+            return depth_[at] == depth;
+        };
+        
+        while(!work.empty()) {
+            auto at = work.back();
+            work.pop_back();
+            if(at == il.size()) continue;
+            
+            const auto& inst = il[at];
+            auto depth = depth_[at];
+            if(!isEmitted(inst)) {
+                if(!visit(at + 1, depth)) return false;
+                continue;
+            }
+            
+            int pops = 0, pushes = 0;
+            inst.effect(pops, pushes);
+            if(depth < pops) return false;
+            depth += pushes - pops;
+            
+            if(!inst.label().empty() && !visit(function_.symbols_.at(inst.label()), depth)) return false;
+            if(fallsThrough(inst.code()) && !visit(at + 1, depth)) return false;
+        }
+        return true;
+    }
+    
+    std::uint8_t RegisterBuilder::temporary(std::uint64_t depth) {
+        auto index = function_.locals_.size() + depth;
+        if(index > 254) {
+            valid_ = false;
+            return 0;
+        }
+        if(index >= registers_) registers_ = index + 1;
+        return index;
+    }
+    
+    RegisterBuilder::Operand RegisterBuilder::pop() {
+        if(stack_.empty()) {
+            valid_ = false;
+            return Operand{Operand::Kind::Integer, 0};
+        }
+        auto operand = stack_.back();
+        stack_.pop_back();
+        return operand;
+    }
+    
+    void RegisterBuilder::load(std::uint8_t dst, const Operand& operand) {
+        switch(operand.kind) {
+            case Operand::Kind::Register:
+                if(operand.value == dst) return;
+                emit(RegOpcode::move);
+                emit8(dst);
+                emit8(operand.value);
+                break;
+            case Operand::Kind::Integer:
+                emit(RegOpcode::loadi);
+                emit8(dst);
+                emit16(operand.value);
+                break;
+            case Operand::Kind::Constant:
+                emit(RegOpcode::loadk);
+                emit8(dst);
+                emit8(operand.value);
+                break;
+            case Operand::Kind::Yes:
+                emit(RegOpcode::loadyes);
+                emit8(dst);
+                break;
+            case Operand::Kind::No:
+                emit(RegOpcode::loadno);
+                emit8(dst);
+                break;
+        }
+    }
+    
+    // The register holding [operand], loading it in the temporary of its stack depth if needed. A
+    // value can only be found in the temporary of its own depth or in one below it, so that
+    // temporary is free unless it already holds the value.
+    std::uint8_t RegisterBuilder::reg(const Operand& operand, std::uint64_t depth) {
+        if(operand.kind == Operand::Kind::Register) return operand.value;
+        auto dst = temporary(depth);
+        load(dst, operand);
+        return dst;
+    }
+    
+    std::uint8_t RegisterBuilder::popRegister() {
+        auto operand = pop();
+        return reg(operand, stack_.size());
+    }
+    
+    // Values still read from [slot] are copied out before it is written.
+    void RegisterBuilder::spill(std::uint8_t slot) {
+        for(std::uint64_t i = 0; i < stack_.size(); ++i) {
+            auto& operand = stack_[i];
+            if(operand.kind != Operand::Kind::Register || operand.value != slot) continue;
+            auto dst = temporary(i);
+            load(dst, operand);
+            operand.value = dst;
+        }
+    }
+    
+    // Moves every value to the temporary of its depth, where jump targets and callees expect them.
+    void RegisterBuilder::flush() {
+        for(std::uint64_t i = 0; i < stack_.size(); ++i) {
+            auto& operand = stack_[i];
+            auto dst = temporary(i);
+            load(dst, operand);
+            operand = Operand{Operand::Kind::Register, dst};
+        }
+    }
+    
+    // Where the instruction at [at] writes its result. `store x` or `dup; store x` right after it
+    // (with no label in between) is folded in, writing x directly.
+    std::uint8_t RegisterBuilder::result(std::uint64_t& at) {
+        const auto& il = function_.il_;
+        auto next = at + 1;
+        if(next < il.size() && !targets_[next] && il[next].code() == Opcode::store) {
+            std::uint8_t slot = il[next].operand() & 0x00ff;
+            spill(slot);
+            at = next;
+            return slot;
+        }
+        if(next + 1 < il.size() && !targets_[next] && !targets_[next + 1]
+           && il[next].code() == Opcode::dup && il[next + 1].code() == Opcode::store) {
+            std::uint8_t slot = il[next + 1].operand() & 0x00ff;
+            spill(slot);
+            stack_.push_back(Operand{Operand::Kind::Register, slot});
+            at = next + 1;
+            return slot;
+        }
+        auto dst = temporary(stack_.size());
+        stack_.push_back(Operand{Operand::Kind::Register, dst});
+        return dst;
+    }
+    
+    void RegisterBuilder::emit16(std::uint16_t operand) {
+        code_.push_back((operand >> 8) & 0x00ff);
+        code_.push_back(operand & 0x00ff);
+    }
+    
+    void RegisterBuilder::emitJump(const ILInstruction& inst) {
+        fixups_.push_back(Fixup{code_.size(), function_.symbols_.at(inst.label())});
+        emit16(0);
+    }
+    
+    static RegOpcode unaryOp(Opcode code) {
+        switch(code) {
+            case Opcode::fmin:      return RegOpcode::fneg;
+            case Opcode::imin:      return RegOpcode::ineg;
+            case Opcode::i2f:       return RegOpcode::i2f;
+            case Opcode::f2i:       return RegOpcode::f2i;
+            case Opcode::iadd_i:    return RegOpcode::iaddi;
+            default:                return RegOpcode::isubi;
+        }
+    }
+    
+    static RegOpcode binaryOp(Opcode code) {
+        switch(code) {
+            case Opcode::fadd:          return RegOpcode::fadd;
+            case Opcode::fsub:          return RegOpcode::fsub;
+            case Opcode::fmul:          return RegOpcode::fmul;
+            case Opcode::fdiv:          return RegOpcode::fdiv;
+            case Opcode::iadd:          return RegOpcode::iadd;
+            case Opcode::isub:          return RegOpcode::isub;
+            case Opcode::imul:          return RegOpcode::imul;
+            case Opcode::idiv:          return RegOpcode::idiv;
+            case Opcode::sadd:          return RegOpcode::sadd;
+            case Opcode::log_and:       return RegOpcode::land;
+            case Opcode::log_or:        return RegOpcode::lor;
+            case Opcode::test_flt:      return RegOpcode::flt;
+            case Opcode::test_flteq:    return RegOpcode::flteq;
+            case Opcode::test_fgt:      return RegOpcode::fgt;
+            case Opcode::test_fgteq:    return RegOpcode::fgteq;
+            case Opcode::test_feq:      return RegOpcode::feq;
+            case Opcode::test_ilt:
+            case Opcode::test_ilt_li:   return RegOpcode::ilt;
+            case Opcode::test_ilteq:
+            case Opcode::test_ilteq_li: return RegOpcode::ilteq;
+            case Opcode::test_igt:
+            case Opcode::test_igt_li:   return RegOpcode::igt;
+            case Opcode::test_igteq:
+            case Opcode::test_igteq_li: return RegOpcode::igteq;
+            case Opcode::test_ieq:
+            case Opcode::test_ieq_li:   return RegOpcode::ieq;
+            default:                    return RegOpcode::seq;
+        }
+    }
+    
+    static RegOpcode branchOp(Opcode code) {
+        switch(code) {
+            case Opcode::jilt:          return RegOpcode::jilt;
+            case Opcode::jilteq:        return RegOpcode::jilteq;
+            case Opcode::jigt:          return RegOpcode::jigt;
+            case Opcode::jigteq:        return RegOpcode::jigteq;
+            case Opcode::jieq:          return RegOpcode::jieq;
+            case Opcode::jine:          return RegOpcode::jine;
+            case Opcode::jflt:          return RegOpcode::jflt;
+            case Opcode::jflteq:        return RegOpcode::jflteq;
+            case Opcode::jfgt:          return RegOpcode::jfgt;
+            case Opcode::jfgteq:        return RegOpcode::jfgteq;
+            case Opcode::jfeq:          return RegOpcode::jfeq;
+            case Opcode::jfne:          return RegOpcode::jfne;
+            case Opcode::jseq:          return RegOpcode::jseq;
+            case Opcode::jsne:          return RegOpcode::jsne;
+            case Opcode::jilt_li:       return RegOpcode::jilti;
+            case Opcode::jilteq_li:     return RegOpcode::jilteqi;
+            case Opcode::jigt_li:       return RegOpcode::jigti;
+            case Opcode::jigteq_li:     return RegOpcode::jigteqi;
+            case Opcode::jieq_li:       return RegOpcode::jieqi;
+            default:                    return RegOpcode::jinei;
+        }
+    }
+    
+    // Integer compare-and-branch instructions against an immediate, if [code] has one.
+    static bool immediateBranch(Opcode code, RegOpcode& op) {
+        switch(code) {
+            case Opcode::jilt:      op = RegOpcode::jilti; return true;
+            case Opcode::jilteq:    op = RegOpcode::jilteqi; return true;
+            case Opcode::jigt:      op = RegOpcode::jigti; return true;
+            case Opcode::jigteq:    op = RegOpcode::jigteqi; return true;
+            case Opcode::jieq:      op = RegOpcode::jieqi; return true;
+            case Opcode::jine:      op = RegOpcode::jinei; return true;
+            default:                return false;
+        }
+    }
+    
+    void RegisterBuilder::lower(std::uint64_t& at) {
+        const auto& inst = function_.il_[at];
+        auto operand = prefix(inst);
+        
+        switch(inst.code()) {
+            case Opcode::load_c:
+                stack_.push_back(Operand{Operand::Kind::Constant, static_cast<std::int64_t>(operand & 0x00ff)});
+                break;
+            
+            case Opcode::load_i:
+                stack_.push_back(Operand{Operand::Kind::Integer, static_cast<std::int16_t>(operand)});
+                break;
+            
+            case Opcode::load_yes:
+                stack_.push_back(Operand{Operand::Kind::Yes, 1});
+                break;
+            
+            case Opcode::load_no:
+                stack_.push_back(Operand{Operand::Kind::No, 0});
+                break;
+            
+            case Opcode::load:
+                stack_.push_back(Operand{Operand::Kind::Register, static_cast<std::int64_t>(operand & 0x00ff)});
+                break;
+            
+            case Opcode::dup:
+            {
+                auto top = pop();
+                stack_.push_back(top);
+                stack_.push_back(top);
+            }
+                break;
+            
+            case Opcode::pop:
+                pop();
+                break;
+            
+            case Opcode::store:
+            case Opcode::store_s:
+            {
+                auto value = pop();
+                std::uint8_t slot = operand & 0x00ff;
+                spill(slot);
+                load(slot, value);
+            }
+                break;
+            
+            case Opcode::fmin:
+            case Opcode::imin:
+            case Opcode::i2f:
+            case Opcode::f2i:
+            case Opcode::iadd_i:
+            case Opcode::isub_i:
+            {
+                auto a = popRegister();
+                auto dst = result(at);
+                emit(unaryOp(inst.code()));
+                emit8(dst);
+                emit8(a);
+                if(inst.code() == Opcode::iadd_i || inst.code() == Opcode::isub_i) emit16(operand);
+            }
+                break;
+            
+            case Opcode::inc_l:
+            {
+                std::uint8_t slot = (operand >> 8) & 0x00ff;
+                spill(slot);
+                emit(RegOpcode::iaddi);
+                emit8(slot);
+                emit8(slot);
+                emit16(static_cast<std::int8_t>(operand & 0x00ff));
+            }
+                break;
+            
+            case Opcode::iadd:
+            case Opcode::isub:
+            {
+                auto b = pop();
+                auto a = pop();
+                auto depth = stack_.size();
+                if(b.kind == Operand::Kind::Integer) {
+                    auto ra = reg(a, depth);
+                    auto dst = result(at);
+                    emit(inst.code() == Opcode::iadd ? RegOpcode::iaddi : RegOpcode::isubi);
+                    emit8(dst);
+                    emit8(ra);
+                    emit16(b.value);
+                    break;
+                }
+                if(inst.code() == Opcode::iadd && a.kind == Operand::Kind::Integer) {
+                    auto rb = reg(b, depth + 1);
+                    auto dst = result(at);
+                    emit(RegOpcode::iaddi);
+                    emit8(dst);
+                    emit8(rb);
+                    emit16(a.value);
+                    break;
+                }
+                auto ra = reg(a, depth);
+                auto rb = reg(b, depth + 1);
+                auto dst = result(at);
+                emit(binaryOp(inst.code()));
+                emit8(dst);
+                emit8(ra);
+                emit8(rb);
+            }
+                break;
+            
+            case Opcode::fadd:
+            case Opcode::fsub:
+            case Opcode::fmul:
+            case Opcode::fdiv:
+            case Opcode::imul:
+            case Opcode::idiv:
+            case Opcode::sadd:
+            case Opcode::log_and:
+            case Opcode::log_or:
+            case Opcode::test_flt:
+            case Opcode::test_flteq:
+            case Opcode::test_fgt:
+            case Opcode::test_fgteq:
+            case Opcode::test_feq:
+            case Opcode::test_ilt:
+            case Opcode::test_ilteq:
+            case Opcode::test_igt:
+            case Opcode::test_igteq:
+            case Opcode::test_ieq:
+            case Opcode::test_seq:
+            {
+                auto b = pop();
+                auto a = pop();
+                auto depth = stack_.size();
+                auto ra = reg(a, depth);
+                auto rb = reg(b, depth + 1);
+                auto dst = result(at);
+                emit(binaryOp(inst.code()));
+                emit8(dst);
+                emit8(ra);
+                emit8(rb);
+            }
+                break;
+            
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+            {
+                auto rb = reg(Operand{Operand::Kind::Integer, static_cast<std::int16_t>(operand)}, stack_.size());
+                auto dst = result(at);
+                emit(binaryOp(inst.code()));
+                emit8(dst);
+                emit8((operand >> 16) & 0x00ff);
+                emit8(rb);
+            }
+                break;
+            
+            case Opcode::jmp:
+            case Opcode::rjmp:
+                flush();
+                emit(RegOpcode::jmp);
+                emitJump(inst);
+                break;
+            
+            case Opcode::jnz:
+            case Opcode::rjnz:
+            case Opcode::jz:
+            case Opcode::rjz:
+            {
+                bool onTrue = inst.code() == Opcode::jnz || inst.code() == Opcode::rjnz;
+                auto a = pop();
+                
+                // Branches on yes or no are decided here.
+                if(a.kind == Operand::Kind::Yes || a.kind == Operand::Kind::No) {
+                    flush();
+                    if((a.kind == Operand::Kind::Yes) != onTrue) break;
+                    emit(RegOpcode::jmp);
+                    emitJump(inst);
+                    break;
+                }
+                auto ra = reg(a, stack_.size());
+                flush();
+                emit(onTrue ? RegOpcode::jt : RegOpcode::jf);
+                emit8(ra);
+                emitJump(inst);
+            }
+                break;
+            
+            case Opcode::jilt:
+            case Opcode::jilteq:
+            case Opcode::jigt:
+            case Opcode::jigteq:
+            case Opcode::jieq:
+            case Opcode::jine:
+            case Opcode::jflt:
+            case Opcode::jflteq:
+            case Opcode::jfgt:
+            case Opcode::jfgteq:
+            case Opcode::jfeq:
+            case Opcode::jfne:
+            case Opcode::jseq:
+            case Opcode::jsne:
+            {
+                auto b = pop();
+                auto a = pop();
+                auto depth = stack_.size();
+                RegOpcode op;
+                if(b.kind == Operand::Kind::Integer && immediateBranch(inst.code(), op)) {
+                    auto ra = reg(a, depth);
+                    flush();
+                    emit(op);
+                    emit8(ra);
+                    emit16(b.value);
+                    emitJump(inst);
+                    break;
+                }
+                auto ra = reg(a, depth);
+                auto rb = reg(b, depth + 1);
+                flush();
+                emit(branchOp(inst.code()));
+                emit8(ra);
+                emit8(rb);
+                emitJump(inst);
+            }
+                break;
+            
+            case Opcode::jilt_li:
+            case Opcode::jilteq_li:
+            case Opcode::jigt_li:
+            case Opcode::jigteq_li:
+            case Opcode::jieq_li:
+            case Opcode::jine_li:
+                flush();
+                emit(branchOp(inst.code()));
+                emit8((operand >> 16) & 0x00ff);
+                emit16(operand);
+                emitJump(inst);
+                break;
+            
+            case Opcode::loop_enter:
+            {
+                auto count = popRegister();
+                flush();
+                emit(RegOpcode::loopenter);
+                emit8(operand & 0x00ff);
+                emit8(count);
+                emitJump(inst);
+            }
+                break;
+            
+            case Opcode::loop_next:
+                flush();
+                emit(RegOpcode::loopnext);
+                emit8(operand & 0x00ff);
+                emitJump(inst);
+                break;
+            
+            case Opcode::retain:
+            case Opcode::release:
+            {
+                auto top = pop();
+                auto r = reg(top, stack_.size());
+                stack_.push_back(Operand{Operand::Kind::Register, r});
+                emit(inst.code() == Opcode::retain ? RegOpcode::retain : RegOpcode::release);
+                emit8(r);
+            }
+                break;
+            
+            case Opcode::call_n:
+            case Opcode::tail_n:
+            case Opcode::call_f:
+            {
+                if(stack_.size() < inst.callArity()) {
+                    valid_ = false;
+                    break;
+                }
+                auto first = stack_.size() - inst.callArity();
+                for(auto i = first; i < stack_.size(); ++i) {
+                    load(temporary(i), stack_[i]);
+                }
+                stack_.resize(first);
+                auto dst = temporary(first);
+                if(inst.code() == Opcode::call_n || inst.code() == Opcode::tail_n) {
+                    emit(inst.code() == Opcode::call_n ? RegOpcode::call : RegOpcode::tailcall);
+                    emit8(dst);
+                    emit16(operand);
+                } else {
+                    emit(RegOpcode::callf);
+                    emit8(dst);
+                    emit8(operand);
+                }
+                if(inst.code() != Opcode::tail_n && inst.callResult()) stack_.push_back(Operand{Operand::Kind::Register, dst});
+            }
+                break;
+            
+            case Opcode::yield:
+                emit(RegOpcode::yield);
+                break;
+            
+            case Opcode::yield_v:
+            case Opcode::yield_t:
+            {
+                auto value = popRegister();
+                emit(RegOpcode::yieldv);
+                emit8(value);
+            }
+                break;
+            
+            case Opcode::ret:
+                emit(RegOpcode::ret);
+                break;
+            
+            case Opcode::ret_v:
+            {
+                auto value = popRegister();
+                emit(RegOpcode::retv);
+                emit8(value);
+            }
+                break;
+            
+            case Opcode::fail:
+                emit(RegOpcode::fail);
+                emit8(operand);
+                break;
+            
+            case Opcode::halt:
+                emit(RegOpcode::halt);
+                break;
+            
+            case Opcode::nop:
+                break;
+        }
+    }
+    
+    bool RegisterBuilder::build(Program::Function& function) {
+        const auto& il = function_.il_;
+        targets_ = function_.jumpTargets();
+        if(!analyze()) return false;
+        
+        addresses_.assign(il.size() + 1, 0);
+        bool live = false;
+        for(std::uint64_t at = 0; at < il.size(); ++at) {
+            addresses_[at] = code_.size();
+            const auto& inst = il[at];
+            if(depth_[at] < 0) continue;
+            
+            // Every path into a label leaves the stack in the temporaries. The moves falling
+            // through into it come before the label, where jumps land.
+            if(targets_[at] || !live) {
+                if(live) flush();
+                stack_.clear();
+                for(std::int64_t i = 0; i < depth_[at]; ++i) {
+                    stack_.push_back(Operand{Operand::Kind::Register, temporary(i)});
+                }
+                addresses_[at] = code_.size();
+            }
+            if(!isEmitted(inst)) continue;
+            auto start = at;
+            lower(at);
+            live = fallsThrough(inst.code());
+            for(auto i = start + 1; i <= at; ++i) {
+                addresses_[i] = code_.size();
+            }
+            if(!valid_) return false;
+        }
+        addresses_[il.size()] = code_.size();
+        
+        for(const auto& fixup: fixups_) {
+            std::int64_t offset = addresses_[fixup.target] - (fixup.at + 2);
+            if(offset < INT16_MIN || offset > INT16_MAX) return false;
+            code_[fixup.at] = (offset >> 8) & 0x00ff;
+            code_[fixup.at + 1] = offset & 0x00ff;
+        }
+        
+        function.bytecode = code_;
+        function.variableCount = registers_;
+        function.arity = function_.arity_;
+        function.paramTypes = function_.paramTypes_;
+        function.returnType = function_.returnType_;
+        return true;
+    }
+    
+    void RegisterBuilder::dump(const Program::Function& function, std::ostream& out) {
+        const auto& code = function.bytecode;
+        auto read16 = [&](std::uint64_t at) { return static_cast<std::int16_t>((code[at] << 8) | code[at + 1]); };
+        
+        for(std::uint64_t at = 0; at < code.size();) {
+            auto op = static_cast<RegOpcode>(code[at]);
+            auto size = operandSize(op);
+            const auto* operands = &code[at + 1];
+            out << "\t" << op;
+            switch(op) {
+                case RegOpcode::loadk:
+                    out << " \tr" << int(operands[0]) << ", k" << int(operands[1]);
+                    break;
+                case RegOpcode::loadi:
+                    out << " \tr" << int(operands[0]) << ", $" << read16(at + 2);
+                    break;
+                case RegOpcode::iaddi:
+                case RegOpcode::isubi:
+                    out << " \tr" << int(operands[0]) << ", r" << int(operands[1]) << ", $" << read16(at + 3);
+                    break;
+                case RegOpcode::jilti:
+                case RegOpcode::jilteqi:
+                case RegOpcode::jigti:
+                case RegOpcode::jigteqi:
+                case RegOpcode::jieqi:
+                case RegOpcode::jinei:
+                    out << " \tr" << int(operands[0]) << ", $" << read16(at + 2) << ", ->" << read16(at + 4);
+                    break;
+                case RegOpcode::call:
+                case RegOpcode::tailcall:
+                    out << " \tr" << int(operands[0]) << ", @" << read16(at + 2);
+                    break;
+                case RegOpcode::callf:
+                    out << " \tr" << int(operands[0]) << ", @f" << int(operands[1]);
+                    break;
+                case RegOpcode::fail:
+                    out << " \tk" << int(operands[0]);
+                    break;
+                case RegOpcode::jmp:
+                case RegOpcode::jt:
+                case RegOpcode::jf:
+                case RegOpcode::jilt:
+                case RegOpcode::jilteq:
+                case RegOpcode::jigt:
+                case RegOpcode::jigteq:
+                case RegOpcode::jieq:
+                case RegOpcode::jine:
+                case RegOpcode::jflt:
+                case RegOpcode::jflteq:
+                case RegOpcode::jfgt:
+                case RegOpcode::jfgteq:
+                case RegOpcode::jfeq:
+                case RegOpcode::jfne:
+                case RegOpcode::jseq:
+                case RegOpcode::jsne:
+                case RegOpcode::loopenter:
+                case RegOpcode::loopnext:
+                    out << " \t";
+                    for(int i = 0; i < size - 2; ++i) out << "r" << int(operands[i]) << ", ";
+                    out << "->" << read16(at + size - 1);
+                    break;
+                default:
+                    for(int i = 0; i < size; ++i) out << (i ? ", r" : " \tr") << int(operands[i]);
+                    break;
+            }
+            out << std::endl;
+            at += 1 + size;
+        }
+        out << std::endl;
+    }
+}
@@ -39,6 +39,15 @@ namespace tinyscript {
             }
         }
         
+        Value Conversion::fold(const Value& value) const {
+            switch (kind_) {
+                case Kind::IntFloat: return Value::Float(static_cast<double>(value.asInt()));
+                case Kind::FloatInt: return Value::Integer(static_cast<std::int64_t>(value.asNumber()));
+                case Kind::Call: return Value(value.repr());
+                default: return value;
+            }
+        }
+        
         static const std::unordered_map<Token::Kind,std::unordered_map<Type, Opcode>> unaryOperatorData = {
             {Token::Kind::op_minus, {{Type::Integer, Opcode::imin}, {Type::Number, Opcode::fmin}}},
         };
@@ -76,6 +85,51 @@ namespace tinyscript {
             return it2->second;
         }
         
+        // Immediate forms of integer instructions, used when the right-hand operand is a literal
+        // that fits in 16 bits. Comparisons also take their left-hand operand from a local.
+        static const std::unordered_map<Opcode, Opcode> immediateData = {
+            {Opcode::iadd,          Opcode::iadd_i},
+            {Opcode::isub,          Opcode::isub_i},
+            {Opcode::test_ilt,      Opcode::test_ilt_li},
+            {Opcode::test_ilteq,    Opcode::test_ilteq_li},
+            {Opcode::test_igt,      Opcode::test_igt_li},
+            {Opcode::test_igteq,    Opcode::test_igteq_li},
+            {Opcode::test_ieq,      Opcode::test_ieq_li},
+        };
+        
+        Opcode immediateInstruction(Opcode code) {
+            auto it = immediateData.find(code);
+            return it != immediateData.end() ? it->second : Opcode::nop;
+        }
+        
+        // Compare-and-branch forms of the test instructions, for branching when the test is true and
+        // when it is false. Float comparisons other than equality aren't negated, since NaN would
+        // make the negated comparison false as well.
+        static const std::unordered_map<Opcode, std::pair<Opcode, Opcode>> branchData = {
+            {Opcode::test_ilt,      {Opcode::jilt,      Opcode::jigteq}},
+            {Opcode::test_ilteq,    {Opcode::jilteq,    Opcode::jigt}},
+            {Opcode::test_igt,      {Opcode::jigt,      Opcode::jilteq}},
+            {Opcode::test_igteq,    {Opcode::jigteq,    Opcode::jilt}},
+            {Opcode::test_ieq,      {Opcode::jieq,      Opcode::jine}},
+            {Opcode::test_flt,      {Opcode::jflt,      Opcode::nop}},
+            {Opcode::test_flteq,    {Opcode::jflteq,    Opcode::nop}},
+            {Opcode::test_fgt,      {Opcode::jfgt,      Opcode::nop}},
+            {Opcode::test_fgteq,    {Opcode::jfgteq,    Opcode::nop}},
+            {Opcode::test_feq,      {Opcode::jfeq,      Opcode::jfne}},
+            {Opcode::test_seq,      {Opcode::jseq,      Opcode::jsne}},
+            {Opcode::test_ilt_li,   {Opcode::jilt_li,   Opcode::jigteq_li}},
+            {Opcode::test_ilteq_li, {Opcode::jilteq_li, Opcode::jigt_li}},
+            {Opcode::test_igt_li,   {Opcode::jigt_li,   Opcode::jilteq_li}},
+            {Opcode::test_igteq_li, {Opcode::jigteq_li, Opcode::jilt_li}},
+            {Opcode::test_ieq_li,   {Opcode::jieq_li,   Opcode::jine_li}},
+        };
+        
+        Opcode branchInstruction(Opcode test, bool condition) {
+            auto it = branchData.find(test);
+            if(it == branchData.end()) return Opcode::nop;
+            return condition ? it->second.first : it->second.second;
+        }
+        
         Conversion convert(Type source, Type target) {
             if(source == target) return Conversion::None();
             if(source == Type::Integer && target == Type::Number) return Conversion::I2F();
@@ -83,5 +137,60 @@ namespace tinyscript {
             if(source != Type::String && target == Type::String) return Conversion::String();
             return Conversion::None();
         }
+        
+        static Type typeOf(const Value& value) {
+            switch(value.kind) {
+                case Value::Kind::Bool:     return Type::Bool;
+                case Value::Kind::Int:      return Type::Integer;
+                case Value::Kind::Number:   return Type::Number;
+                case Value::Kind::String:   return Type::String;
+                default:                    return Type::Invalid;
+            }
+        }
+        
+        Value foldUnary(const Token& op, Type operand, const Value& value) {
+            switch(unaryInstruction(op, operand)) {
+                case Opcode::imin: return Value::Integer(-value.asInt());
+                case Opcode::fmin: return Value::Float(-value.asNumber());
+                default: return Value();
+            }
+        }
+        
+        Value foldBinary(const Token& op, Type operand, const Value& lhs, const Value& rhs) {
+            auto a = convert(typeOf(lhs), operand).fold(lhs);
+            auto b = convert(typeOf(rhs), operand).fold(rhs);
+            
+            switch(binaryInstruction(op, operand)) {
+                case Opcode::iadd: return Value::Integer(a.asInt() + b.asInt());
+                case Opcode::isub: return Value::Integer(a.asInt() - b.asInt());
+                case Opcode::imul: return Value::Integer(a.asInt() * b.asInt());
+                case Opcode::idiv: return b.asInt() ? Value::Integer(a.asInt() / b.asInt()) : Value();
+                    
+                case Opcode::fadd: return Value::Float(a.asNumber() + b.asNumber());
+                case Opcode::fsub: return Value::Float(a.asNumber() - b.asNumber());
+                case Opcode::fmul: return Value::Float(a.asNumber() * b.asNumber());
+                case Opcode::fdiv: return Value::Float(a.asNumber() / b.asNumber());
+                    
+                case Opcode::sadd: return Value(a.asString() + b.asString());
+                    
+                case Opcode::log_and: return Value::boolean(a.asBool() && b.asBool());
+                case Opcode::log_or: return Value::boolean(a.asBool() || b.asBool());
+                    
+                case Opcode::test_ilt: return Value::boolean(a.asInt() < b.asInt());
+                case Opcode::test_ilteq: return Value::boolean(a.asInt() <= b.asInt());
+                case Opcode::test_igt: return Value::boolean(a.asInt() > b.asInt());
+                case Opcode::test_igteq: return Value::boolean(a.asInt() >= b.asInt());
+                case Opcode::test_ieq: return Value::boolean(a.asInt() == b.asInt());
+                    
+                case Opcode::test_flt: return Value::boolean(a.asNumber() < b.asNumber());
+                case Opcode::test_flteq: return Value::boolean(a.asNumber() <= b.asNumber());
+                case Opcode::test_fgt: return Value::boolean(a.asNumber() > b.asNumber());
+                case Opcode::test_fgteq: return Value::boolean(a.asNumber() >= b.asNumber());
+                case Opcode::test_feq: return Value::boolean(a.asNumber() == b.asNumber());
+                    
+                case Opcode::test_seq: return Value::boolean(a.asString() == b.asString());
+                default: return Value();
+            }
+        }
     }
 }
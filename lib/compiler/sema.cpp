@@ -61,7 +61,7 @@ namespace tinyscript {
         return true;
     }
     
-    bool Sema::declareVariable(const Token& symbol, Type type) {
+    bool Sema::declareVariable(const Token& symbol, Type type, const Value& constant) {
         auto key = manager_.tokenAsString(symbol);
         auto& scope = scopes_.back();
         auto it = scope.variables.find(key);
@@ -74,6 +74,7 @@ namespace tinyscript {
         
         scope.variables[key].declLocation = symbol;
         scope.variables[key].type = type;
+        scope.variables[key].constant = constant;
         return true;
     }
     
@@ -83,7 +84,10 @@ namespace tinyscript {
         for(std::int64_t i = scopes_.size()-1; i >= 0; --i) {
             auto& scope = scopes_[i];
             auto it = scope.variables.find(key);
-            if(it != scope.variables.end()) return TypeExpr(it->second.type, symbol);
+            if(it == scope.variables.end()) continue;
+            TypeExpr type(it->second.type, symbol);
+            type.setConstant(it->second.constant);
+            return type;
         }
         
         semanticError(symbol, "unkown variable '" + key + "'");
@@ -112,6 +116,35 @@ namespace tinyscript {
         return type;
     }
     
+    std::vector<Type> Sema::getParamTypes(const Token& symbol, std::uint8_t arity) {
+        auto key = VM::mangleFunc(manager_.tokenAsString(symbol), arity);
+        
+        for(std::int64_t i = scopes_.size()-1; i >= 0; --i) {
+            auto& scope = scopes_[i];
+            auto it = scope.functions.find(key);
+            if(it != scope.functions.end()) return it->second.paramTypes;
+        }
+        return {};
+    }
+    
+    std::vector<Type> Sema::getParamTypes(const Token& module, const Token& symbol, std::uint8_t arity) {
+        auto func = vm_.function(manager_.tokenAsString(module), manager_.tokenAsString(symbol), arity);
+        if(!func) return {};
+        return func->paramTypes;
+    }
+    
+    bool Sema::checkArgument(const Token& arg, TypeExpr type, Type param) {
+        if(!type.isValid() || param == Type::Invalid) return true;
+        if(type.is(Type::Void)) {
+            semanticError(arg, "cannot pass a void expression as an argument");
+            return false;
+        }
+        if(type.is(param) || param == Type::String) return true;
+        if(constrain(type, param, true) == Type::Number) return true;
+        semanticError(arg, "argument type mismatch");
+        return false;
+    }
+    
     Sema::OperatorMapping Sema::binaryOpType(const Token& op, TypeExpr lhs, TypeExpr rhs) {
         assert(op.isBinaryOp() && "token is not an operator");
         if(!lhs.isValid() && !rhs.isValid()) return {Type::Invalid, Type::Invalid};
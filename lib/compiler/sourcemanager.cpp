@@ -10,17 +10,20 @@
 
 namespace tinyscript {
     
+    // The scanner stops at the NUL after the last character.
     SourceManager::SourceManager(std::istream& input) {
         std::string source(std::istreambuf_iterator<char>(input), {});
         length_ = static_cast<std::uint32_t>(source.length());
-        source_ = new char[length_];
+        source_ = new char[length_ + 1];
         std::copy(source.begin(), source.end(), source_);
+        source_[length_] = '\0';
     }
     
     SourceManager::SourceManager(const std::string& source) {
         length_ = static_cast<std::uint32_t>(source.length());
-        source_ = new char[length_];
+        source_ = new char[length_ + 1];
         std::copy(source.begin(), source.end(), source_);
+        source_[length_] = '\0';
     }
     
     SourceManager::~SourceManager() {
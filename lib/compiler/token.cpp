@@ -114,7 +114,7 @@ namespace tinyscript {
     
     static const std::map<Token::Kind, OperatorData> operators = {
         {Token::Kind::op_star,      {90, false, Token::OperatorType::Arithmetic,    Opcode::fmul}},
-        {Token::Kind::op_slash,     {00, false, Token::OperatorType::Arithmetic,    Opcode::fdiv}},
+        {Token::Kind::op_slash,     {90, false, Token::OperatorType::Arithmetic,    Opcode::fdiv}},
         {Token::Kind::op_amp,       {80, false, Token::OperatorType::String,        Opcode::sadd}},
         {Token::Kind::op_plus,      {80, false, Token::OperatorType::Arithmetic,    Opcode::fadd}},
         {Token::Kind::op_minus,     {80, false, Token::OperatorType::Arithmetic,    Opcode::fsub}},
@@ -0,0 +1,455 @@
+//
+//  typed.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <tinyscript/compiler/typed.hpp>
+
+namespace tinyscript {
+    
+    TypedBuilder::TypedBuilder(const ILFunction& function,
+                               const std::vector<Value>& constants,
+                               const std::vector<std::string>& imports)
+    : function_(function), constants_(constants), imports_(imports) {
+        locals_.assign(function.locals_.size(), Type::Invalid);
+        for(std::uint64_t i = 0; i < function.paramTypes_.size() && i < locals_.size(); ++i) {
+            locals_[i] = function.paramTypes_[i];
+        }
+    }
+    
+    // Labelled instructions keep what came before the jump offset in the upper bits once resolved.
+    static std::uint64_t prefix(const ILInstruction& inst) {
+        return inst.label().empty() ? inst.operand() : inst.operand() >> 16;
+    }
+    
+    // ILInstruction::write() drops instructions that were never completed.
+    static bool isEmitted(const ILInstruction& inst) {
+        return inst.isResolved() && inst.isComplete() && inst.code() != Opcode::nop;
+    }
+    
+    static bool fallsThrough(Opcode code) {
+        switch(code) {
+            case Opcode::halt:
+            case Opcode::ret:
+            case Opcode::ret_v:
+            case Opcode::fail:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::tail_n:
+                return false;
+            default:
+                return true;
+        }
+    }
+    
+    static Type constantType(const Value& value) {
+        switch(value.kind) {
+            case Value::Kind::Bool:     return Type::Bool;
+            case Value::Kind::Int:      return Type::Integer;
+            case Value::Kind::Number:   return Type::Number;
+            case Value::Kind::String:   return Type::String;
+            default:                    return Type::Invalid;
+        }
+    }
+    
+    // Operands popped and the type pushed, for instructions that don't depend on locals.
+    static bool effect(Opcode code, std::uint64_t& pops, Type& result) {
+        switch(code) {
+            case Opcode::load_i:        pops = 0; result = Type::Integer; return true;
+            case Opcode::load_yes:
+            case Opcode::load_no:       pops = 0; result = Type::Bool; return true;
+            
+            case Opcode::fmin:
+            case Opcode::i2f:           pops = 1; result = Type::Number; return true;
+            case Opcode::imin:
+            case Opcode::iadd_i:
+            case Opcode::isub_i:
+            case Opcode::f2i:           pops = 1; result = Type::Integer; return true;
+            
+            case Opcode::fadd:
+            case Opcode::fsub:
+            case Opcode::fmul:
+            case Opcode::fdiv:          pops = 2; result = Type::Number; return true;
+            case Opcode::iadd:
+            case Opcode::isub:
+            case Opcode::imul:
+            case Opcode::idiv:          pops = 2; result = Type::Integer; return true;
+            case Opcode::sadd:          pops = 2; result = Type::String; return true;
+            
+            case Opcode::log_and:
+            case Opcode::log_or:
+            case Opcode::test_flt:
+            case Opcode::test_flteq:
+            case Opcode::test_fgt:
+            case Opcode::test_fgteq:
+            case Opcode::test_feq:
+            case Opcode::test_ilt:
+            case Opcode::test_ilteq:
+            case Opcode::test_igt:
+            case Opcode::test_igteq:
+            case Opcode::test_ieq:
+            case Opcode::test_seq:      pops = 2; result = Type::Bool; return true;
+            
+            case Opcode::jnz:
+            case Opcode::rjnz:
+            case Opcode::jz:
+            case Opcode::rjz:
+            case Opcode::pop:
+            case Opcode::yield_v:
+            case Opcode::ret_v:         pops = 1; result = Type::Void; return true;
+            
+            case Opcode::jilt:
+            case Opcode::jilteq:
+            case Opcode::jigt:
+            case Opcode::jigteq:
+            case Opcode::jieq:
+            case Opcode::jine:
+            case Opcode::jflt:
+            case Opcode::jflteq:
+            case Opcode::jfgt:
+            case Opcode::jfgteq:
+            case Opcode::jfeq:
+            case Opcode::jfne:
+            case Opcode::jseq:
+            case Opcode::jsne:          pops = 2; result = Type::Void; return true;
+            
+            case Opcode::halt:
+            case Opcode::jmp:
+            case Opcode::rjmp:
+            case Opcode::yield:
+            case Opcode::ret:
+            case Opcode::fail:
+            case Opcode::nop:           pops = 0; result = Type::Void; return true;
+            
+            default:                    return false;
+        }
+    }
+    
+    Type TypedBuilder::local(std::uint64_t slot) const {
+        return slot < locals_.size() ? locals_[slot] : Type::Invalid;
+    }
+    
+    bool TypedBuilder::setLocal(std::uint64_t slot, Type type) {
+        if(slot >= locals_.size() || !isConcrete(type)) return false;
+        if(locals_[slot] == Type::Invalid) locals_[slot] = type;
+        return locals_[slot] == type;
+    }
+    
+    // The stack after [inst], given the stack before it.
+    bool TypedBuilder::step(const ILInstruction& inst, Stack& stack) {
+        auto operand = prefix(inst);
+        switch(inst.code()) {
+            case Opcode::load_c:
+            {
+                auto index = operand & 0x00ff;
+                if(index >= constants_.size()) return false;
+                stack.push_back(constantType(constants_[index]));
+                return isConcrete(stack.back());
+            }
+            
+            case Opcode::load:
+                stack.push_back(local(operand & 0x00ff));
+                return isConcrete(stack.back());
+            
+            case Opcode::store:
+                if(stack.empty() || !setLocal(operand & 0x00ff, stack.back())) return false;
+                stack.pop_back();
+                return true;
+            
+            case Opcode::dup:
+                if(stack.empty()) return false;
+                stack.push_back(stack.back());
+                return true;
+            
+            case Opcode::inc_l:
+                return setLocal((operand >> 8) & 0x00ff, Type::Integer);
+            
+            case Opcode::test_ilt_li:
+            case Opcode::test_ilteq_li:
+            case Opcode::test_igt_li:
+            case Opcode::test_igteq_li:
+            case Opcode::test_ieq_li:
+                if(!setLocal((operand >> 16) & 0x00ff, Type::Integer)) return false;
+                stack.push_back(Type::Bool);
+                return true;
+            
+            case Opcode::jilt_li:
+            case Opcode::jilteq_li:
+            case Opcode::jigt_li:
+            case Opcode::jigteq_li:
+            case Opcode::jieq_li:
+            case Opcode::jine_li:
+                return setLocal((operand >> 16) & 0x00ff, Type::Integer);
+            
+            case Opcode::loop_enter:
+                if(stack.empty() || stack.back() != Type::Integer) return false;
+                stack.pop_back();
+                return setLocal(operand & 0x00ff, Type::Integer);
+            
+            case Opcode::loop_next:
+                return setLocal(operand & 0x00ff, Type::Integer);
+            
+            case Opcode::call_n:
+            case Opcode::call_f:
+                if(stack.size() < inst.callArity()) return false;
+                stack.resize(stack.size() - inst.callArity());
+                if(inst.callResult()) stack.push_back(inst.callType());
+                return inst.callType() == Type::Void || isConcrete(inst.callType());
+            
+            case Opcode::tail_n:
+                if(stack.size() < inst.callArity()) return false;
+                stack.resize(stack.size() - inst.callArity());
+                return true;
+            
+            default:
+            {
+                std::uint64_t pops = 0;
+                Type result = Type::Void;
+                if(!effect(inst.code(), pops, result) || stack.size() < pops) return false;
+                stack.resize(stack.size() - pops);
+                if(result != Type::Void) stack.push_back(result);
+                return true;
+            }
+        }
+    }
+    
+    // The operand types before each reachable instruction. Locals get their type from the first
+    // store reached, so a local only read on paths walked before that store is retried until the
+    // types stop changing.
+    bool TypedBuilder::analyze() {
+        const auto& il = function_.il_;
+        auto known = [this] { return std::count_if(locals_.begin(), locals_.end(), isConcrete); };
+        
+        for(;;) {
+            auto before = known();
+            stacks_.assign(il.size() + 1, Stack());
+            reached_.assign(il.size() + 1, false);
+            reached_[0] = true;
+            
+            std::vector<std::uint64_t> work{0};
+            auto visit = [&](std::uint64_t at, const Stack& stack) {
+                if(!reached_[at]) {
+                    reached_[at] = true;
+                    stacks_[at] = stack;
+                    work.push_back(at);
+                    return true;
+                }
+                return stacks_[at] == stack;
+            };
+            
+            bool valid = true;
+            while(valid && !work.empty()) {
+                auto at = work.back();
+                work.pop_back();
+                if(at == il.size()) continue;
+                
+                const auto& inst = il[at];
+                auto stack = stacks_[at];
+                if(!isEmitted(inst)) {
+                    valid = visit(at + 1, stack);
+                    continue;
+                }
+                if(!step(inst, stack)) {
+                    valid = false;
+                    break;
+                }
+                if(!inst.label().empty() && !visit(function_.symbols_.at(inst.label()), stack)) valid = false;
+                if(fallsThrough(inst.code()) && !visit(at + 1, stack)) valid = false;
+            }
+            if(valid) return true;
+            if(known() == before) return false;
+        }
+    }
+    
+    void TypedBuilder::emitOperand(std::uint64_t operand, std::uint64_t size) {
+        for(std::int64_t i = size - 1; i >= 0; --i) {
+            code_.push_back((operand >> (8 * i)) & 0x00ff);
+        }
+    }
+    
+    // Strings left on the stack are released, popping everything down to the last of them.
+    void TypedBuilder::cleanup(const Stack& stack) {
+        auto last = std::find(stack.begin(), stack.end(), Type::String);
+        for(auto it = stack.end(); it != last; --it) {
+            if(it[-1] == Type::String) emit(Opcode::release);
+            emit(Opcode::pop);
+        }
+    }
+    
+    static Opcode forward(Opcode code) {
+        switch(code) {
+            case Opcode::rjmp:  return Opcode::jmp;
+            case Opcode::rjnz:  return Opcode::jnz;
+            case Opcode::rjz:   return Opcode::jz;
+            default:            return code;
+        }
+    }
+    
+    static Opcode backward(Opcode code) {
+        switch(code) {
+            case Opcode::jmp:   return Opcode::rjmp;
+            case Opcode::jnz:   return Opcode::rjnz;
+            default:            return Opcode::rjz;
+        }
+    }
+    
+    bool TypedBuilder::lower(const ILInstruction& inst,
+                             const Stack& stack,
+                             std::vector<std::string>& imports,
+                             std::vector<std::vector<Type>>& importTypes) {
+        auto operand = prefix(inst);
+        auto size = operandSize(inst.code());
+        
+        switch(inst.code()) {
+            case Opcode::load_c:
+                emit(Opcode::load_c);
+                emitOperand(operand, 1);
+                if(constantType(constants_[operand & 0x00ff]) == Type::String) emit(Opcode::retain);
+                return true;
+            
+            case Opcode::load:
+                emit(Opcode::load);
+                emitOperand(operand, 1);
+                if(local(operand & 0x00ff) == Type::String) emit(Opcode::retain);
+                return true;
+            
+            case Opcode::dup:
+                emit(Opcode::dup);
+                if(stack.back() == Type::String) emit(Opcode::retain);
+                return true;
+            
+            case Opcode::store:
+                emit(local(operand & 0x00ff) == Type::String ? Opcode::store_s : Opcode::store);
+                emitOperand(operand, 1);
+                return true;
+            
+            case Opcode::pop:
+                if(stack.back() == Type::String) emit(Opcode::release);
+                emit(Opcode::pop);
+                return true;
+            
+            case Opcode::call_f:
+            {
+                const auto& signature = imports_[operand & 0x00ff];
+                std::vector<Type> types(stack.end() - inst.callArity(), stack.end());
+                std::uint64_t index = 0;
+                while(index < imports.size() && (imports[index] != signature || importTypes[index] != types)) {
+                    ++index;
+                }
+                if(index == imports.size()) {
+                    imports.push_back(signature);
+                    importTypes.push_back(types);
+                }
+                if(index > UINT8_MAX) return false;
+                emit(Opcode::call_f);
+                emitOperand(index, 1);
+                return true;
+            }
+            
+            case Opcode::yield_v:
+                emit(Opcode::yield_t);
+                emitOperand(stack.back(), 1);
+                return true;
+            
+            case Opcode::ret:
+            case Opcode::halt:
+            case Opcode::fail:
+                cleanup(stack);
+                break;
+            
+            case Opcode::ret_v:
+                if(std::find(stack.begin(), stack.end() - 1, Type::String) != stack.end() - 1) return false;
+                break;
+            
+            case Opcode::tail_n:
+            {
+                auto args = stack.end() - inst.callArity();
+                if(std::find(stack.begin(), args, Type::String) != args) return false;
+                break;
+            }
+            
+            default:
+                break;
+        }
+        
+        if(inst.label().empty()) {
+            emit(inst.code());
+            emitOperand(operand, size);
+            return true;
+        }
+        emit(inst.hasSignedOffset() ? inst.code() : forward(inst.code()));
+        emitOperand(operand, size - 2);
+        fixups_.push_back(Fixup{code_.size(), function_.symbols_.at(inst.label()), inst.hasSignedOffset()});
+        emitOperand(0, 2);
+        return true;
+    }
+    
+    bool TypedBuilder::build(Program::Function& function,
+                             std::vector<std::string>& imports,
+                             std::vector<std::vector<Type>>& importTypes) {
+        const auto& il = function_.il_;
+        for(const auto& inst: il) {
+            auto code = inst.code();
+            if(code == Opcode::retain || code == Opcode::release) return false;
+        }
+        if(!analyze()) return false;
+        
+        addresses_.assign(il.size() + 1, 0);
+        for(std::uint64_t at = 0; at < il.size(); ++at) {
+            addresses_[at] = code_.size();
+            if(!reached_[at] || !isEmitted(il[at])) continue;
+            if(!lower(il[at], stacks_[at], imports, importTypes)) return false;
+        }
+        addresses_[il.size()] = code_.size();
+        
+        for(const auto& fixup: fixups_) {
+            std::int64_t offset = addresses_[fixup.target] - (fixup.at + 2);
+            if(fixup.isSigned) {
+                if(offset < INT16_MIN || offset > INT16_MAX) return false;
+            } else {
+                if(offset < 0) {
+                    code_[fixup.at - 1] = static_cast<std::uint8_t>(backward(static_cast<Opcode>(code_[fixup.at - 1])));
+                    offset = -offset;
+                }
+                if(offset > UINT16_MAX) return false;
+            }
+            code_[fixup.at] = (offset >> 8) & 0x00ff;
+            code_[fixup.at + 1] = offset & 0x00ff;
+        }
+        
+        function.bytecode = code_;
+        function.variableCount = locals_.size();
+        function.arity = function_.arity_;
+        function.paramTypes = function_.paramTypes_;
+        function.returnType = function_.returnType_;
+        function.strings.clear();
+        for(std::uint64_t i = 0; i < locals_.size(); ++i) {
+            if(locals_[i] == Type::String) function.strings.push_back(i);
+        }
+        std::uint64_t depth = 0;
+        for(std::uint64_t at = 0; at <= il.size(); ++at) {
+            if(reached_[at]) depth = std::max<std::uint64_t>(depth, stacks_[at].size());
+        }
+        function.stackDepth = depth;
+        return true;
+    }
+    
+    void TypedBuilder::dump(const Program::Function& function, std::ostream& out) {
+        const auto& code = function.bytecode;
+        for(std::uint64_t at = 0; at < code.size();) {
+            auto op = static_cast<Opcode>(code[at]);
+            out << "\t" << op;
+            auto size = operandSize(op);
+            for(int i = 0; i < size; ++i) {
+                out << (i ? ", " : " \t") << static_cast<int>(code[at + 1 + i]);
+            }
+            out << std::endl;
+            at += 1 + size;
+        }
+    }
+}
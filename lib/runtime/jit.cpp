@@ -0,0 +1,1279 @@
+//
+//  jit.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/runtime/jit.hpp>
+#include <tinyscript/runtime/program.hpp>
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(TINYSCRIPT_NO_JIT)
+#define TINYSCRIPT_HAS_JIT 1
+#include <sys/mman.h>
+#else
+#define TINYSCRIPT_HAS_JIT 0
+#endif
+
+namespace tinyscript {
+    
+    bool JIT::isAvailable() {
+        return TINYSCRIPT_HAS_JIT;
+    }
+    
+#if TINYSCRIPT_HAS_JIT
+    namespace {
+        
+        enum Register : int {
+            rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15
+        };
+        
+        enum Condition : std::uint8_t {
+            B = 2, AE = 3, E = 4, NE = 5, BE = 6, A = 7, P = 10, NP = 11, L = 12, GE = 13, LE = 14, G = 15
+        };
+        
+        enum ALU : std::uint8_t { Add = 0, Or = 1, And = 4, Sub = 5, Xor = 6, Cmp = 7 };
+        
+        // Values on the stack live in the caller-saved registers, the most used locals in the
+        // callee-saved ones. r10 and r11 are scratch registers for single instructions.
+        static const Register pool[] = {rax, rcx, rdx, rsi, rdi, r8, r9};
+        static const Register localRegisters[] = {rbx, r12, r13, r14, r15};
+        static const Register argRegisters[] = {rsi, rdx, rcx, r8, r9};
+        static constexpr Register T0 = r11;
+        static constexpr Register T1 = r10;
+        
+        static bool fits8(std::int64_t v) { return v >= -128 && v <= 127; }
+        static bool fits32(std::int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+        
+        // A register, an rbp-relative memory slot or an immediate.
+        struct Operand {
+            enum Kind { Reg, Mem, Imm } kind;
+            std::int64_t value;
+            
+            static Operand reg(int r) { return Operand{Reg, r}; }
+            static Operand mem(std::int32_t disp) { return Operand{Mem, disp}; }
+            static Operand imm(std::int64_t v) { return Operand{Imm, v}; }
+            bool isReg(int r) const { return kind == Reg && value == r; }
+        };
+        
+        class Assembler {
+        public:
+            std::uint64_t size() const { return code_.size(); }
+            const std::vector<std::uint8_t>& code() const { return code_; }
+            
+            void byte(std::uint8_t b) { code_.push_back(b); }
+            void u32(std::uint32_t v) { for(int i = 0; i < 4; ++i) byte(v >> (8 * i)); }
+            void u64(std::uint64_t v) { for(int i = 0; i < 8; ++i) byte(v >> (8 * i)); }
+            
+            void align(std::uint64_t n) { while(size() % n) byte(0xcc); }
+            void patch(std::uint64_t at, std::uint64_t target) {
+                std::int32_t rel = static_cast<std::int32_t>(target - (at + 4));
+                std::memcpy(code_.data() + at, &rel, 4);
+            }
+            
+            // [prefix] [REX] opcode ModRM [disp]: [reg] goes in ModRM.reg, [rm] is a register or an
+            // rbp-relative slot.
+            void rm(std::initializer_list<std::uint8_t> opcode, int reg, const Operand& rm,
+                    bool wide, std::uint8_t prefix = 0, bool forceRex = false) {
+                if(prefix) byte(prefix);
+                int base = rm.kind == Operand::Reg ? static_cast<int>(rm.value) : rbp;
+                std::uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0);
+                if(rex != 0x40 || forceRex) byte(rex);
+                for(auto op: opcode) byte(op);
+                if(rm.kind == Operand::Reg) {
+                    byte(0xc0 | ((reg & 7) << 3) | (base & 7));
+                } else if(fits8(rm.value)) {
+                    byte(0x40 | ((reg & 7) << 3) | 5);
+                    byte(static_cast<std::uint8_t>(rm.value));
+                } else {
+                    byte(0x80 | ((reg & 7) << 3) | 5);
+                    u32(static_cast<std::uint32_t>(rm.value));
+                }
+            }
+            
+            void mov(int dst, const Operand& src) {
+                switch(src.kind) {
+                    case Operand::Reg: if(src.value != dst) rm({0x8b}, dst, src, true); break;
+                    case Operand::Mem: rm({0x8b}, dst, src, true); break;
+                    case Operand::Imm: movImm(dst, src.value); break;
+                }
+            }
+            
+            // Never clobbers the flags, so it can sit between a compare and its branch.
+            void movImm(int dst, std::int64_t v) {
+                if(v >= 0 && v <= UINT32_MAX) {
+                    if(dst & 8) byte(0x41);
+                    byte(0xb8 + (dst & 7));
+                    u32(static_cast<std::uint32_t>(v));
+                } else if(fits32(v)) {
+                    rm({0xc7}, 0, Operand::reg(dst), true);
+                    u32(static_cast<std::uint32_t>(v));
+                } else {
+                    byte(0x48 | ((dst & 8) ? 1 : 0));
+                    byte(0xb8 + (dst & 7));
+                    u64(static_cast<std::uint64_t>(v));
+                }
+            }
+            
+            void store(const Operand& mem, int src) { rm({0x89}, src, mem, true); }
+            void storeImm(const Operand& mem, std::int32_t v) { rm({0xc7}, 0, mem, true); u32(v); }
+            
+            void alu(ALU op, int dst, const Operand& src) { rm({static_cast<std::uint8_t>((op << 3) | 3)}, dst, src, true); }
+            void alu(ALU op, const Operand& dst, int src) { rm({static_cast<std::uint8_t>((op << 3) | 1)}, src, dst, true); }
+            void aluImm(ALU op, const Operand& dst, std::int32_t v) {
+                if(fits8(v)) {
+                    rm({0x83}, op, dst, true);
+                    byte(static_cast<std::uint8_t>(v));
+                } else {
+                    rm({0x81}, op, dst, true);
+                    u32(static_cast<std::uint32_t>(v));
+                }
+            }
+            
+            void imul(int dst, const Operand& src) { rm({0x0f, 0xaf}, dst, src, true); }
+            void imulImm(int dst, std::int32_t v) { rm({0x69}, dst, Operand::reg(dst), true); u32(v); }
+            void neg(int r) { rm({0xf7}, 3, Operand::reg(r), true); }
+            void cqo() { byte(0x48); byte(0x99); }
+            void idiv(const Operand& src) { rm({0xf7}, 7, src, true); }
+            void test(int a, int b) { rm({0x85}, b, Operand::reg(a), true); }
+            void setcc(Condition cc, int r) { rm({0x0f, static_cast<std::uint8_t>(0x90 | cc)}, 0, Operand::reg(r), false, 0, true); }
+            void movzx8(int r) { rm({0x0f, 0xb6}, r, Operand::reg(r), false, 0, true); }
+            void and8(int dst, int src) { rm({0x20}, src, Operand::reg(dst), false, 0, true); }
+            void btc(int r, std::uint8_t bit) { rm({0x0f, 0xba}, 7, Operand::reg(r), true); byte(bit); }
+            
+            void movqToXmm(int xmm, const Operand& src) { rm({0x0f, 0x6e}, xmm, src, true, 0x66); }
+            void movqFromXmm(int dst, int xmm) { rm({0x0f, 0x7e}, xmm, Operand::reg(dst), true, 0x66); }
+            void sse(std::uint8_t op, int xmm, const Operand& src) { rm({0x0f, op}, xmm, src, false, 0xf2); }
+            void ucomisd(int xmm, const Operand& src) { rm({0x0f, 0x2e}, xmm, src, false, 0x66); }
+            void xorps(int xmm, int src) { rm({0x0f, 0x57}, xmm, Operand::reg(src), false); }
+            void cvtsi2sd(int xmm, const Operand& src) { rm({0x0f, 0x2a}, xmm, src, true, 0xf2); }
+            void cvttsd2si(int dst, const Operand& src) { rm({0x0f, 0x2c}, dst, src, true, 0xf2); }
+            
+            // Branches and calls return the offset of their rel32, to be patched later.
+            std::uint64_t jcc(Condition cc) { byte(0x0f); byte(0x80 | cc); u32(0); return size() - 4; }
+            std::uint64_t jmp() { byte(0xe9); u32(0); return size() - 4; }
+            std::uint64_t call() { byte(0xe8); u32(0); return size() - 4; }
+        
+        private:
+            std::vector<std::uint8_t> code_;
+        };
+        
+        struct Instruction {
+            Opcode          code;
+            std::uint64_t   next;
+            std::int64_t    target = -1;
+            std::uint8_t    slot = 0;
+            std::int64_t    imm = 0;
+        };
+        
+        static bool decode(const std::vector<std::uint8_t>& bytecode, std::uint64_t pc, Instruction& inst) {
+            if(pc >= bytecode.size() || bytecode[pc] > Opcode::nop) return false;
+            inst = Instruction{static_cast<Opcode>(bytecode[pc]), 0};
+            inst.next = pc + 1 + operandSize(inst.code);
+            if(inst.next > bytecode.size()) return false;
+            
+            const auto* op = bytecode.data() + pc + 1;
+            auto read16 = [](const std::uint8_t* p) { return static_cast<std::uint16_t>((p[0] << 8) | p[1]); };
+            auto next = static_cast<std::int64_t>(inst.next);
+            switch(inst.code) {
+                case Opcode::load_c:
+                case Opcode::load:
+                case Opcode::store:
+                    inst.slot = op[0];
+                    break;
+                case Opcode::load_i:
+                case Opcode::iadd_i:
+                case Opcode::isub_i:
+                case Opcode::call_n:
+                case Opcode::tail_n:
+                    inst.imm = inst.code == Opcode::call_n || inst.code == Opcode::tail_n
+                        ? read16(op) : static_cast<std::int16_t>(read16(op));
+                    break;
+                case Opcode::inc_l:
+                    inst.slot = op[0];
+                    inst.imm = static_cast<std::int8_t>(op[1]);
+                    break;
+                case Opcode::test_ilt_li:
+                case Opcode::test_ilteq_li:
+                case Opcode::test_igt_li:
+                case Opcode::test_igteq_li:
+                case Opcode::test_ieq_li:
+                    inst.slot = op[0];
+                    inst.imm = static_cast<std::int16_t>(read16(op + 1));
+                    break;
+                case Opcode::jmp:
+                case Opcode::jnz:
+                case Opcode::jz:
+                    inst.target = next + read16(op);
+                    break;
+                case Opcode::rjmp:
+                case Opcode::rjnz:
+                case Opcode::rjz:
+                    inst.target = next - read16(op);
+                    break;
+                case Opcode::jilt:
+                case Opcode::jilteq:
+                case Opcode::jigt:
+                case Opcode::jigteq:
+                case Opcode::jieq:
+                case Opcode::jine:
+                case Opcode::jflt:
+                case Opcode::jflteq:
+                case Opcode::jfgt:
+                case Opcode::jfgteq:
+                case Opcode::jfeq:
+                case Opcode::jfne:
+                    inst.target = next + static_cast<std::int16_t>(read16(op));
+                    break;
+                case Opcode::jilt_li:
+                case Opcode::jilteq_li:
+                case Opcode::jigt_li:
+                case Opcode::jigteq_li:
+                case Opcode::jieq_li:
+                case Opcode::jine_li:
+                    inst.slot = op[0];
+                    inst.imm = static_cast<std::int16_t>(read16(op + 1));
+                    inst.target = next + static_cast<std::int16_t>(read16(op + 3));
+                    break;
+                case Opcode::loop_enter:
+                case Opcode::loop_next:
+                    inst.slot = op[0];
+                    inst.target = next + static_cast<std::int16_t>(read16(op + 1));
+                    break;
+                default:
+                    break;
+            }
+            return true;
+        }
+        
+        static bool isUnboxed(Type type) {
+            return type == Type::Integer || type == Type::Number || type == Type::Bool;
+        }
+        
+        static bool readsLocal(Opcode code) {
+            switch(code) {
+                case Opcode::load:
+                case Opcode::store:
+                case Opcode::inc_l:
+                case Opcode::test_ilt_li:
+                case Opcode::test_ilteq_li:
+                case Opcode::test_igt_li:
+                case Opcode::test_igteq_li:
+                case Opcode::test_ieq_li:
+                case Opcode::jilt_li:
+                case Opcode::jilteq_li:
+                case Opcode::jigt_li:
+                case Opcode::jigteq_li:
+                case Opcode::jieq_li:
+                case Opcode::jine_li:
+                case Opcode::loop_enter:
+                case Opcode::loop_next:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+        
+        // Stack depth at every reachable instruction, which must not depend on the path taken to
+        // get there, and everything else the code generator needs to know before it starts.
+        struct Analysis {
+            std::vector<std::int32_t>   depth;
+            std::vector<bool>           isTarget;
+            std::int32_t                maxDepth = 0;
+            std::vector<std::uint16_t>  callees;
+            std::vector<std::uint32_t>  uses;
+            bool                        loops = false;
+        };
+        
+        // Values an instruction pops and pushes, or false if the JIT doesn't compile it.
+        static bool effect(const Program& program, const Program::Function& function,
+                           const Instruction& inst, int& pops, int& pushes) {
+            pops = pushes = 0;
+            switch(inst.code) {
+                case Opcode::load_c:
+                {
+                    if(inst.slot >= program.constants.size()) return false;
+                    auto kind = program.constants[inst.slot].kind;
+                    if(kind != Value::Kind::Int && kind != Value::Kind::Number && kind != Value::Kind::Bool) return false;
+                    pushes = 1;
+                    return true;
+                }
+                case Opcode::load_i:
+                case Opcode::load_yes:
+                case Opcode::load_no:
+                case Opcode::load:
+                case Opcode::test_ilt_li:
+                case Opcode::test_ilteq_li:
+                case Opcode::test_igt_li:
+                case Opcode::test_igteq_li:
+                case Opcode::test_ieq_li:
+                    pushes = 1;
+                    return true;
+                case Opcode::dup:
+                    pops = 1;
+                    pushes = 2;
+                    return true;
+                case Opcode::store:
+                case Opcode::pop:
+                case Opcode::jnz:
+                case Opcode::rjnz:
+                case Opcode::jz:
+                case Opcode::rjz:
+                case Opcode::loop_enter:
+                    pops = 1;
+                    return true;
+                case Opcode::fmin:
+                case Opcode::imin:
+                case Opcode::iadd_i:
+                case Opcode::isub_i:
+                case Opcode::i2f:
+                case Opcode::f2i:
+                    pops = pushes = 1;
+                    return true;
+                case Opcode::fadd:
+                case Opcode::fsub:
+                case Opcode::fmul:
+                case Opcode::fdiv:
+                case Opcode::iadd:
+                case Opcode::isub:
+                case Opcode::imul:
+                case Opcode::idiv:
+                case Opcode::log_and:
+                case Opcode::log_or:
+                case Opcode::test_flt:
+                case Opcode::test_flteq:
+                case Opcode::test_fgt:
+                case Opcode::test_fgteq:
+                case Opcode::test_feq:
+                case Opcode::test_ilt:
+                case Opcode::test_ilteq:
+                case Opcode::test_igt:
+                case Opcode::test_igteq:
+                case Opcode::test_ieq:
+                    pops = 2;
+                    pushes = 1;
+                    return true;
+                case Opcode::jilt:
+                case Opcode::jilteq:
+                case Opcode::jigt:
+                case Opcode::jigteq:
+                case Opcode::jieq:
+                case Opcode::jine:
+                case Opcode::jflt:
+                case Opcode::jflteq:
+                case Opcode::jfgt:
+                case Opcode::jfgteq:
+                case Opcode::jfeq:
+                case Opcode::jfne:
+                    pops = 2;
+                    return true;
+                case Opcode::inc_l:
+                case Opcode::jmp:
+                case Opcode::rjmp:
+                case Opcode::jilt_li:
+                case Opcode::jilteq_li:
+                case Opcode::jigt_li:
+                case Opcode::jigteq_li:
+                case Opcode::jieq_li:
+                case Opcode::jine_li:
+                case Opcode::loop_next:
+                case Opcode::nop:
+                    return true;
+                case Opcode::call_n:
+                {
+                    if(static_cast<std::uint64_t>(inst.imm) >= program.functions.size()) return false;
+                    const auto& callee = program.functions[inst.imm];
+                    pops = callee.arity;
+                    pushes = callee.returnType != Type::Void;
+                    return true;
+                }
+                case Opcode::tail_n:
+                {
+                    if(static_cast<std::uint64_t>(inst.imm) >= program.functions.size()) return false;
+                    const auto& callee = program.functions[inst.imm];
+                    pops = callee.arity;
+                    return callee.returnType == function.returnType;
+                }
+                // A `ret` in a function that returns a value (or the other way around) would leave
+                // the caller's stack unbalanced, which only the interpreter reproduces faithfully.
+                case Opcode::ret:
+                    return function.returnType == Type::Void;
+                case Opcode::ret_v:
+                    pops = 1;
+                    return function.returnType != Type::Void;
+                default:
+                    return false;
+            }
+        }
+        
+        static bool fallsThrough(Opcode code) {
+            return code != Opcode::jmp && code != Opcode::rjmp && code != Opcode::ret && code != Opcode::ret_v
+                && code != Opcode::tail_n;
+        }
+        
+        static bool analyze(const Program& program, const Program::Function& function, Analysis& analysis) {
+            if(function.arity > JIT::maxArity || function.paramTypes.size() != function.arity) return false;
+            if(function.returnType != Type::Void && !isUnboxed(function.returnType)) return false;
+            for(auto type: function.paramTypes) {
+                if(!isUnboxed(type)) return false;
+            }
+            
+            const auto& bytecode = function.bytecode;
+            analysis.depth.assign(bytecode.size(), -1);
+            analysis.isTarget.assign(bytecode.size(), false);
+            analysis.uses.assign(function.variableCount, 0);
+            
+            std::vector<std::pair<std::uint64_t, std::int32_t>> pending{{0, 0}};
+            while(!pending.empty()) {
+                auto pc = pending.back().first;
+                auto depth = pending.back().second;
+                pending.pop_back();
+                if(pc >= bytecode.size()) return false;
+                if(analysis.depth[pc] >= 0) {
+                    if(analysis.depth[pc] != depth) return false;
+                    continue;
+                }
+                analysis.depth[pc] = depth;
+                
+                Instruction inst;
+                int pops, pushes;
+                if(!decode(bytecode, pc, inst) || !effect(program, function, inst, pops, pushes)) return false;
+                if(pops > depth) return false;
+                if(readsLocal(inst.code)) {
+                    if(inst.slot >= function.variableCount) return false;
+                    analysis.uses[inst.slot] += 1;
+                }
+                if(inst.code == Opcode::call_n || inst.code == Opcode::tail_n) analysis.callees.push_back(inst.imm);
+                
+                depth += pushes - pops;
+                analysis.maxDepth = std::max(analysis.maxDepth, depth);
+                if(inst.target >= 0) {
+                    if(static_cast<std::uint64_t>(inst.target) >= bytecode.size()) return false;
+                    analysis.isTarget[inst.target] = true;
+                    if(static_cast<std::uint64_t>(inst.target) <= pc) analysis.loops = true;
+                    pending.push_back({inst.target, depth});
+                } else if(inst.target < -1) {
+                    return false;
+                }
+                if(fallsThrough(inst.code)) pending.push_back({inst.next, depth});
+            }
+            return true;
+        }
+        
+        struct Fixup {
+            std::uint64_t   at;
+            std::int64_t    target;
+        };
+        
+        // Compiles one function in a single pass over its bytecode. The operand stack is only
+        // simulated: entries are constants, locals, registers or (once spilled) memory slots, and
+        // code is only generated when an instruction consumes them. At branches and jump targets
+        // every entry is spilled to its slot, so all the paths into a block agree on where the
+        // stack lives.
+        class FunctionCompiler {
+        public:
+            FunctionCompiler(const Program& program, const Program::Function& function,
+                             const Analysis& analysis, Assembler& as)
+            : program_(program), function_(function), analysis_(analysis), as_(as) {}
+            
+            void compile(std::vector<Fixup>& calls);
+        
+        private:
+            struct Entry {
+                enum Kind { Imm, Local, Reg, Mem } kind;
+                std::int64_t value;
+            };
+            
+            struct Popped {
+                Entry   entry;
+                Operand op;
+                bool owned() const { return entry.kind == Entry::Reg; }
+            };
+            
+            void layoutFrame();
+            void prologue();
+            void epilogue();
+            void instruction(const Instruction& inst);
+            
+            Operand local(std::uint8_t slot) const { return homes_[slot]; }
+            Operand spillSlot(std::uint64_t index) const { return Operand::mem(spillBase_ - 8 * static_cast<std::int32_t>(index)); }
+            Operand operand(std::uint64_t index) const;
+            void push(Entry::Kind kind, std::int64_t value) { stack_.push_back(Entry{kind, value}); }
+            Popped pop(std::uint32_t& busy);
+            int allocate(std::uint32_t busy);
+            void spill(std::uint64_t index);
+            void flush();
+            void materialize(std::uint8_t slot, std::uint32_t busy);
+            
+            void storeLocal(std::uint8_t slot, const Operand& value);
+            void aluOp(ALU op, int dst, const Operand& src);
+            void compare(Operand a, Operand b);
+            void compareFloat(const Operand& a, const Operand& b);
+            void toXmm(int xmm, const Operand& src);
+            void testZero(const Operand& value);
+            void jump(std::int64_t target);
+            void branch(Condition cc, std::int64_t target);
+            void setFlag(Condition cc, int dst);
+            
+            void integerOp(Opcode code);
+            void divide();
+            void floatOp(Opcode code);
+            void compareOp(Opcode code, bool jumps, std::int64_t target);
+            void passArguments(std::uint8_t arity);
+            void call(std::uint16_t index, std::vector<Fixup>& calls);
+            void tailCall(std::uint16_t index, std::vector<Fixup>& calls);
+            
+            const Program&              program_;
+            const Program::Function&    function_;
+            const Analysis&             analysis_;
+            Assembler&                  as_;
+            
+            std::vector<Operand>        homes_;
+            std::vector<Register>       saved_;
+            std::int32_t                depthSlot_ = 0;
+            std::int32_t                spillBase_ = 0;
+            std::int32_t                frameSize_ = 0;
+            
+            std::vector<Entry>          stack_;
+            bool                        live_ = true;
+            std::vector<std::uint64_t>  labels_;
+            std::vector<Fixup>          jumps_;
+            std::vector<std::uint64_t>  errorJumps_;
+        };
+        
+        // The most used locals get a callee-saved register, the others a slot in the frame, below
+        // the saved registers and the call depth. The stack's spill slots come last.
+        void FunctionCompiler::layoutFrame() {
+            std::vector<std::uint8_t> slots;
+            for(std::uint32_t slot = 0; slot < function_.variableCount; ++slot) slots.push_back(slot);
+            std::stable_sort(slots.begin(), slots.end(), [this](std::uint8_t a, std::uint8_t b) {
+                return analysis_.uses[a] > analysis_.uses[b];
+            });
+            
+            homes_.assign(function_.variableCount, Operand::imm(0));
+            for(auto slot: slots) {
+                if(saved_.size() == sizeof(localRegisters)/sizeof(localRegisters[0]) || !analysis_.uses[slot]) break;
+                saved_.push_back(localRegisters[saved_.size()]);
+                homes_[slot] = Operand::reg(saved_.back());
+            }
+            
+            std::int32_t words = saved_.size();
+            depthSlot_ = -8 * ++words;
+            for(auto& home: homes_) {
+                if(home.kind != Operand::Reg) home = Operand::mem(-8 * ++words);
+            }
+            spillBase_ = -8 * (words + 1);
+            words += analysis_.maxDepth;
+            frameSize_ = (8 * words + 15) & ~15;
+        }
+        
+        void FunctionCompiler::prologue() {
+            as_.byte(0x55);                                     // push rbp
+            as_.rm({0x89}, rsp, Operand::reg(rbp), true);       // mov rbp, rsp
+            as_.aluImm(Sub, Operand::reg(rsp), frameSize_);
+            for(std::uint64_t i = 0; i < saved_.size(); ++i) {
+                as_.store(Operand::mem(-8 * static_cast<std::int32_t>(i + 1)), saved_[i]);
+            }
+            
+            // Out of call frames: fail like the interpreter's call stack would.
+            as_.test(rdi, rdi);
+            errorJumps_.push_back(as_.jcc(E));
+            as_.store(Operand::mem(depthSlot_), rdi);
+            for(std::uint8_t i = 0; i < function_.arity; ++i) {
+                storeLocal(i, Operand::reg(argRegisters[i]));
+            }
+        }
+        
+        void FunctionCompiler::epilogue() {
+            for(std::uint64_t i = 0; i < saved_.size(); ++i) {
+                as_.mov(saved_[i], Operand::mem(-8 * static_cast<std::int32_t>(i + 1)));
+            }
+            as_.byte(0xc9);                                     // leave
+            as_.byte(0xc3);                                     // ret
+        }
+        
+        void FunctionCompiler::compile(std::vector<Fixup>& calls) {
+            const auto& bytecode = function_.bytecode;
+            labels_.assign(bytecode.size(), 0);
+            layoutFrame();
+            prologue();
+            
+            for(std::uint64_t pc = 0; pc < bytecode.size();) {
+                Instruction inst;
+                decode(bytecode, pc, inst);
+                if(analysis_.depth[pc] < 0) {
+                    live_ = false;
+                    pc = inst.next;
+                    continue;
+                }
+                if(analysis_.isTarget[pc] || !live_) {
+                    if(live_) flush();
+                    stack_.assign(analysis_.depth[pc], Entry{Entry::Mem, 0});
+                }
+                labels_[pc] = as_.size();
+                live_ = true;
+                
+                if(inst.code == Opcode::call_n)
+                    call(inst.imm, calls);
+                else if(inst.code == Opcode::tail_n)
+                    tailCall(inst.imm, calls);
+                else
+                    instruction(inst);
+                pc = inst.next;
+            }
+            
+            for(auto& jump: jumps_) as_.patch(jump.at, labels_[jump.target]);
+            for(auto at: errorJumps_) as_.patch(at, as_.size());
+            as_.movImm(rdx, 1);
+            epilogue();
+        }
+        
+        Operand FunctionCompiler::operand(std::uint64_t index) const {
+            const auto& entry = stack_[index];
+            switch(entry.kind) {
+                case Entry::Imm: return Operand::imm(entry.value);
+                case Entry::Local: return local(entry.value);
+                case Entry::Reg: return Operand::reg(entry.value);
+                case Entry::Mem: return spillSlot(index);
+            }
+            return Operand::imm(0);
+        }
+        
+        FunctionCompiler::Popped FunctionCompiler::pop(std::uint32_t& busy) {
+            Popped popped{stack_.back(), operand(stack_.size() - 1)};
+            if(popped.op.kind == Operand::Reg) busy |= 1u << popped.op.value;
+            stack_.pop_back();
+            return popped;
+        }
+        
+        // Returns a free stack register, spilling the oldest entry that holds one if needed.
+        int FunctionCompiler::allocate(std::uint32_t busy) {
+            for(const auto& entry: stack_) {
+                if(entry.kind == Entry::Reg) busy |= 1u << entry.value;
+            }
+            for(auto r: pool) {
+                if(!(busy & (1u << r))) return r;
+            }
+            for(std::uint64_t i = 0; i < stack_.size(); ++i) {
+                if(stack_[i].kind != Entry::Reg) continue;
+                auto r = static_cast<int>(stack_[i].value);
+                spill(i);
+                return r;
+            }
+            return T0;
+        }
+        
+        void FunctionCompiler::spill(std::uint64_t index) {
+            auto& entry = stack_[index];
+            if(entry.kind == Entry::Mem) return;
+            auto slot = spillSlot(index);
+            auto value = operand(index);
+            if(value.kind == Operand::Imm && fits32(value.value)) {
+                as_.storeImm(slot, value.value);
+            } else if(value.kind == Operand::Reg) {
+                as_.store(slot, value.value);
+            } else {
+                as_.mov(T0, value);
+                as_.store(slot, T0);
+            }
+            entry = Entry{Entry::Mem, 0};
+        }
+        
+        void FunctionCompiler::flush() {
+            for(std::uint64_t i = 0; i < stack_.size(); ++i) spill(i);
+        }
+        
+        // Entries that read [slot] get their own copy of it before the local changes.
+        void FunctionCompiler::materialize(std::uint8_t slot, std::uint32_t busy) {
+            for(std::uint64_t i = 0; i < stack_.size(); ++i) {
+                if(stack_[i].kind != Entry::Local || stack_[i].value != slot) continue;
+                auto r = allocate(busy);
+                as_.mov(r, local(slot));
+                stack_[i] = Entry{Entry::Reg, r};
+            }
+        }
+        
+        void FunctionCompiler::storeLocal(std::uint8_t slot, const Operand& value) {
+            auto home = local(slot);
+            if(home.kind == Operand::Reg) {
+                as_.mov(home.value, value);
+            } else if(value.kind == Operand::Reg) {
+                as_.store(home, value.value);
+            } else if(value.kind == Operand::Imm && fits32(value.value)) {
+                as_.storeImm(home, value.value);
+            } else {
+                as_.mov(T0, value);
+                as_.store(home, T0);
+            }
+        }
+        
+        void FunctionCompiler::aluOp(ALU op, int dst, const Operand& src) {
+            if(src.kind != Operand::Imm) {
+                as_.alu(op, dst, src);
+            } else if(fits32(src.value)) {
+                as_.aluImm(op, Operand::reg(dst), src.value);
+            } else {
+                as_.mov(T1, src);
+                as_.alu(op, dst, Operand::reg(T1));
+            }
+        }
+        
+        void FunctionCompiler::compare(Operand a, Operand b) {
+            if(a.kind == Operand::Imm || (a.kind == Operand::Mem && b.kind == Operand::Mem)) {
+                as_.mov(T0, a);
+                a = Operand::reg(T0);
+            }
+            if(b.kind == Operand::Imm && !fits32(b.value)) {
+                as_.mov(T1, b);
+                b = Operand::reg(T1);
+            }
+            if(b.kind == Operand::Imm)
+                as_.aluImm(Cmp, a, b.value);
+            else if(a.kind == Operand::Reg)
+                as_.alu(Cmp, a.value, b);
+            else
+                as_.alu(Cmp, a, b.value);
+        }
+        
+        void FunctionCompiler::toXmm(int xmm, const Operand& src) {
+            if(src.kind == Operand::Imm) {
+                as_.mov(T0, src);
+                as_.movqToXmm(xmm, Operand::reg(T0));
+            } else {
+                as_.movqToXmm(xmm, src);
+            }
+        }
+        
+        // Sets the flags for ucomisd a, b.
+        void FunctionCompiler::compareFloat(const Operand& a, const Operand& b) {
+            toXmm(0, a);
+            if(b.kind == Operand::Mem) {
+                as_.ucomisd(0, b);
+            } else {
+                toXmm(1, b);
+                as_.ucomisd(0, Operand::reg(1));
+            }
+        }
+        
+        void FunctionCompiler::testZero(const Operand& value) {
+            if(value.kind == Operand::Reg)
+                as_.test(value.value, value.value);
+            else
+                as_.aluImm(Cmp, value, 0);
+        }
+        
+        void FunctionCompiler::jump(std::int64_t target) {
+            jumps_.push_back(Fixup{as_.jmp(), target});
+            live_ = false;
+        }
+        
+        void FunctionCompiler::branch(Condition cc, std::int64_t target) {
+            jumps_.push_back(Fixup{as_.jcc(cc), target});
+        }
+        
+        void FunctionCompiler::setFlag(Condition cc, int dst) {
+            as_.setcc(cc, dst);
+            as_.movzx8(dst);
+        }
+        
+        void FunctionCompiler::integerOp(Opcode code) {
+            std::uint32_t busy = 0;
+            auto b = pop(busy);
+            auto a = pop(busy);
+            if(code != Opcode::isub && !a.owned() && b.owned()) std::swap(a, b);
+            
+            int dst = a.owned() ? static_cast<int>(a.op.value) : allocate(busy);
+            as_.mov(dst, a.op);
+            switch(code) {
+                case Opcode::iadd: aluOp(Add, dst, b.op); break;
+                case Opcode::isub: aluOp(Sub, dst, b.op); break;
+                case Opcode::log_and: aluOp(And, dst, b.op); break;
+                case Opcode::log_or: aluOp(Or, dst, b.op); break;
+                case Opcode::imul:
+                    if(b.op.kind == Operand::Imm && fits32(b.op.value)) {
+                        as_.imulImm(dst, b.op.value);
+                    } else if(b.op.kind == Operand::Imm) {
+                        as_.mov(T1, b.op);
+                        as_.imul(dst, Operand::reg(T1));
+                    } else {
+                        as_.imul(dst, b.op);
+                    }
+                    break;
+                default: break;
+            }
+            push(Entry::Reg, dst);
+        }
+        
+        // idiv works on rdx:rax, so whatever else lives there moves out of the way first.
+        void FunctionCompiler::divide() {
+            std::uint32_t busy = 0;
+            auto b = pop(busy);
+            auto a = pop(busy);
+            for(std::uint64_t i = 0; i < stack_.size(); ++i) {
+                if(stack_[i].kind == Entry::Reg && (stack_[i].value == rax || stack_[i].value == rdx)) spill(i);
+            }
+            
+            auto divisor = b.op;
+            if(divisor.kind == Operand::Imm || divisor.isReg(rax) || divisor.isReg(rdx)) {
+                as_.mov(T0, divisor);
+                divisor = Operand::reg(T0);
+            }
+            as_.mov(rax, a.op);
+            as_.cqo();
+            as_.idiv(divisor);
+            push(Entry::Reg, rax);
+        }
+        
+        void FunctionCompiler::floatOp(Opcode code) {
+            std::uint32_t busy = 0;
+            auto b = pop(busy);
+            auto a = pop(busy);
+            
+            toXmm(0, a.op);
+            auto src = b.op;
+            if(src.kind != Operand::Mem) {
+                toXmm(1, src);
+                src = Operand::reg(1);
+            }
+            switch(code) {
+                case Opcode::fadd: as_.sse(0x58, 0, src); break;
+                case Opcode::fmul: as_.sse(0x59, 0, src); break;
+                case Opcode::fsub: as_.sse(0x5c, 0, src); break;
+                case Opcode::fdiv: as_.sse(0x5e, 0, src); break;
+                default: break;
+            }
+            int dst = a.owned() ? static_cast<int>(a.op.value) : b.owned() ? static_cast<int>(b.op.value) : allocate(busy);
+            as_.movqFromXmm(dst, 0);
+            push(Entry::Reg, dst);
+        }
+        
+        // Comparisons either push a boolean or branch. Float comparisons are ordered so that
+        // NaN operands (which set every flag) are false, like in C++.
+        void FunctionCompiler::compareOp(Opcode code, bool jumps, std::int64_t target) {
+            std::uint32_t busy = 0;
+            auto b = pop(busy);
+            auto a = pop(busy);
+            int dst = 0;
+            if(jumps)
+                flush();
+            else
+                dst = allocate(busy);
+            
+            Condition cc = E;
+            bool equal = false, notEqual = false;
+            switch(code) {
+                case Opcode::test_ilt: case Opcode::jilt: compare(a.op, b.op); cc = L; break;
+                case Opcode::test_ilteq: case Opcode::jilteq: compare(a.op, b.op); cc = LE; break;
+                case Opcode::test_igt: case Opcode::jigt: compare(a.op, b.op); cc = G; break;
+                case Opcode::test_igteq: case Opcode::jigteq: compare(a.op, b.op); cc = GE; break;
+                case Opcode::test_ieq: case Opcode::jieq: compare(a.op, b.op); cc = E; break;
+                case Opcode::jine: compare(a.op, b.op); cc = NE; break;
+                case Opcode::test_flt: case Opcode::jflt: compareFloat(b.op, a.op); cc = A; break;
+                case Opcode::test_flteq: case Opcode::jflteq: compareFloat(b.op, a.op); cc = AE; break;
+                case Opcode::test_fgt: case Opcode::jfgt: compareFloat(a.op, b.op); cc = A; break;
+                case Opcode::test_fgteq: case Opcode::jfgteq: compareFloat(a.op, b.op); cc = AE; break;
+                case Opcode::test_feq: case Opcode::jfeq: compareFloat(a.op, b.op); equal = true; break;
+                case Opcode::jfne: compareFloat(a.op, b.op); notEqual = true; break;
+                default: break;
+            }
+            
+            if(!jumps) {
+                as_.setcc(cc, dst);
+                if(equal) {
+                    as_.setcc(NP, T0);
+                    as_.and8(dst, T0);
+                }
+                as_.movzx8(dst);
+                push(Entry::Reg, dst);
+            } else if(equal) {
+                as_.byte(0x7a);                                 // jp over the je
+                as_.byte(0x06);
+                branch(E, target);
+            } else if(notEqual) {
+                branch(P, target);
+                branch(NE, target);
+            } else {
+                branch(cc, target);
+            }
+        }
+        
+        // Script functions call each other with the call depth left in rdi and their arguments in
+        // the next registers, and return their result in rax and the error flag in rdx.
+        void FunctionCompiler::passArguments(std::uint8_t arity) {
+            auto base = stack_.size() - arity;
+            for(std::uint64_t i = 0; i < base; ++i) {
+                if(stack_[i].kind == Entry::Reg) spill(i);
+            }
+            
+            // Arguments already in registers are shuffled into place first, going through T0 to
+            // break cycles. The others can't overlap with the argument registers.
+            std::vector<std::pair<int, int>> moves;
+            for(std::uint64_t i = 0; i < arity; ++i) {
+                const auto& entry = stack_[base + i];
+                if(entry.kind == Entry::Reg && entry.value != argRegisters[i])
+                    moves.push_back({argRegisters[i], entry.value});
+            }
+            while(!moves.empty()) {
+                auto ready = std::find_if(moves.begin(), moves.end(), [&moves](const std::pair<int, int>& move) {
+                    return std::none_of(moves.begin(), moves.end(), [&move](const std::pair<int, int>& other) {
+                        return other.second == move.first;
+                    });
+                });
+                if(ready == moves.end()) {
+                    auto src = moves.front().second;
+                    as_.mov(T0, Operand::reg(src));
+                    for(auto& move: moves) {
+                        if(move.second == src) move.second = T0;
+                    }
+                    continue;
+                }
+                as_.mov(ready->first, Operand::reg(ready->second));
+                moves.erase(ready);
+            }
+            for(std::uint64_t i = 0; i < arity; ++i) {
+                if(stack_[base + i].kind != Entry::Reg) as_.mov(argRegisters[i], operand(base + i));
+            }
+            stack_.resize(base);
+        }
+        
+        void FunctionCompiler::call(std::uint16_t index, std::vector<Fixup>& calls) {
+            const auto& callee = program_.functions[index];
+            passArguments(callee.arity);
+            as_.mov(rdi, Operand::mem(depthSlot_));
+            as_.aluImm(Sub, Operand::reg(rdi), 1);
+            calls.push_back(Fixup{as_.call(), index});
+            as_.test(rdx, rdx);
+            errorJumps_.push_back(as_.jcc(NE));
+            if(callee.returnType != Type::Void) push(Entry::Reg, rax);
+        }
+        
+        // A function calling itself starts over with the arguments as its parameters, other tail
+        // calls are regular calls followed by a return.
+        void FunctionCompiler::tailCall(std::uint16_t index, std::vector<Fixup>& calls) {
+            const auto& callee = program_.functions[index];
+            if(&callee == &function_) {
+                passArguments(callee.arity);
+                for(std::uint8_t i = 0; i < callee.arity; ++i) {
+                    storeLocal(i, Operand::reg(argRegisters[i]));
+                }
+                jump(0);
+                return;
+            }
+            call(index, calls);
+            instruction(Instruction{callee.returnType == Type::Void ? Opcode::ret : Opcode::ret_v, 0});
+        }
+        
+        void FunctionCompiler::instruction(const Instruction& inst) {
+            std::uint32_t busy = 0;
+            switch(inst.code) {
+                case Opcode::load_c:
+                {
+                    const auto& constant = program_.constants[inst.slot];
+                    std::int64_t bits = constant.asInt();
+                    if(constant.kind == Value::Kind::Bool) {
+                        bits = constant.asBool();
+                    } else if(constant.kind == Value::Kind::Number) {
+                        double number = constant.asNumber();
+                        std::memcpy(&bits, &number, sizeof(bits));
+                    }
+                    push(Entry::Imm, bits);
+                    break;
+                }
+                
+                case Opcode::load_i: push(Entry::Imm, inst.imm); break;
+                case Opcode::load_yes: push(Entry::Imm, 1); break;
+                case Opcode::load_no: push(Entry::Imm, 0); break;
+                case Opcode::load: push(Entry::Local, inst.slot); break;
+                
+                case Opcode::dup:
+                {
+                    auto top = stack_.back();
+                    if(top.kind == Entry::Imm || top.kind == Entry::Local) {
+                        stack_.push_back(top);
+                        break;
+                    }
+                    auto r = allocate(top.kind == Entry::Reg ? 1u << top.value : 0);
+                    as_.mov(r, operand(stack_.size() - 1));
+                    push(Entry::Reg, r);
+                    break;
+                }
+                
+                case Opcode::pop:
+                    pop(busy);
+                    break;
+                
+                case Opcode::store:
+                {
+                    auto value = pop(busy);
+                    if(value.entry.kind == Entry::Local && value.entry.value == inst.slot) break;
+                    materialize(inst.slot, busy);
+                    storeLocal(inst.slot, value.op);
+                    break;
+                }
+                
+                case Opcode::iadd:
+                case Opcode::isub:
+                case Opcode::imul:
+                case Opcode::log_and:
+                case Opcode::log_or:
+                    integerOp(inst.code);
+                    break;
+                
+                case Opcode::idiv:
+                    divide();
+                    break;
+                
+                case Opcode::iadd_i:
+                case Opcode::isub_i:
+                case Opcode::imin:
+                case Opcode::fmin:
+                {
+                    auto a = pop(busy);
+                    int dst = a.owned() ? static_cast<int>(a.op.value) : allocate(busy);
+                    as_.mov(dst, a.op);
+                    if(inst.code == Opcode::iadd_i) as_.aluImm(Add, Operand::reg(dst), inst.imm);
+                    else if(inst.code == Opcode::isub_i) as_.aluImm(Sub, Operand::reg(dst), inst.imm);
+                    else if(inst.code == Opcode::imin) as_.neg(dst);
+                    else as_.btc(dst, 63);
+                    push(Entry::Reg, dst);
+                    break;
+                }
+                
+                case Opcode::inc_l:
+                    materialize(inst.slot, 0);
+                    as_.aluImm(Add, local(inst.slot), inst.imm);
+                    break;
+                
+                case Opcode::i2f:
+                {
+                    auto a = pop(busy);
+                    int dst = a.owned() ? static_cast<int>(a.op.value) : allocate(busy);
+                    if(a.op.kind == Operand::Imm) {
+                        as_.mov(T0, a.op);
+                        a.op = Operand::reg(T0);
+                    }
+                    // cvtsi2sd only writes the low half of xmm0: clearing it first keeps the
+                    // conversion from waiting on whatever computed xmm0 last.
+                    as_.xorps(0, 0);
+                    as_.cvtsi2sd(0, a.op);
+                    as_.movqFromXmm(dst, 0);
+                    push(Entry::Reg, dst);
+                    break;
+                }
+                
+                case Opcode::f2i:
+                {
+                    auto a = pop(busy);
+                    int dst = a.owned() ? static_cast<int>(a.op.value) : allocate(busy);
+                    if(a.op.kind == Operand::Mem) {
+                        as_.cvttsd2si(dst, a.op);
+                    } else {
+                        toXmm(0, a.op);
+                        as_.cvttsd2si(dst, Operand::reg(0));
+                    }
+                    push(Entry::Reg, dst);
+                    break;
+                }
+                
+                case Opcode::fadd:
+                case Opcode::fsub:
+                case Opcode::fmul:
+                case Opcode::fdiv:
+                    floatOp(inst.code);
+                    break;
+                
+                case Opcode::test_flt:
+                case Opcode::test_flteq:
+                case Opcode::test_fgt:
+                case Opcode::test_fgteq:
+                case Opcode::test_feq:
+                case Opcode::test_ilt:
+                case Opcode::test_ilteq:
+                case Opcode::test_igt:
+                case Opcode::test_igteq:
+                case Opcode::test_ieq:
+                    compareOp(inst.code, false, 0);
+                    break;
+                
+                case Opcode::jilt:
+                case Opcode::jilteq:
+                case Opcode::jigt:
+                case Opcode::jigteq:
+                case Opcode::jieq:
+                case Opcode::jine:
+                case Opcode::jflt:
+                case Opcode::jflteq:
+                case Opcode::jfgt:
+                case Opcode::jfgteq:
+                case Opcode::jfeq:
+                case Opcode::jfne:
+                    compareOp(inst.code, true, inst.target);
+                    break;
+                
+                case Opcode::test_ilt_li:
+                case Opcode::test_ilteq_li:
+                case Opcode::test_igt_li:
+                case Opcode::test_igteq_li:
+                case Opcode::test_ieq_li:
+                {
+                    static const Condition conditions[] = {L, LE, G, GE, E};
+                    auto dst = allocate(0);
+                    compare(local(inst.slot), Operand::imm(inst.imm));
+                    setFlag(conditions[inst.code - Opcode::test_ilt_li], dst);
+                    push(Entry::Reg, dst);
+                    break;
+                }
+                
+                case Opcode::jilt_li:
+                case Opcode::jilteq_li:
+                case Opcode::jigt_li:
+                case Opcode::jigteq_li:
+                case Opcode::jieq_li:
+                case Opcode::jine_li:
+                {
+                    static const Condition conditions[] = {L, LE, G, GE, E, NE};
+                    flush();
+                    compare(local(inst.slot), Operand::imm(inst.imm));
+                    branch(conditions[inst.code - Opcode::jilt_li], inst.target);
+                    break;
+                }
+                
+                case Opcode::jmp:
+                case Opcode::rjmp:
+                    flush();
+                    jump(inst.target);
+                    break;
+                
+                case Opcode::jnz:
+                case Opcode::rjnz:
+                case Opcode::jz:
+                case Opcode::rjz:
+                {
+                    auto condition = pop(busy);
+                    bool onTrue = inst.code == Opcode::jnz || inst.code == Opcode::rjnz;
+                    flush();
+                    if(condition.op.kind == Operand::Imm) {
+                        if((condition.op.value != 0) == onTrue) jump(inst.target);
+                        break;
+                    }
+                    testZero(condition.op);
+                    branch(onTrue ? NE : E, inst.target);
+                    break;
+                }
+                
+                case Opcode::loop_enter:
+                {
+                    auto count = pop(busy);
+                    if(count.entry.kind != Entry::Local || count.entry.value != inst.slot) {
+                        materialize(inst.slot, busy);
+                        storeLocal(inst.slot, count.op);
+                    }
+                    flush();
+                    testZero(local(inst.slot));
+                    branch(LE, inst.target);
+                    break;
+                }
+                
+                case Opcode::loop_next:
+                    materialize(inst.slot, 0);
+                    flush();
+                    as_.aluImm(Sub, local(inst.slot), 1);
+                    testZero(local(inst.slot));
+                    branch(G, inst.target);
+                    break;
+                
+                case Opcode::ret:
+                    as_.alu(Xor, rax, Operand::reg(rax));
+                    as_.alu(Xor, rdx, Operand::reg(rdx));
+                    epilogue();
+                    live_ = false;
+                    break;
+                
+                case Opcode::ret_v:
+                {
+                    auto value = pop(busy);
+                    as_.mov(rax, value.op);
+                    as_.alu(Xor, rdx, Operand::reg(rdx));
+                    epilogue();
+                    live_ = false;
+                    break;
+                }
+                
+                default:
+                    break;
+            }
+        }
+    }
+#endif
+    
+    std::uint32_t JIT::compile(Program& program) {
+#if TINYSCRIPT_HAS_JIT
+        if(program.encoding != Program::Encoding::Stack) return 0;
+        auto count = program.functions.size();
+        std::vector<Analysis> analyses(count);
+        std::vector<bool> compiled(count, false);
+        for(std::uint64_t i = 0; i < count; ++i) {
+            compiled[i] = analyze(program, program.functions[i], analyses[i]);
+        }
+        
+        // Native code only calls native code, so functions calling into the interpreter stay there.
+        for(bool changed = true; changed;) {
+            changed = false;
+            for(std::uint64_t i = 0; i < count; ++i) {
+                if(!compiled[i]) continue;
+                for(auto callee: analyses[i].callees) {
+                    if(compiled[callee]) continue;
+                    compiled[i] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        
+        Assembler as;
+        std::vector<std::uint64_t> starts(count, 0);
+        std::vector<Fixup> calls;
+        std::uint32_t total = 0;
+        for(std::uint64_t i = 0; i < count; ++i) {
+            if(!compiled[i]) continue;
+            as.align(16);
+            starts[i] = as.size();
+            FunctionCompiler(program, program.functions[i], analyses[i], as).compile(calls);
+            total += 1;
+        }
+        if(!total) return 0;
+        for(const auto& call: calls) as.patch(call.at, starts[call.target]);
+        
+        auto size = as.size();
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED) return 0;
+        std::memcpy(memory, as.code().data(), size);
+        if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return 0;
+        }
+        
+        program.nativeCode = std::shared_ptr<const void>(memory, [size](const void* code) {
+            munmap(const_cast<void*>(code), size);
+        });
+        program.native.assign(count, nullptr);
+        program.bounded.assign(count, nullptr);
+        for(std::uint64_t i = 0; i < count; ++i) {
+            if(!compiled[i]) continue;
+            program.native[i] = reinterpret_cast<Entry>(static_cast<std::uint8_t*>(memory) + starts[i]);
+            if(!analyses[i].loops && analyses[i].callees.empty()) program.bounded[i] = program.native[i];
+        }
+        return total;
+#else
+        (void)program;
+        return 0;
+#endif
+    }
+}
@@ -6,6 +6,8 @@
 //  Copyright © 2018 Amy Parent. All rights reserved.
 //
 #include <cstdlib>
+#include <mutex>
+#include <random>
 #include <string>
 #include <tinyscript/runtime/library.hpp>
 
@@ -14,6 +16,60 @@
 
 namespace tinyscript {
     
+    namespace {
+        double getTime() {
+            return static_cast<double>(time(nullptr));
+        }
+        
+        std::string getLine() {
+            std::string line;
+            std::getline(std::cin, line);
+            return line;
+        }
+        
+        std::string getLinePrompt(const std::string& prompt) {
+            std::cout << prompt;
+            return getLine();
+        }
+        
+        // Tasks on a ThreadPool call these from several threads at once, so each task draws from
+        // its own generator, and Random.seed() only seeds the calling task's. The host calling these
+        // outside of a task gets a generator for its thread.
+        std::minstd_rand& generator() {
+            if(auto* task = Task::running()) return task->random();
+            thread_local std::minstd_rand generator;
+            return generator;
+        }
+        
+        // Serialises IO.print, so that lines printed by different threads don't interleave.
+        std::mutex output;
+        
+        double randomFloat(double m) {
+            auto& gen = generator();
+            return m * static_cast<double>(gen() - gen.min()) / static_cast<double>(gen.max() - gen.min());
+        }
+        
+        double randomFloatRange(double low, double high) {
+            return low + randomFloat(high - low);
+        }
+        
+        std::int64_t randomInteger(std::int64_t m) {
+            return static_cast<std::uint64_t>(generator()()) % m;
+        }
+        
+        std::int64_t randomIntegerRange(std::int64_t low, std::int64_t high) {
+            return low + randomInteger(high - low);
+        }
+        
+        void randomSeed(std::int64_t seed) {
+            generator().seed(static_cast<std::minstd_rand::result_type>(seed));
+        }
+        
+        std::string slice(const std::string& str, std::int64_t begin, std::int64_t length) {
+            return str.substr(begin, length);
+        }
+    }
+    
     StdLib::StdLib()
     : random_("Random")
     , system_("System")
@@ -21,80 +77,37 @@ namespace tinyscript {
     , string_("String")
     , reflection_("Reflection") {
         system_.addFunction("getOS", 0, Type::String, [](VM& vm, Task& co) {
-            co.push(Value(std::string("macOS")));
+            co.push(vm.strings().intern("macOS"));
         });
         
-        system_.addFunction("getTime", 0, Type::Number, [](VM& vm, Task& co) {
-            co.push(Value::Integer(time(nullptr)));
-        });
+        system_.bind<&getTime>("getTime");
         
         io_.addFunction("print", 1, Type::Void, [](VM& vm, Task& co) {
-            const auto& v = co.pop();
-            std::cout << v.repr() << std::endl;
+            auto line = co.pop().repr();
+            std::lock_guard<std::mutex> lock(output);
+            std::cout << line << std::endl;
         });
         
         io_.addFunction("toString", 1, Type::String, [](VM& vm, Task& co) {
             co.push(Value(co.pop().repr()));
         });
         
-        io_.addFunction("getLine", 0, Type::String, [](VM& vm, Task& co) {
-            std::string line;
-            std::getline(std::cin, line);
-            co.push(Value(line));
-        });
-        
-        io_.addFunction("getLine", 1, Type::String, [](VM& vm, Task& co) {
-            const auto& prompt = co.pop().asString();
-            std::cout << prompt;
-            std::string line;
-            std::getline(std::cin, line);
-            co.push(Value(line));
-        });
-        
-        random_.addFunction("float", 2, Type::Number, [](VM& vm, Task& co) {
-            auto high = co.pop().asNumber();
-            auto low = co.pop().asNumber();
-            
-            double m = high-low;
-            double r = low + (m * static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX));
-            co.push(Value::Float(r));
-        });
+        io_.bind<&getLine>("getLine");
+        io_.bind<&getLinePrompt>("getLine");
         
-        random_.addFunction("float", 1, Type::Number, [](VM& vm, Task& co) {
-            auto m = co.pop().asNumber();
-            double r = m * static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
-            co.push(Value::Float(r));
-        });
-        
-        random_.addFunction("integer", 2, Type::Integer, [](VM& vm, Task& co) {
-            auto high = co.pop().asInt();
-            auto low = co.pop().asInt();
-            
-            std::int64_t m = high-low;
-            co.push(Value::Integer(low + (static_cast<std::uint64_t>(std::rand()) % m)));
-        });
-        
-        random_.addFunction("integer", 1, Type::Integer, [](VM& vm, Task& co) {
-            auto m = co.pop().asInt();
-            co.push(Value::Integer(static_cast<std::uint64_t>(std::rand()) % m));
-        });
-        
-        random_.addFunction("seed", 1, Type::Void, [](VM& vm, Task& co) {
-            std::srand(static_cast<unsigned int>(co.pop().asInt()));
-        });
+        random_.bind<&randomFloatRange>("float");
+        random_.bind<&randomFloat>("float");
+        random_.bind<&randomIntegerRange>("integer");
+        random_.bind<&randomInteger>("integer");
+        random_.bind<&randomSeed>("seed");
         
         string_.addFunction("equal", 2, Type::Bool, [](VM& vm, Task& co) {
-            const auto& b = co.pop().asString();
-            const auto& a = co.pop().asString();
+            const auto& b = co.pop();
+            const auto& a = co.pop();
             co.push(Value::boolean(a == b));
         });
         
-        string_.addFunction("slice", 3, Type::String, [](VM& vm, Task& co) {
-            const auto& length = co.pop().asInt();
-            const auto& begin = co.pop().asInt();
-            const auto& str = co.pop().asString();
-            co.push(Value(str.substr(begin, length)));
-        });
+        string_.bind<&slice>("slice");
         
         reflection_.addFunction("mangle", 1, Type::String, [](VM& vm, Task& co) {
             const auto& signature = co.pop().asString();
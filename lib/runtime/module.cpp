@@ -15,6 +15,13 @@ namespace tinyscript {
         functions_[name] = VM::Function{name, arity, returnType, func};
     }
     
+    void Module::addFunction(const std::string& symbol, Type returnType, const std::vector<Type>& params, VM::Native func) {
+        auto arity = static_cast<std::uint8_t>(params.size());
+        auto name = VM::mangleFunc(name_, symbol, arity);
+        assert(functions_.find(name) == functions_.end() && "function is already decalred");
+        functions_[name] = VM::Function{name, arity, returnType, nullptr, func, params};
+    }
+    
     void Module::addVariable(const std::string& symbol, const Value& value) {
         auto name = VM::mangleVar(name_, symbol);
         assert(variables_.find(name) == variables_.end() && "function is already decalred");
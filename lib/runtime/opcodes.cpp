@@ -20,6 +20,16 @@ namespace tinyscript {
     };
 #undef OPCODE
     
+    struct RegOpcodeData {
+        std::string mnemonic;
+        int operandSize;
+    };
+#define REGOP(name, opsize) {#name, opsize},
+    static const RegOpcodeData regOpcodeData[] = {
+#include <tinyscript/x-regops.hpp>
+    };
+#undef REGOP
+    
     std::string mnemonic(Opcode code) {
         return opcodeData[code].mnemonic;
     }
@@ -31,9 +41,50 @@ namespace tinyscript {
     int operandSize(Opcode code) {
         return opcodeData[code].operandSize;
     }
+    
+    // Branches taken on the opposite condition. Ordered float comparisons have none, since they
+    // are all false when either side is NaN.
+    Opcode invertedBranch(Opcode code) {
+        switch(code) {
+            case Opcode::jnz:       return Opcode::jz;
+            case Opcode::jz:        return Opcode::jnz;
+            case Opcode::rjnz:      return Opcode::rjz;
+            case Opcode::rjz:       return Opcode::rjnz;
+            case Opcode::jilt:      return Opcode::jigteq;
+            case Opcode::jilteq:    return Opcode::jigt;
+            case Opcode::jigt:      return Opcode::jilteq;
+            case Opcode::jigteq:    return Opcode::jilt;
+            case Opcode::jieq:      return Opcode::jine;
+            case Opcode::jine:      return Opcode::jieq;
+            case Opcode::jfeq:      return Opcode::jfne;
+            case Opcode::jfne:      return Opcode::jfeq;
+            case Opcode::jseq:      return Opcode::jsne;
+            case Opcode::jsne:      return Opcode::jseq;
+            case Opcode::jilt_li:   return Opcode::jigteq_li;
+            case Opcode::jilteq_li: return Opcode::jigt_li;
+            case Opcode::jigt_li:   return Opcode::jilteq_li;
+            case Opcode::jigteq_li: return Opcode::jilt_li;
+            case Opcode::jieq_li:   return Opcode::jine_li;
+            case Opcode::jine_li:   return Opcode::jieq_li;
+            default:                return Opcode::nop;
+        }
+    }
+    
+    std::string mnemonic(RegOpcode code) {
+        return regOpcodeData[static_cast<int>(code)].mnemonic;
+    }
+    
+    int operandSize(RegOpcode code) {
+        return regOpcodeData[static_cast<int>(code)].operandSize;
+    }
 }
 
 std::ostream& operator<<(std::ostream& out, tinyscript::Opcode code) {
     out << mnemonic(code);
     return out;
 }
+
+std::ostream& operator<<(std::ostream& out, tinyscript::RegOpcode code) {
+    out << mnemonic(code);
+    return out;
+}
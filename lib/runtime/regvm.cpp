@@ -0,0 +1,355 @@
+//
+//  regvm.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cstdint>
+#include <string>
+#include <tinyscript/runtime/vm.hpp>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/task.hpp>
+
+namespace tinyscript {
+
+#if TINYSCRIPT_COUNT_DISPATCH
+#define VM_FETCH()          (dispatched_.fetch_add(1, std::memory_order_relaxed), static_cast<RegOpcode>(*ip++))
+#else
+#define VM_FETCH()          static_cast<RegOpcode>(*ip++)
+#endif
+
+#define READ8()             (*ip++)
+#define READ16()            (ip += 2, static_cast<std::uint16_t>((ip[-2] << 8) | ip[-1]))
+#define R(idx)              (base[(idx)])
+#define CONSTANT(idx)       (co.program_.constants[(idx)])
+#define LOAD_STATE()        (ip = co.ip_, base = co.fp_[-1].base)
+#define VM_CHECKPOINT() \
+    if(budget-- == 0 && (budget = co.extension()) == 0) { \
+        co.ip_ = ip; \
+        return std::make_pair(Result::Preempted, Value()); \
+    }
+
+#if defined(__GNUC__) && !defined(TINYSCRIPT_NO_COMPUTED_GOTO)
+#define TINYSCRIPT_COMPUTED_GOTO 1
+#define VM_LOOP()           VM_DISPATCH();
+#define VM_CASE(name)       op_##name
+#define VM_DISPATCH()       goto *dispatchTable[static_cast<int>(VM_FETCH())]
+#else
+#define TINYSCRIPT_COMPUTED_GOTO 0
+#define VM_LOOP()           for(;;) switch(VM_FETCH())
+#define VM_CASE(name)       case RegOpcode::name
+#define VM_DISPATCH()       continue
+#endif
+
+#define VM_BINARY(name, type, expr) \
+    VM_CASE(name): \
+    { \
+        auto dst = READ8(); \
+        auto a = R(READ8()).type(); \
+        auto b = R(READ8()).type(); \
+        R(dst) = (expr); \
+    } \
+        VM_DISPATCH();
+
+#define VM_BRANCH(name, type, cond) \
+    VM_CASE(name): \
+    { \
+        auto a = R(READ8()).type(); \
+        auto b = R(READ8()).type(); \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH();
+
+#define VM_BRANCH_I(name, cond) \
+    VM_CASE(name): \
+    { \
+        std::int64_t a = R(READ8()).asInt(); \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH();
+    
+    // Frames are pushed and popped like in run(): a call points the task's stack pointer past the
+    // arguments, which the caller placed in consecutive registers, so that they become the
+    // callee's first locals, and the result is returned in the first of them.
+    std::pair<VM::Result, Value> VM::runRegisters(Task& co) {
+#if TINYSCRIPT_COMPUTED_GOTO
+#define REGOP(name, _) &&VM_CASE(name),
+        static const void* dispatchTable[] = {
+#include <tinyscript/x-regops.hpp>
+        };
+#undef REGOP
+#endif
+        const Function* const* foreign = co.program_.foreign.data();
+        const Program::Function* functions = co.program_.functions.data();
+        const std::uint8_t* ip;
+        Value* base;
+        std::uint64_t budget = co.budget_;
+        LOAD_STATE();
+        
+        VM_LOOP() {
+            VM_CASE(halt):
+                co.ip_ = ip;
+                return std::make_pair(Result::Done, Value());
+            
+            VM_CASE(move):
+            {
+                auto dst = READ8();
+                R(dst) = R(READ8());
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(loadk):
+            {
+                auto dst = READ8();
+                R(dst) = CONSTANT(READ8());
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(loadi):
+            {
+                auto dst = READ8();
+                R(dst) = Value::Integer(static_cast<std::int16_t>(READ16()));
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(loadyes):
+                R(READ8()) = Value::boolean(true);
+                VM_DISPATCH();
+            
+            VM_CASE(loadno):
+                R(READ8()) = Value::boolean(false);
+                VM_DISPATCH();
+            
+            VM_CASE(fneg):
+            {
+                auto dst = READ8();
+                R(dst) = Value::Float(-R(READ8()).asNumber());
+            }
+                VM_DISPATCH();
+            
+            VM_BINARY(fadd, asNumber, Value::Float(a + b))
+            VM_BINARY(fsub, asNumber, Value::Float(a - b))
+            VM_BINARY(fmul, asNumber, Value::Float(a * b))
+            VM_BINARY(fdiv, asNumber, Value::Float(a / b))
+            
+            VM_CASE(ineg):
+            {
+                auto dst = READ8();
+                R(dst) = Value::Integer(-R(READ8()).asInt());
+            }
+                VM_DISPATCH();
+            
+            VM_BINARY(iadd, asInt, Value::Integer(a + b))
+            VM_BINARY(isub, asInt, Value::Integer(a - b))
+            VM_BINARY(imul, asInt, Value::Integer(a * b))
+            VM_BINARY(idiv, asInt, Value::Integer(a / b))
+            
+            VM_CASE(iaddi):
+            {
+                auto dst = READ8();
+                std::int64_t a = R(READ8()).asInt();
+                R(dst) = Value::Integer(a + static_cast<std::int16_t>(READ16()));
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(isubi):
+            {
+                auto dst = READ8();
+                std::int64_t a = R(READ8()).asInt();
+                R(dst) = Value::Integer(a - static_cast<std::int16_t>(READ16()));
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(i2f):
+            {
+                auto dst = READ8();
+                R(dst) = Value::Float(static_cast<double>(R(READ8()).asInt()));
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(f2i):
+            {
+                auto dst = READ8();
+                R(dst) = Value::Integer(static_cast<std::int64_t>(R(READ8()).asNumber()));
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(sadd):
+            {
+                auto dst = READ8();
+                const auto& a = R(READ8()).asString();
+                const auto& b = R(READ8()).asString();
+                R(dst) = Value(a + b);
+            }
+                VM_DISPATCH();
+            
+            VM_BINARY(land, asBool, Value::boolean(a && b))
+            VM_BINARY(lor, asBool, Value::boolean(a || b))
+            VM_BINARY(flt, asNumber, Value::boolean(a < b))
+            VM_BINARY(flteq, asNumber, Value::boolean(a <= b))
+            VM_BINARY(fgt, asNumber, Value::boolean(a > b))
+            VM_BINARY(fgteq, asNumber, Value::boolean(a >= b))
+            VM_BINARY(feq, asNumber, Value::boolean(a == b))
+            VM_BINARY(ilt, asInt, Value::boolean(a < b))
+            VM_BINARY(ilteq, asInt, Value::boolean(a <= b))
+            VM_BINARY(igt, asInt, Value::boolean(a > b))
+            VM_BINARY(igteq, asInt, Value::boolean(a >= b))
+            VM_BINARY(ieq, asInt, Value::boolean(a == b))
+            VM_BINARY(seq, stringObject, Value::boolean(StringObject::equal(a, b)))
+            
+            VM_CASE(jmp):
+            {
+                auto offset = static_cast<std::int16_t>(READ16());
+                ip += offset;
+                if(offset < 0) VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(jt):
+            {
+                bool a = R(READ8()).asBool();
+                auto offset = static_cast<std::int16_t>(READ16());
+                if(a) { ip += offset; if(offset < 0) VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(jf):
+            {
+                bool a = R(READ8()).asBool();
+                auto offset = static_cast<std::int16_t>(READ16());
+                if(!a) { ip += offset; if(offset < 0) VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_BRANCH(jilt, asInt, a < b)
+            VM_BRANCH(jilteq, asInt, a <= b)
+            VM_BRANCH(jigt, asInt, a > b)
+            VM_BRANCH(jigteq, asInt, a >= b)
+            VM_BRANCH(jieq, asInt, a == b)
+            VM_BRANCH(jine, asInt, a != b)
+            VM_BRANCH(jflt, asNumber, a < b)
+            VM_BRANCH(jflteq, asNumber, a <= b)
+            VM_BRANCH(jfgt, asNumber, a > b)
+            VM_BRANCH(jfgteq, asNumber, a >= b)
+            VM_BRANCH(jfeq, asNumber, a == b)
+            VM_BRANCH(jfne, asNumber, a != b)
+            VM_BRANCH(jseq, stringObject, StringObject::equal(a, b))
+            VM_BRANCH(jsne, stringObject, !StringObject::equal(a, b))
+            
+            VM_BRANCH_I(jilti, a < b)
+            VM_BRANCH_I(jilteqi, a <= b)
+            VM_BRANCH_I(jigti, a > b)
+            VM_BRANCH_I(jigteqi, a >= b)
+            VM_BRANCH_I(jieqi, a == b)
+            VM_BRANCH_I(jinei, a != b)
+            
+            VM_CASE(loopenter):
+            {
+                auto slot = READ8();
+                std::int64_t count = R(READ8()).asInt();
+                auto offset = static_cast<std::int16_t>(READ16());
+                R(slot) = Value::Integer(count);
+                if(count <= 0) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(loopnext):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = R(slot).asInt() - 1;
+                R(slot) = Value::Integer(count);
+                if(count > 0) { ip += offset; if(offset < 0) VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(retain):
+                R(READ8()).retain();
+                VM_DISPATCH();
+            
+            VM_CASE(release):
+                R(READ8()).release();
+                VM_DISPATCH();
+            
+            VM_CASE(call):
+            {
+                Value* args = base + READ8();
+                const auto& func = functions[READ16()];
+                co.ip_ = ip;
+                co.sp_ = args + func.arity;
+                if(!co.pushFrame(func))
+                    return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                LOAD_STATE();
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(tailcall):
+            {
+                Value* args = base + READ8();
+                const auto& func = functions[READ16()];
+                co.ip_ = ip;
+                co.sp_ = args + func.arity;
+                if(!co.tailFrame(func))
+                    return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                LOAD_STATE();
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(callf):
+            {
+                Value* args = base + READ8();
+                const auto* func = foreign[READ8()];
+                if(func->native) {
+                    func->native(*this, args);
+                } else {
+                    co.ip_ = ip;
+                    co.sp_ = args + func->arity;
+                    func->code(*this, co);
+                }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(yield):
+                co.ip_ = ip;
+                return std::make_pair(Result::Continue, Value());
+            
+            VM_CASE(yieldv):
+            {
+                const auto& value = R(READ8());
+                co.ip_ = ip;
+                return std::make_pair(Result::Continue, value);
+            }
+            
+            VM_CASE(ret):
+                co.ip_ = ip;
+                if(co.popFrame())
+                    return std::make_pair(Result::Done, Value());
+                LOAD_STATE();
+                VM_DISPATCH();
+            
+            VM_CASE(retv):
+                co.sp_ = base + READ8() + 1;
+                co.ip_ = ip;
+                if(co.returnFrame())
+                    return std::make_pair(Result::Done, co.pop());
+                LOAD_STATE();
+                VM_DISPATCH();
+            
+            VM_CASE(fail):
+            {
+                const auto& message = CONSTANT(READ8());
+                co.ip_ = ip;
+                return std::make_pair(Result::Error, message);
+            }
+        }
+        return std::make_pair(Result::Done, Value());
+    }
+}
@@ -0,0 +1,49 @@
+//
+//  scheduler.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <tinyscript/runtime/scheduler.hpp>
+
+namespace tinyscript {
+    
+    Task& Scheduler::spawn(const Program& program, std::uint32_t stackSize, std::uint32_t frameCount) {
+        return spawn(std::make_unique<Task>(program, stackSize, frameCount));
+    }
+    
+    Task& Scheduler::spawn(std::unique_ptr<Task> task) {
+        ready_.push_back(std::move(task));
+        return *ready_.back();
+    }
+    
+    std::size_t Scheduler::tick() {
+        return tick(ready_.size());
+    }
+    
+    std::size_t Scheduler::tick(std::size_t count) {
+        if(count > ready_.size()) count = ready_.size();
+        
+        for(std::size_t i = 0; i < count; ++i) {
+            auto task = std::move(ready_.front());
+            ready_.pop_front();
+            
+            auto result = budget_ ? vm_.run(*task, budget_) : vm_.run(*task);
+            if(result.first == VM::Result::Preempted) {
+                ready_.push_back(std::move(task));
+            } else if(result.first == VM::Result::Continue) {
+                if(onYield_) onYield_(*task, result.second);
+                ready_.push_back(std::move(task));
+            } else if(onExit_) {
+                onExit_(*task, result.first, result.second);
+            }
+        }
+        resumes_ += count;
+        return count;
+    }
+    
+    void Scheduler::run() {
+        while(!ready_.empty()) tick();
+    }
+}
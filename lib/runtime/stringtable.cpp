@@ -0,0 +1,40 @@
+//
+//  stringtable.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cassert>
+#include <tinyscript/runtime/stringtable.hpp>
+
+namespace tinyscript {
+    
+    StringTable::~StringTable() {
+        // The table holds the only reference left to each of its strings, unless a program, task or
+        // value outlived the VM (see StringObject).
+        for(auto& pair: strings_) {
+            assert(pair.second->references_ == 1 && "interned string outlives its VM");
+            delete pair.second;
+        }
+    }
+    
+    Value StringTable::intern(const std::string& str) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = strings_.find(str);
+        if(it == strings_.end()) {
+            auto* object = StringObject::create(str);
+            object->table_ = this;
+#ifndef NDEBUG
+            object->references_ = 1;
+#endif
+            it = strings_.emplace(object->str(), object).first;
+        }
+        return Value(it->second);
+    }
+    
+    std::size_t StringTable::size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return strings_.size();
+    }
+}
@@ -5,6 +5,7 @@
 //  Created by Amy Parent on 03/07/2018.
 //  Copyright © 2018 Amy Parent. All rights reserved.
 //
+#include <atomic>
 #include <cassert>
 #include <tinyscript/runtime/task.hpp>
 
@@ -12,56 +13,70 @@
 
 namespace tinyscript {
     
-    Task::Task(const Program& program, std::uint32_t stackSize)
+    thread_local Task* Task::running_ = nullptr;
+    
+    // Consecutive seeds would start minstd_rand's sequences off in lockstep, so the count is mixed
+    // first (SplitMix64's finalizer).
+    std::uint32_t Task::nextSeed() {
+        static std::atomic<std::uint64_t> count{0};
+        std::uint64_t z = (count.fetch_add(1, std::memory_order_relaxed) + 1) * 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return static_cast<std::uint32_t>(z ^ (z >> 31));
+    }
+    
+    Task::Task(const Program& program, std::uint32_t stackSize, std::uint32_t frameCount)
     : program_(program)
-    , stackSize_(stackSize) {
+    , stackSize_(stackSize)
+    , frameCount_(frameCount)
+    , random_(nextSeed()) {
         
         stack_ = new Value[stackSize];
         sp_ = stack_;
-        pushFrame(program_.script);
+        frames_ = fp_ = new Frame[frameCount_];
+        if(program_.encoding == Program::Encoding::Typed) {
+            slots_ = ssp_ = new Slot[stackSize];
+            pushTypedFrame(program_.script);
+        } else {
+            pushFrame(program_.script);
+        }
     }
 
     Task::Task(const Program& program, Task* caller, const std::string& function)
     : program_(program)
     , stackSize_(caller->stackSize_)
-    , caller_(caller) {
+    , frameCount_(caller->frameCount_)
+    , caller_(caller)
+    , random_(nextSeed()) {
         stack_ = new Value[stackSize_];
         sp_ = stack_;
+        frames_ = fp_ = new Frame[frameCount_];
+        if(program_.encoding == Program::Encoding::Typed) slots_ = ssp_ = new Slot[stackSize_];
         pushFrame(function);
     }
     
-    Task::~Task() {}
-    
-    void Task::pushFrame(const Program::Function& func) {
-        auto callerIP = ip_;
-        auto* base = sp_ - func.arity;
-        auto* stack = base + func.variableCount;
-        ip_ = 0;
-        sp_ = stack;
-        callStack_.push_back(Frame{func, callerIP, base, stack});
-    }
-    
-    void Task::pushFrame(const std::string& name) {
-        const auto& it = program_.functions.find(name);
-        assert(it != program_.functions.end() && "Invalid symbolic reference");
-        pushFrame(it->second);
+    // Strings left on the operand stack of a typed task that didn't finish can't be told apart
+    // from other slots, only the ones in locals are released.
+    Task::~Task() {
+        if(slots_) {
+            for(auto* frame = frames_; frame < fp_; ++frame) {
+                releaseStrings(*frame);
+            }
+        }
+        delete [] slots_;
+        delete [] frames_;
+        delete [] stack_;
     }
     
-    bool Task::popFrame() {
-        assert(callStack_.size() > 0 && "Call stack underflow");
-        ip_ = callStack_.back().callerIP;
-        sp_ = callStack_.back().base;
-        callStack_.pop_back();
-        return callStack_.empty();
+    std::uint64_t Task::extension() const {
+        if(!timed_ || std::chrono::steady_clock::now() >= deadline_) return 0;
+        return clockInterval;
     }
     
-    bool Task::returnFrame() {
-        assert(callStack_.size() > 0 && "Call stack underflow");
-        Value ret = pop();
-        ip_ = callStack_.back().callerIP;
-        sp_ = callStack_.back().base;
-        callStack_.pop_back();
-        push(ret);
-        return callStack_.empty();
+    bool Task::pushFrame(const std::string& name) {
+        const auto& it = program_.symbols.find(name);
+        assert(it != program_.symbols.end() && "Invalid symbolic reference");
+        const auto& func = program_.functions[it->second];
+        return slots_ ? pushTypedFrame(func) : pushFrame(func);
     }
 }
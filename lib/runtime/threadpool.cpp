@@ -0,0 +1,138 @@
+//
+//  threadpool.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <tinyscript/runtime/threadpool.hpp>
+
+namespace tinyscript {
+    
+    ThreadPool::ThreadPool(VM& vm, unsigned threads) : vm_(vm) {
+        if(threads == 0) threads = 1;
+        for(unsigned i = 0; i < threads; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+            workers_.back()->index = i;
+        }
+        for(auto& worker: workers_) {
+            worker->thread = std::thread(&ThreadPool::work, this, std::ref(*worker));
+        }
+    }
+    
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for(auto& worker: workers_) {
+            worker->thread.join();
+        }
+    }
+    
+    void ThreadPool::spawn(const Program& program, std::uint32_t stackSize, std::uint32_t frameCount) {
+        spawn(std::make_unique<Task>(program, stackSize, frameCount));
+    }
+    
+    void ThreadPool::spawn(std::unique_ptr<Task> task) {
+        live_.fetch_add(1);
+        auto index = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        push(*workers_[index], std::move(task));
+        wakeOne();
+    }
+    
+    void ThreadPool::wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return live_.load() == 0; });
+    }
+    
+    std::uint64_t ThreadPool::resumes() const {
+        std::uint64_t total = 0;
+        for(const auto& worker: workers_) total += worker->resumes.load(std::memory_order_relaxed);
+        return total;
+    }
+    
+    std::uint64_t ThreadPool::steals() const {
+        std::uint64_t total = 0;
+        for(const auto& worker: workers_) total += worker->steals.load(std::memory_order_relaxed);
+        return total;
+    }
+    
+    std::size_t ThreadPool::push(Worker& worker, std::unique_ptr<Task> task) {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.ready.push_back(std::move(task));
+        worker.size = worker.ready.size();
+        return worker.ready.size();
+    }
+    
+    bool ThreadPool::queued() const {
+        for(const auto& worker: workers_) {
+            if(worker->size.load() != 0) return true;
+        }
+        return false;
+    }
+    
+    // The size of the deque is stored before [sleeping_] is read, and a worker going to sleep
+    // increments [sleeping_] before checking the sizes: one of them sees the other.
+    void ThreadPool::wakeOne() {
+        if(sleeping_.load() == 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+    
+    std::unique_ptr<Task> ThreadPool::take(Worker& self) {
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            if(!self.ready.empty()) {
+                auto task = std::move(self.ready.front());
+                self.ready.pop_front();
+                self.size = self.ready.size();
+                return task;
+            }
+        }
+        
+        // Victims are tried starting with the next worker, so that thieves spread out.
+        auto count = workers_.size();
+        for(std::size_t i = 1; i < count; ++i) {
+            auto& victim = *workers_[(self.index + i) % count];
+            if(victim.size.load(std::memory_order_relaxed) == 0) continue;
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(victim.ready.empty()) continue;
+            auto task = std::move(victim.ready.back());
+            victim.ready.pop_back();
+            victim.size = victim.ready.size();
+            self.steals.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+        return nullptr;
+    }
+    
+    void ThreadPool::work(Worker& self) {
+        while(!stopping_.load(std::memory_order_relaxed)) {
+            auto task = take(self);
+            if(!task) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ++sleeping_;
+                wake_.wait(lock, [this] { return stopping_.load() || queued(); });
+                --sleeping_;
+                continue;
+            }
+            
+            auto result = budget_ ? vm_.run(*task, budget_) : vm_.run(*task);
+            self.resumes.fetch_add(1, std::memory_order_relaxed);
+            if(result.first == VM::Result::Continue || result.first == VM::Result::Preempted) {
+                if(result.first == VM::Result::Continue && onYield_) onYield_(*task, result.second);
+                if(push(self, std::move(task)) > 1) wakeOne();
+                continue;
+            }
+            
+            if(onExit_) onExit_(*task, result.first, result.second);
+            task.reset();
+            if(live_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,455 @@
+//
+//  typedvm.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <cstdint>
+#include <string>
+#include <tinyscript/runtime/vm.hpp>
+
+#include <tinyscript/opcodes.hpp>
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/task.hpp>
+
+namespace tinyscript {
+
+#if TINYSCRIPT_COUNT_DISPATCH
+#define VM_FETCH()          (dispatched_.fetch_add(1, std::memory_order_relaxed), static_cast<Opcode>(*ip++))
+#else
+#define VM_FETCH()          static_cast<Opcode>(*ip++)
+#endif
+
+#define READ8()             (*ip++)
+#define READ16()            (ip += 2, static_cast<std::uint16_t>((ip[-2] << 8) | ip[-1]))
+#define PUSH()              (assert(sp < co.slots_ + co.stackSize_ && "Coroutine stack overflow"), sp++)
+#define POP()               (*(--sp))
+#define TOP(field)          (sp[-1].field)
+#define CONSTANT(idx)       (co.program_.constants[(idx)])
+#define SAVE_STATE()        (co.ip_ = ip, co.ssp_ = sp)
+#define LOAD_STATE()        (ip = co.ip_, sp = co.ssp_, base = co.fp_[-1].slots)
+#define VM_CHECKPOINT() \
+    if(budget-- == 0 && (budget = co.extension()) == 0) { \
+        SAVE_STATE(); \
+        return std::make_pair(Result::Preempted, Value()); \
+    }
+
+#if defined(__GNUC__) && !defined(TINYSCRIPT_NO_COMPUTED_GOTO)
+#define TINYSCRIPT_COMPUTED_GOTO 1
+#define VM_LOOP()           VM_DISPATCH();
+#define VM_CASE(name)       op_##name
+#define VM_DISPATCH()       goto *dispatchTable[VM_FETCH()]
+#else
+#define TINYSCRIPT_COMPUTED_GOTO 0
+#define VM_LOOP()           for(;;) switch(VM_FETCH())
+#define VM_CASE(name)       case Opcode::name
+#define VM_DISPATCH()       continue
+#endif
+
+#define VM_BINARY(name, field, result, expr) \
+    VM_CASE(name): \
+    { \
+        auto b = POP().field; \
+        auto a = TOP(field); \
+        TOP(result) = (expr); \
+    } \
+        VM_DISPATCH();
+
+#define VM_TEST_LI(name, cond) \
+    VM_CASE(name): \
+    { \
+        std::int64_t a = base[READ8()].intValue; \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        PUSH()->boolValue = (cond); \
+    } \
+        VM_DISPATCH();
+
+#define VM_BRANCH(name, field, cond) \
+    VM_CASE(name): \
+    { \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        auto b = POP().field; \
+        auto a = POP().field; \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH();
+
+#define VM_BRANCH_S(name, cond) \
+    VM_CASE(name): \
+    { \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        auto* b = POP().stringValue; \
+        auto* a = POP().stringValue; \
+        bool taken = (cond); \
+        a->release(); \
+        b->release(); \
+        if(taken) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH();
+
+#define VM_BRANCH_LI(name, cond) \
+    VM_CASE(name): \
+    { \
+        std::int64_t a = base[READ8()].intValue; \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH();
+    
+    // Slots are read and written through the field of their static type, with no tag to check or
+    // set. Strings on the stack each own a reference, which instructions consuming them release;
+    // the compiler inserts the retains for copies and the releases for values nothing consumes.
+    // Arguments of foreign calls are boxed into Values on the task's stack.
+    std::pair<VM::Result, Value> VM::runTyped(Task& co) {
+#if TINYSCRIPT_COMPUTED_GOTO
+#define OPCODE(name, _, __) &&VM_CASE(name),
+        static const void* dispatchTable[] = {
+#include <tinyscript/x-opcodes.hpp>
+        };
+#undef OPCODE
+#endif
+        const Function* const* foreign = co.program_.foreign.data();
+        const std::vector<Type>* importTypes = co.program_.importTypes.data();
+        const Program::Function* functions = co.program_.functions.data();
+        const std::uint8_t* ip;
+        Slot* sp;
+        Slot* base;
+        std::uint64_t budget = co.budget_;
+        LOAD_STATE();
+        
+        VM_LOOP() {
+            VM_CASE(halt):
+                SAVE_STATE();
+                return std::make_pair(Result::Done, Value());
+            
+            VM_CASE(load_c):
+                *PUSH() = CONSTANT(READ8()).unbox();
+                VM_DISPATCH();
+            
+            VM_CASE(load_i):
+                PUSH()->intValue = static_cast<std::int16_t>(READ16());
+                VM_DISPATCH();
+            
+            VM_CASE(load_yes):
+                PUSH()->boolValue = true;
+                VM_DISPATCH();
+            
+            VM_CASE(load_no):
+                PUSH()->boolValue = false;
+                VM_DISPATCH();
+            
+            VM_CASE(load):
+                *PUSH() = base[READ8()];
+                VM_DISPATCH();
+            
+            VM_CASE(store):
+            {
+                auto slot = READ8();
+                base[slot] = POP();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(store_s):
+            {
+                auto slot = READ8();
+                if(auto* string = base[slot].stringValue) string->release();
+                base[slot] = POP();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(dup):
+            {
+                auto top = sp[-1];
+                *PUSH() = top;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(pop):
+                --sp;
+                VM_DISPATCH();
+            
+            VM_CASE(fmin):
+                TOP(floatValue) = -TOP(floatValue);
+                VM_DISPATCH();
+            
+            VM_BINARY(fadd, floatValue, floatValue, a + b)
+            VM_BINARY(fsub, floatValue, floatValue, a - b)
+            VM_BINARY(fmul, floatValue, floatValue, a * b)
+            VM_BINARY(fdiv, floatValue, floatValue, a / b)
+            
+            VM_CASE(imin):
+                TOP(intValue) = -TOP(intValue);
+                VM_DISPATCH();
+            
+            VM_BINARY(iadd, intValue, intValue, a + b)
+            VM_BINARY(isub, intValue, intValue, a - b)
+            VM_BINARY(imul, intValue, intValue, a * b)
+            VM_BINARY(idiv, intValue, intValue, a / b)
+            
+            VM_CASE(iadd_i):
+                TOP(intValue) += static_cast<std::int16_t>(READ16());
+                VM_DISPATCH();
+            
+            VM_CASE(isub_i):
+                TOP(intValue) -= static_cast<std::int16_t>(READ16());
+                VM_DISPATCH();
+            
+            VM_CASE(inc_l):
+            {
+                auto slot = READ8();
+                auto delta = static_cast<std::int8_t>(READ8());
+                base[slot].intValue += delta;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(i2f):
+                TOP(floatValue) = static_cast<double>(TOP(intValue));
+                VM_DISPATCH();
+            
+            VM_CASE(f2i):
+                TOP(intValue) = static_cast<std::int64_t>(TOP(floatValue));
+                VM_DISPATCH();
+            
+            VM_CASE(sadd):
+            {
+                auto* b = POP().stringValue;
+                auto* a = TOP(stringValue);
+                TOP(stringValue) = StringObject::create(a->str() + b->str());
+                a->release();
+                b->release();
+            }
+                VM_DISPATCH();
+            
+            VM_BINARY(log_and, boolValue, boolValue, a && b)
+            VM_BINARY(log_or, boolValue, boolValue, a || b)
+            
+            VM_BINARY(test_flt, floatValue, boolValue, a < b)
+            VM_BINARY(test_flteq, floatValue, boolValue, a <= b)
+            VM_BINARY(test_fgt, floatValue, boolValue, a > b)
+            VM_BINARY(test_fgteq, floatValue, boolValue, a >= b)
+            VM_BINARY(test_feq, floatValue, boolValue, a == b)
+            VM_BINARY(test_ilt, intValue, boolValue, a < b)
+            VM_BINARY(test_ilteq, intValue, boolValue, a <= b)
+            VM_BINARY(test_igt, intValue, boolValue, a > b)
+            VM_BINARY(test_igteq, intValue, boolValue, a >= b)
+            VM_BINARY(test_ieq, intValue, boolValue, a == b)
+            VM_TEST_LI(test_ilt_li, a < b)
+            VM_TEST_LI(test_ilteq_li, a <= b)
+            VM_TEST_LI(test_igt_li, a > b)
+            VM_TEST_LI(test_igteq_li, a >= b)
+            VM_TEST_LI(test_ieq_li, a == b)
+            
+            VM_CASE(test_seq):
+            {
+                auto* b = POP().stringValue;
+                auto* a = TOP(stringValue);
+                TOP(boolValue) = StringObject::equal(a, b);
+                a->release();
+                b->release();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(jmp):
+            {
+                auto offset = READ16();
+                ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(rjmp):
+            {
+                auto offset = READ16();
+                ip -= offset;
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(jnz):
+            {
+                auto offset = READ16();
+                if(POP().boolValue) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(rjnz):
+            {
+                auto offset = READ16();
+                if(POP().boolValue) { ip -= offset; VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(jz):
+            {
+                auto offset = READ16();
+                if(!POP().boolValue) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(rjz):
+            {
+                auto offset = READ16();
+                if(!POP().boolValue) { ip -= offset; VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_BRANCH(jilt, intValue, a < b)
+            VM_BRANCH(jilteq, intValue, a <= b)
+            VM_BRANCH(jigt, intValue, a > b)
+            VM_BRANCH(jigteq, intValue, a >= b)
+            VM_BRANCH(jieq, intValue, a == b)
+            VM_BRANCH(jine, intValue, a != b)
+            VM_BRANCH(jflt, floatValue, a < b)
+            VM_BRANCH(jflteq, floatValue, a <= b)
+            VM_BRANCH(jfgt, floatValue, a > b)
+            VM_BRANCH(jfgteq, floatValue, a >= b)
+            VM_BRANCH(jfeq, floatValue, a == b)
+            VM_BRANCH(jfne, floatValue, a != b)
+            VM_BRANCH_S(jseq, StringObject::equal(a, b))
+            VM_BRANCH_S(jsne, !StringObject::equal(a, b))
+            VM_BRANCH_LI(jilt_li, a < b)
+            VM_BRANCH_LI(jilteq_li, a <= b)
+            VM_BRANCH_LI(jigt_li, a > b)
+            VM_BRANCH_LI(jigteq_li, a >= b)
+            VM_BRANCH_LI(jieq_li, a == b)
+            VM_BRANCH_LI(jine_li, a != b)
+            
+            VM_CASE(loop_enter):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = POP().intValue;
+                base[slot].intValue = count;
+                if(count <= 0) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(loop_next):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = --base[slot].intValue;
+                if(count > 0) { ip += offset; if(offset < 0) VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(retain):
+                if(auto* string = TOP(stringValue)) string->retain();
+                VM_DISPATCH();
+            
+            VM_CASE(release):
+                if(auto* string = TOP(stringValue)) string->release();
+                VM_DISPATCH();
+            
+            VM_CASE(call_n):
+            {
+                const auto& func = functions[READ16()];
+                SAVE_STATE();
+                if(!co.pushTypedFrame(func))
+                    return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                LOAD_STATE();
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(tail_n):
+            {
+                const auto& func = functions[READ16()];
+                SAVE_STATE();
+                if(!co.tailTypedFrame(func))
+                    return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                LOAD_STATE();
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            // The boxed arguments go where untyped foreign functions expect to pop them from. The
+            // result, if there is one, is left in the first. Values holding strings are cleared
+            // afterwards, so that the task's stack doesn't keep them alive.
+            VM_CASE(call_f):
+            {
+                auto index = READ8();
+                const auto* func = foreign[index];
+                const auto* types = importTypes[index].data();
+                Slot* args = sp - func->arity;
+                Value* values = co.sp_;
+                bool strings = !func->native || func->returnType == Type::String;
+                for(std::uint8_t i = 0; i < func->arity; ++i) {
+                    values[i] = Value::adopt(args[i], types[i]);
+                    strings |= types[i] == Type::String;
+                }
+                sp = args;
+                if(func->native) {
+                    func->native(*this, values);
+                } else {
+                    co.sp_ = values + func->arity;
+                    SAVE_STATE();
+                    func->code(*this, co);
+                    co.sp_ = values;
+                }
+                if(func->returnType == Type::String) {
+                    auto* string = values[0].kind == Value::Kind::String ? values[0].unbox().stringValue : nullptr;
+                    if(string) string->retain();
+                    PUSH()->stringValue = string;
+                } else if(func->returnType != Type::Void) {
+                    *PUSH() = values[0].unbox();
+                }
+                for(std::uint8_t i = 0; strings && (i < func->arity || i < 1); ++i) {
+                    values[i] = Value();
+                }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(yield):
+                SAVE_STATE();
+                return std::make_pair(Result::Continue, Value());
+                
+            // Typed programs yield with yield_t, which knows how to box the value.
+            VM_CASE(yield_v):
+                SAVE_STATE();
+                return std::make_pair(Result::Error, Value(std::string("untyped yield in typed code")));
+            
+            VM_CASE(yield_t):
+            {
+                auto type = static_cast<Type>(READ8());
+                auto slot = POP();
+                SAVE_STATE();
+                auto value = Value::adopt(slot, type);
+                return std::make_pair(Result::Continue, std::move(value));
+            }
+            
+            VM_CASE(ret):
+                SAVE_STATE();
+                if(co.popTypedFrame())
+                    return std::make_pair(Result::Done, Value());
+                LOAD_STATE();
+                VM_DISPATCH();
+            
+            VM_CASE(ret_v):
+            {
+                auto type = co.fp_[-1].function->returnType;
+                SAVE_STATE();
+                if(co.returnTypedFrame()) {
+                    auto slot = co.ssp_[-1];
+                    --co.ssp_;
+                    auto value = Value::adopt(slot, type);
+                    return std::make_pair(Result::Done, std::move(value));
+                }
+                LOAD_STATE();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(fail):
+            {
+                const auto& message = CONSTANT(READ8());
+                SAVE_STATE();
+                return std::make_pair(Result::Error, message);
+            }
+            
+            VM_CASE(nop):
+                VM_DISPATCH();
+        }
+        return std::make_pair(Result::Done, Value());
+    }
+}
@@ -6,6 +6,8 @@
 //  Copyright © 2018 Amy Parent. All rights reserved.
 //
 #include <algorithm>
+#include <cstring>
+#include <iostream>
 #include <tinyscript/runtime/vm.hpp>
 
 #include <tinyscript/opcodes.hpp>
@@ -43,6 +45,22 @@ namespace tinyscript {
         }
     }
     
+    bool VM::link(Program& program) const {
+        program.foreign.clear();
+        program.linkedVM = nullptr;
+        for(const auto& signature: program.imports) {
+            auto it = functions_.find(signature);
+            if(it == functions_.end()) {
+                std::cerr << "link error: undefined foreign function '" << signature << "'" << std::endl;
+                program.foreign.clear();
+                return false;
+            }
+            program.foreign.push_back(&it->second);
+        }
+        program.linkedVM = this;
+        return true;
+    }
+    
     Type VM::functionType(const std::string& module, const std::string& symbol, std::uint8_t arity) const {
         auto sig = mangleFunc(module, symbol, arity);
         auto it = functions_.find(sig);
@@ -51,318 +69,675 @@ namespace tinyscript {
     }
     
 
+    const VM::Function* VM::function(const std::string& module, const std::string& symbol, std::uint8_t arity) const {
+        auto it = functions_.find(mangleFunc(module, symbol, arity));
+        return it != functions_.end() ? &it->second : nullptr;
+    }
+    
     bool VM::functionExists(const std::string& module, const std::string& symbol, std::uint8_t arity) const {
         auto sig = mangleFunc(module, symbol, arity);
         auto it = functions_.find(sig);
         return it != functions_.end();
     }
     
-    std::pair<VM::Result, Value> VM::run(tinyscript::Task &co) {
-        for(;;) {
-            auto instr = co.next();
-#ifdef DEBUG_VMSTACK
-            std::cout << "[dbg] inst: " << instr << std::endl;
-            if(co.stackSize() > 0)
-                std::cout << "      tos[" << co.stackSize() << "]: " << co.peek().repr() << std::endl;
-            else
-                std::cout << "      [no stack]" << std::endl;
-#endif
-            switch (instr) {
-                case Opcode::halt:
-                    return std::make_pair(Result::Done, Value());
-                    
-                case Opcode::load_c:
-                    co.push(co.constant(co.read8()));
-                    break;
-                    
-                case Opcode::load_yes:
-                    co.push(Value::boolean(true));
-                    break;
-                    
-                case Opcode::load_no:
-                    co.push(Value::boolean(false));
-                    break;
-                    
-                case Opcode::load:
-                    co.load();
-                    break;
-                    
-                case Opcode::store:
-                    co.store();
-                    break;
-                    
-                case Opcode::fadd:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::Float(a + b));
-                }
-                    break;
-                    
-                case Opcode::fsub:
+    // Compiled functions take their arguments unboxed according to their declared types. Like
+    // native foreign functions, the result overwrites the first argument.
+    static bool callNative(JIT::Entry entry, const Program::Function& func, Value* args, std::uint64_t frames) {
+        std::uint64_t words[JIT::maxArity] = {0};
+        for(std::uint8_t i = 0; i < func.arity; ++i) {
+            switch(func.paramTypes[i]) {
+                case Type::Integer: words[i] = args[i].asInt(); break;
+                case Type::Bool: words[i] = args[i].asBool(); break;
+                default:
                 {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::Float(a - b));
-                }
-                    break;
-                    
-                case Opcode::fmul:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::Float(a * b));
-                }
-                    break;
-                    
-                case Opcode::fdiv:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::Float(a / b));
-                }
-                    break;
-                    
-                case Opcode::fmin:
-                {
-                    double a = co.pop().asNumber();
-                    co.push(Value::Float(-a));
-                }
-                    break;
-                    
-                case Opcode::i2f:
-                    co.push(Value::Float(static_cast<double>(co.pop().asNumber())));
-                    break;
-                    
-                case Opcode::f2i:
-                    co.push(Value::Integer(static_cast<double>(co.pop().asInt())));
-                    break;
-                    
-                case Opcode::iadd:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::Integer(a + b));
-                }
-                    break;
-                    
-                case Opcode::isub:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::Integer(a - b));
-                }
-                    break;
-                    
-                case Opcode::imul:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::Integer(a * b));
-                }
-                    break;
-                    
-                case Opcode::idiv:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::Integer(a / b));
-                }
-                    break;
-                    
-                case Opcode::imin:
-                {
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::Integer(-a));
-                }
-                    break;
-                    
-                case Opcode::sadd:
-                {
-                    const auto& b = co.pop().asString();
-                    const auto& a = co.pop().asString();
-                    co.push(Value(a + b));
-                }
-                    break;
-                    
-                case Opcode::log_and:
-                {
-                    const auto& b = co.pop().asBool();
-                    const auto& a = co.pop().asBool();
-                    co.push(Value::boolean(a && b));
-                }
-                    break;
-                    
-                case Opcode::log_or:
-                {
-                    const auto& b = co.pop().asBool();
-                    const auto& a = co.pop().asBool();
-                    co.push(Value::boolean(a || b));
-                }
-                    break;
-                    
-                case Opcode::test_flt:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::boolean(a < b));
-                }
-                    break;
-                
-                case Opcode::test_flteq:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::boolean(a <= b));
-                }
-                    break;
-                    
-                case Opcode::test_fgt:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::boolean(a > b));
-                }
-                    break;
-                    
-                case Opcode::test_fgteq:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::boolean(a >= b));
-                }
-                    break;
-                    
-                case Opcode::test_feq:
-                {
-                    double b = co.pop().asNumber();
-                    double a = co.pop().asNumber();
-                    co.push(Value::boolean(a == b));
-                }
-                    break;
-                    
-                case Opcode::test_ilt:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::boolean(a < b));
-                }
-                    break;
-                    
-                case Opcode::test_ilteq:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::boolean(a <= b));
-                }
-                    break;
-                    
-                case Opcode::test_igt:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::boolean(a > b));
+                    double number = args[i].asNumber();
+                    std::memcpy(&words[i], &number, sizeof(number));
                 }
                     break;
+            }
+        }
         
-                case Opcode::test_igteq:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::boolean(a >= b));
-                }
-                    break;
-                    
-                case Opcode::test_ieq:
-                {
-                    std::int64_t b = co.pop().asInt();
-                    std::int64_t a = co.pop().asInt();
-                    co.push(Value::boolean(a == b));
-                }
-                    break;
-                    
-                case Opcode::test_seq:
-                {
-                    const auto& b = co.pop().asString();
-                    const auto& a = co.pop().asString();
-                    co.push(Value::boolean(a == b));
+        auto result = entry(frames, words[0], words[1], words[2], words[3], words[4]);
+        if(result.error) return false;
+        switch(func.returnType) {
+            case Type::Void: break;
+            case Type::Integer: args[0] = Value::Integer(result.value); break;
+            case Type::Bool: args[0] = Value::boolean(result.value); break;
+            default:
+            {
+                double number;
+                std::memcpy(&number, &result.value, sizeof(number));
+                args[0] = Value::Float(number);
+            }
+                break;
+        }
+        return true;
+    }
+    
+#ifdef DEBUG_VMSTACK
+    static Opcode trace(Opcode instr, const Value* stack, const Value* sp, const Value* cached) {
+        std::cout << "[dbg] inst: " << instr << std::endl;
+        if(cached)
+            std::cout << "      tos[" << (sp - stack + 1) << "]: " << cached->repr() << " (cached)" << std::endl;
+        else if(sp > stack)
+            std::cout << "      tos[" << (sp - stack) << "]: " << sp[-1].repr() << std::endl;
+        else
+            std::cout << "      [no stack]" << std::endl;
+        return instr;
+    }
+#define VM_FETCH()          trace(static_cast<Opcode>(*ip++), co.stack_, sp, nullptr)
+#define VM_FETCH_CACHED()   trace(static_cast<Opcode>(*ip++), co.stack_, sp, &tos)
+#elif TINYSCRIPT_COUNT_DISPATCH
+#define VM_FETCH()          (dispatched_.fetch_add(1, std::memory_order_relaxed), static_cast<Opcode>(*ip++))
+#define VM_FETCH_CACHED()   VM_FETCH()
+#else
+#define VM_FETCH()          static_cast<Opcode>(*ip++)
+#define VM_FETCH_CACHED()   VM_FETCH()
+#endif
+    
+    // The current frame's registers live in locals for the duration of run(), and are only written
+    // back to the task when control leaves the interpreter loop (calls, returns, yield and fail).
+#define READ8()             (*ip++)
+#define READ16()            (ip += 2, static_cast<std::uint16_t>((ip[-2] << 8) | ip[-1]))
+#define PUSH(value)         (assert(sp < co.stack_ + co.stackSize_ && "Coroutine stack overflow"), *(sp++) = (value))
+#define POP()               (*(--sp))
+#define SPILL()             PUSH(std::move(tos))
+#define CONSTANT(idx)       (co.program_.constants[(idx)])
+#define SAVE_STATE()        (co.ip_ = ip, co.sp_ = sp)
+#define LOAD_STATE()        (ip = co.ip_, sp = co.sp_, base = co.fp_[-1].base)
+
+    // Backward jumps and calls count against the budget of the run, and preempt it with the whole
+    // stack in memory once it ran out.
+#define VM_CHECKPOINT() \
+    if(budget-- == 0 && (budget = co.extension()) == 0) { \
+        SAVE_STATE(); \
+        return std::make_pair(Result::Preempted, Value()); \
+    }
+#define VM_CHECKPOINT_CACHED() \
+    if(budget-- == 0 && (budget = co.extension()) == 0) { \
+        SPILL(); \
+        SAVE_STATE(); \
+        return std::make_pair(Result::Preempted, Value()); \
+    }
+    
+    // The interpreter caches the top of the operand stack in `tos`, a local that the compiler keeps
+    // in registers, and is always in one of two states: the whole stack is in memory below sp
+    // (VM_CASE handlers), or its top is in `tos` and only the rest is in memory (VM_CACHED). Each
+    // opcode has a handler for both, which dispatches to the state it leaves the stack in: values
+    // are produced into `tos`, and consuming the cached value goes back to the first state. Handlers
+    // that need every value in memory (calls, returns, yield) spill `tos` and run the first state's.
+    //
+    // With GCC and clang, each handler jumps straight to the next one through a table of label
+    // addresses for each state (built from x-opcodes.hpp), instead of going back through a switch.
+#if defined(__GNUC__) && !defined(TINYSCRIPT_NO_COMPUTED_GOTO)
+#define TINYSCRIPT_COMPUTED_GOTO 1
+#define VM_LOOP()           VM_DISPATCH();
+#define VM_CASE(name)       op_##name
+#define VM_CACHED(name)     tos_##name
+#define VM_DISPATCH()       goto *dispatchTable[VM_FETCH()]
+#define VM_DISPATCH_CACHED() goto *cachedTable[VM_FETCH_CACHED()]
+#define VM_SPILLED(name)    VM_CACHED(name): SPILL(); goto VM_CASE(name);
+#else
+#define TINYSCRIPT_COMPUTED_GOTO 0
+#define VM_LOOP()           op = static_cast<int>(VM_FETCH()); for(;;) switch(op)
+#define VM_CASE(name)       case static_cast<int>(Opcode::name)
+#define VM_CACHED(name)     case 0x100 | static_cast<int>(Opcode::name)
+#define VM_DISPATCH()       op = static_cast<int>(VM_FETCH()); continue
+#define VM_DISPATCH_CACHED() op = 0x100 | static_cast<int>(VM_FETCH_CACHED()); continue
+#define VM_SPILLED(name)    VM_CACHED(name): SPILL(); op = static_cast<int>(Opcode::name); continue;
+#endif
+
+#define VM_BINARY(name, type, expr) \
+    VM_CASE(name): \
+    { \
+        const auto& b = POP().type(); \
+        const auto& a = POP().type(); \
+        tos = (expr); \
+    } \
+        VM_DISPATCH_CACHED(); \
+    VM_CACHED(name): \
+    { \
+        const auto& b = tos.type(); \
+        const auto& a = POP().type(); \
+        tos = (expr); \
+    } \
+        VM_DISPATCH_CACHED();
+
+#define VM_UNARY(name, type, expr) \
+    VM_CASE(name): \
+    { \
+        const auto& a = POP().type(); \
+        tos = (expr); \
+    } \
+        VM_DISPATCH_CACHED(); \
+    VM_CACHED(name): \
+    { \
+        const auto& a = tos.type(); \
+        tos = (expr); \
+    } \
+        VM_DISPATCH_CACHED();
+
+#define VM_PUSH(name, expr) \
+    VM_CASE(name): \
+        tos = (expr); \
+        VM_DISPATCH_CACHED(); \
+    VM_CACHED(name): \
+        SPILL(); \
+        tos = (expr); \
+        VM_DISPATCH_CACHED();
+    
+#define VM_TEST_LI(name, cond) \
+    VM_CASE(name): \
+    { \
+        std::int64_t a = base[READ8()].asInt(); \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        tos = Value::boolean(cond); \
+    } \
+        VM_DISPATCH_CACHED(); \
+    VM_CACHED(name): \
+    { \
+        std::int64_t a = base[READ8()].asInt(); \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        SPILL(); \
+        tos = Value::boolean(cond); \
+    } \
+        VM_DISPATCH_CACHED();
+
+#define VM_BRANCH(name, type, cond) \
+    VM_CASE(name): \
+    { \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        const auto& b = POP().type(); \
+        const auto& a = POP().type(); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH(); \
+    VM_CACHED(name): \
+    { \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        const auto& b = tos.type(); \
+        const auto& a = POP().type(); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH();
+    
+    // Branches on a local don't touch the operand stack, and stay in the state they were run in.
+#define VM_BRANCH_LI(name, cond) \
+    VM_CASE(name): \
+    { \
+        std::int64_t a = base[READ8()].asInt(); \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT(); } \
+    } \
+        VM_DISPATCH(); \
+    VM_CACHED(name): \
+    { \
+        std::int64_t a = base[READ8()].asInt(); \
+        std::int64_t b = static_cast<std::int16_t>(READ16()); \
+        auto offset = static_cast<std::int16_t>(READ16()); \
+        if(cond) { ip += offset; if(offset < 0) VM_CHECKPOINT_CACHED(); } \
+    } \
+        VM_DISPATCH_CACHED();
+    
+    std::pair<VM::Result, Value> VM::run(Task& co) {
+        co.budget_ = UINT64_MAX;
+        co.timed_ = true;
+        co.deadline_ = std::chrono::steady_clock::time_point::max();
+        return resume(co);
+    }
+    
+    std::pair<VM::Result, Value> VM::run(Task& co, std::uint64_t budget) {
+        co.budget_ = budget;
+        co.timed_ = false;
+        return resume(co);
+    }
+    
+    std::pair<VM::Result, Value> VM::run(Task& co, std::chrono::steady_clock::time_point deadline) {
+        co.budget_ = 0;
+        co.timed_ = true;
+        co.deadline_ = deadline;
+        return resume(co);
+    }
+    
+    // A foreign function may run another task, so the one it was called from is restored after.
+    std::pair<VM::Result, Value> VM::resume(Task& co) {
+        auto* caller = Task::running_;
+        Task::running_ = &co;
+        auto result = execute(co);
+        Task::running_ = caller;
+        return result;
+    }
+    
+    std::pair<VM::Result, Value> VM::execute(tinyscript::Task &co) {
+#if TINYSCRIPT_COMPUTED_GOTO
+#define OPCODE(name, _, __) &&VM_CASE(name),
+        static const void* dispatchTable[] = {
+#include <tinyscript/x-opcodes.hpp>
+        };
+#undef OPCODE
+#define OPCODE(name, _, __) &&VM_CACHED(name),
+        static const void* cachedTable[] = {
+#include <tinyscript/x-opcodes.hpp>
+        };
+#undef OPCODE
+#else
+        int op;
+#endif
+        if(co.program_.linkedVM != this) {
+            return std::make_pair(Result::Error, Value(std::string("program is not linked against this VM")));
+        }
+        // The task's stack couldn't hold the frame it was created with.
+        if(co.fp_ == co.frames_) {
+            return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+        }
+        if(co.program_.compiled) return co.program_.compiled(*this, co);
+        if(co.program_.encoding == Program::Encoding::Registers) return runRegisters(co);
+        if(co.program_.encoding == Program::Encoding::Typed) return runTyped(co);
+        
+        const Function* const* foreign = co.program_.foreign.data();
+        const Program::Function* functions = co.program_.functions.data();
+        const auto& entries = co.budget_ == UINT64_MAX ? co.program_.native : co.program_.bounded;
+        const JIT::Entry* native = entries.empty() ? nullptr : entries.data();
+        const std::uint8_t* ip;
+        Value* sp;
+        Value* base;
+        Value tos;
+        std::uint64_t budget = co.budget_;
+        LOAD_STATE();
+        
+        VM_LOOP() {
+            VM_CASE(halt):
+                SAVE_STATE();
+                return std::make_pair(Result::Done, Value());
+            VM_SPILLED(halt)
+            
+            VM_PUSH(load_c, CONSTANT(READ8()))
+            VM_PUSH(load_i, Value::Integer(static_cast<std::int16_t>(READ16())))
+            VM_PUSH(load_yes, Value::boolean(true))
+            VM_PUSH(load_no, Value::boolean(false))
+            VM_PUSH(load, base[READ8()])
+            
+            VM_CASE(dup):
+                tos = sp[-1];
+                VM_DISPATCH_CACHED();
+            
+            VM_CACHED(dup):
+                PUSH(tos);
+                VM_DISPATCH_CACHED();
+            
+            VM_CASE(store):
+            {
+                auto slot = READ8();
+                base[slot] = POP();
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(store):
+            {
+                auto slot = READ8();
+                base[slot] = std::move(tos);
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(store_s):
+            {
+                auto slot = READ8();
+                base[slot] = POP();
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(store_s):
+            {
+                auto slot = READ8();
+                base[slot] = std::move(tos);
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(pop):
+                --sp;
+                VM_DISPATCH();
+            
+            VM_CACHED(pop):
+                VM_DISPATCH();
+            
+            VM_UNARY(fmin, asNumber, Value::Float(-a))
+            VM_BINARY(fadd, asNumber, Value::Float(a + b))
+            VM_BINARY(fsub, asNumber, Value::Float(a - b))
+            VM_BINARY(fmul, asNumber, Value::Float(a * b))
+            VM_BINARY(fdiv, asNumber, Value::Float(a / b))
+            
+            VM_UNARY(imin, asInt, Value::Integer(-a))
+            VM_BINARY(iadd, asInt, Value::Integer(a + b))
+            VM_BINARY(isub, asInt, Value::Integer(a - b))
+            VM_BINARY(imul, asInt, Value::Integer(a * b))
+            VM_BINARY(idiv, asInt, Value::Integer(a / b))
+            VM_UNARY(iadd_i, asInt, Value::Integer(a + static_cast<std::int16_t>(READ16())))
+            VM_UNARY(isub_i, asInt, Value::Integer(a - static_cast<std::int16_t>(READ16())))
+            
+            VM_CASE(inc_l):
+            {
+                auto slot = READ8();
+                auto delta = static_cast<std::int8_t>(READ8());
+                base[slot] = Value::Integer(base[slot].asInt() + delta);
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(inc_l):
+            {
+                auto slot = READ8();
+                auto delta = static_cast<std::int8_t>(READ8());
+                base[slot] = Value::Integer(base[slot].asInt() + delta);
+            }
+                VM_DISPATCH_CACHED();
+            
+            VM_UNARY(i2f, asInt, Value::Float(static_cast<double>(a)))
+            VM_UNARY(f2i, asNumber, Value::Integer(static_cast<std::int64_t>(a)))
+            
+            VM_BINARY(sadd, asString, Value(a + b))
+            VM_BINARY(log_and, asBool, Value::boolean(a && b))
+            VM_BINARY(log_or, asBool, Value::boolean(a || b))
+            
+            VM_BINARY(test_flt, asNumber, Value::boolean(a < b))
+            VM_BINARY(test_flteq, asNumber, Value::boolean(a <= b))
+            VM_BINARY(test_fgt, asNumber, Value::boolean(a > b))
+            VM_BINARY(test_fgteq, asNumber, Value::boolean(a >= b))
+            VM_BINARY(test_feq, asNumber, Value::boolean(a == b))
+            VM_BINARY(test_ilt, asInt, Value::boolean(a < b))
+            VM_BINARY(test_ilteq, asInt, Value::boolean(a <= b))
+            VM_BINARY(test_igt, asInt, Value::boolean(a > b))
+            VM_BINARY(test_igteq, asInt, Value::boolean(a >= b))
+            VM_BINARY(test_ieq, asInt, Value::boolean(a == b))
+            VM_TEST_LI(test_ilt_li, a < b)
+            VM_TEST_LI(test_ilteq_li, a <= b)
+            VM_TEST_LI(test_igt_li, a > b)
+            VM_TEST_LI(test_igteq_li, a >= b)
+            VM_TEST_LI(test_ieq_li, a == b)
+            VM_BINARY(test_seq, stringObject, Value::boolean(StringObject::equal(a, b)))
+            
+            VM_CASE(jmp):
+            {
+                auto offset = READ16();
+                ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(jmp):
+            {
+                auto offset = READ16();
+                ip += offset;
+            }
+                VM_DISPATCH_CACHED();
+            
+            VM_CASE(rjmp):
+            {
+                auto offset = READ16();
+                ip -= offset;
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(rjmp):
+            {
+                auto offset = READ16();
+                ip -= offset;
+                VM_CHECKPOINT_CACHED();
+            }
+                VM_DISPATCH_CACHED();
+            
+            VM_CASE(jnz):
+            {
+                auto offset = READ16();
+                if(POP().asBool()) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(jnz):
+            {
+                auto offset = READ16();
+                if(tos.asBool()) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(rjnz):
+            {
+                auto offset = READ16();
+                if(POP().asBool()) { ip -= offset; VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(rjnz):
+            {
+                auto offset = READ16();
+                if(tos.asBool()) { ip -= offset; VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(jz):
+            {
+                auto offset = READ16();
+                if(!POP().asBool()) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(jz):
+            {
+                auto offset = READ16();
+                if(!tos.asBool()) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(rjz):
+            {
+                auto offset = READ16();
+                if(!POP().asBool()) { ip -= offset; VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(rjz):
+            {
+                auto offset = READ16();
+                if(!tos.asBool()) { ip -= offset; VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_BRANCH(jilt, asInt, a < b)
+            VM_BRANCH(jilteq, asInt, a <= b)
+            VM_BRANCH(jigt, asInt, a > b)
+            VM_BRANCH(jigteq, asInt, a >= b)
+            VM_BRANCH(jieq, asInt, a == b)
+            VM_BRANCH(jine, asInt, a != b)
+            VM_BRANCH(jflt, asNumber, a < b)
+            VM_BRANCH(jflteq, asNumber, a <= b)
+            VM_BRANCH(jfgt, asNumber, a > b)
+            VM_BRANCH(jfgteq, asNumber, a >= b)
+            VM_BRANCH(jfeq, asNumber, a == b)
+            VM_BRANCH(jfne, asNumber, a != b)
+            VM_BRANCH(jseq, stringObject, StringObject::equal(a, b))
+            VM_BRANCH(jsne, stringObject, !StringObject::equal(a, b))
+            VM_BRANCH_LI(jilt_li, a < b)
+            VM_BRANCH_LI(jilteq_li, a <= b)
+            VM_BRANCH_LI(jigt_li, a > b)
+            VM_BRANCH_LI(jigteq_li, a >= b)
+            VM_BRANCH_LI(jieq_li, a == b)
+            VM_BRANCH_LI(jine_li, a != b)
+            
+            VM_CASE(loop_enter):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = POP().asInt();
+                base[slot] = Value::Integer(count);
+                if(count <= 0) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(loop_enter):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = tos.asInt();
+                base[slot] = Value::Integer(count);
+                if(count <= 0) ip += offset;
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(loop_next):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = base[slot].asInt() - 1;
+                base[slot] = Value::Integer(count);
+                if(count > 0) { ip += offset; if(offset < 0) VM_CHECKPOINT(); }
+            }
+                VM_DISPATCH();
+            
+            VM_CACHED(loop_next):
+            {
+                auto slot = READ8();
+                auto offset = static_cast<std::int16_t>(READ16());
+                std::int64_t count = base[slot].asInt() - 1;
+                base[slot] = Value::Integer(count);
+                if(count > 0) { ip += offset; if(offset < 0) VM_CHECKPOINT_CACHED(); }
+            }
+                VM_DISPATCH_CACHED();
+            
+            VM_CASE(retain):
+                sp[-1].retain();
+                VM_DISPATCH();
+            
+            VM_CACHED(retain):
+                tos.retain();
+                VM_DISPATCH_CACHED();
+            
+            VM_CASE(release):
+                sp[-1].release();
+                VM_DISPATCH();
+            
+            VM_CACHED(release):
+                tos.release();
+                VM_DISPATCH_CACHED();
+            
+            VM_CASE(call_n):
+            {
+                auto index = READ16();
+                const auto& func = functions[index];
+                if(native && native[index]) {
+                    Value* args = sp - func.arity;
+                    assert(args < co.stack_ + co.stackSize_ && "Coroutine stack overflow");
+                    std::uint64_t frames = co.frameCount_ - (co.fp_ - co.frames_);
+                    if(!callNative(native[index], func, args, frames))
+                        return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                    sp = args + (func.returnType != Type::Void);
+                    VM_CHECKPOINT();
+                    VM_DISPATCH();
                 }
-                    break;
-                    
-                case Opcode::jmp:
-                    co.ip_ += co.read16();
-                    break;
-                    
-                case Opcode::rjmp:
-                    co.ip_ -= co.read16();
-                    break;
-                    
-                case Opcode::jnz:
-                    if(co.pop().asBool()) {
-                        co.ip_ += co.read16();
-                    } else {
-                        co.ip_ += 2;
-                    }
-                    break;
-                    
-                case Opcode::rjnz:
-                    if(co.pop().asBool()) {
-                        co.ip_ -= co.read16();
-                    } else {
-                        co.ip_ += 2;
-                    }
-                    break;
-                    
-                case Opcode::retain:
-                    // TODO: implement objects?
-                    break;
-                    
-                case Opcode::release:
-                    // TODO: implement objects?
-                    break;
-                    
-                case Opcode::call_n:
-                {
-                    const auto& signature = co.constant(co.read8());
-                    co.pushFrame(signature.asString());
+                SAVE_STATE();
+                if(!co.pushFrame(func))
+                    return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                LOAD_STATE();
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            // Compiled callees don't know about frames: they run like with call_n, and the
+            // current frame returns their result.
+            VM_CASE(tail_n):
+            {
+                auto index = READ16();
+                const auto& func = functions[index];
+                bool returns = func.returnType != Type::Void;
+                if(native && native[index]) {
+                    Value* args = sp - func.arity;
+                    std::uint64_t frames = co.frameCount_ - (co.fp_ - co.frames_);
+                    if(!callNative(native[index], func, args, frames))
+                        return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                    sp = args + returns;
+                    SAVE_STATE();
+                    if(returns ? co.returnFrame() : co.popFrame())
+                        return std::make_pair(Result::Done, returns ? co.pop() : Value());
+                    LOAD_STATE();
+                    VM_CHECKPOINT();
+                    VM_DISPATCH();
                 }
-                    break;
-                
-                case Opcode::call_f:
-                {
-                    const auto& signature = co.constant(co.read8());
-                    functions_.at(signature.asString()).code(*this, co);
+                SAVE_STATE();
+                if(!co.tailFrame(func))
+                    return std::make_pair(Result::Error, Value(std::string("call stack overflow")));
+                LOAD_STATE();
+                VM_CHECKPOINT();
+            }
+                VM_DISPATCH();
+            
+            VM_CASE(call_f):
+            {
+                const auto* func = foreign[READ8()];
+                if(func->native) {
+                    Value* args = sp - func->arity;
+                    assert(args < co.stack_ + co.stackSize_ && "Coroutine stack overflow");
+                    func->native(*this, args);
+                    sp = args + (func->returnType != Type::Void);
+                } else {
+                    SAVE_STATE();
+                    func->code(*this, co);
+                    sp = co.sp_;
                 }
-                    break;
-                    
-                case Opcode::yield:
-                    return std::make_pair(Result::Continue, Value());
-                    break;
-                    
-                case Opcode::yield_v:
-                    return std::make_pair(Result::Continue, co.pop());
-                    break;
-                    
-                case Opcode::ret:
-                    // TODO: handle return to caller coroutine
-                    if(co.popFrame())
-                        return std::make_pair(Result::Done, Value()); 
-                    break;
-                    
-                case Opcode::ret_v:
-                    if(co.returnFrame())
-                        return std::make_pair(Result::Done, co.pop());
-                    break;
-                    
-                case Opcode::fail:
-                    return std::make_pair(Result::Error, co.constant(co.read8()));
-                    break;
-                    
-                case Opcode::nop:
-                    break;
             }
+                VM_DISPATCH();
+            
+            VM_CASE(yield):
+                SAVE_STATE();
+                return std::make_pair(Result::Continue, Value());
+            
+            VM_CASE(yield_v):
+                --sp;
+                SAVE_STATE();
+                return std::make_pair(Result::Continue, *sp);
+            
+            VM_CASE(yield_t):
+                ++ip;
+                --sp;
+                SAVE_STATE();
+                return std::make_pair(Result::Continue, *sp);
+            
+            VM_CASE(ret):
+                // TODO: handle return to caller coroutine
+                SAVE_STATE();
+                if(co.popFrame())
+                    return std::make_pair(Result::Done, Value());
+                LOAD_STATE();
+                VM_DISPATCH();
+            
+            VM_CASE(ret_v):
+                SAVE_STATE();
+                if(co.returnFrame())
+                    return std::make_pair(Result::Done, co.pop());
+                LOAD_STATE();
+                VM_DISPATCH();
+            
+            VM_CASE(fail):
+            {
+                const auto& message = CONSTANT(READ8());
+                SAVE_STATE();
+                return std::make_pair(Result::Error, message);
+            }
+            
+            VM_CASE(nop):
+                VM_DISPATCH();
+            
+            VM_CACHED(nop):
+                VM_DISPATCH_CACHED();
+            
+            // Calls and returns need the arguments and the return value in memory.
+            VM_SPILLED(call_n)
+            VM_SPILLED(tail_n)
+            VM_SPILLED(call_f)
+            VM_SPILLED(yield)
+            VM_SPILLED(yield_v)
+            VM_SPILLED(yield_t)
+            VM_SPILLED(ret)
+            VM_SPILLED(ret_v)
+            VM_SPILLED(fail)
         }
         return std::make_pair(Result::Done, Value());
     }
 }
-
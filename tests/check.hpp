@@ -0,0 +1,88 @@
+//
+//  check.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <tinyscript/compiler/compiler.hpp>
+#include <tinyscript/compiler/sourcemanager.hpp>
+#include <tinyscript/runtime/program.hpp>
+#include <tinyscript/runtime/task.hpp>
+#include <tinyscript/runtime/vm.hpp>
+
+// Each test is a program whose exit status is the number of checks that failed.
+namespace tinyscript { namespace test {
+    
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+    
+    // The compiler reports errors and carries on, so a script it has anything to say about fails the test.
+    inline Program compile(VM& vm, const std::string& source,
+                           Program::Encoding encoding = Program::Encoding::Stack, std::uint8_t optLevel = 1) {
+        std::ostringstream diagnostics;
+        auto* console = std::cerr.rdbuf(diagnostics.rdbuf());
+        SourceManager manager{source};
+        Compiler compiler{vm, manager};
+        auto program = compiler.compile(false, optLevel, encoding);
+        std::cerr.rdbuf(console);
+        if(!diagnostics.str().empty()) {
+            std::cerr << diagnostics.str() << "in:\n" << source << std::endl;
+            ++failures();
+        }
+        return program;
+    }
+    
+    static const Program::Encoding encodings[] = {
+        Program::Encoding::Stack, Program::Encoding::Registers, Program::Encoding::Typed
+    };
+    
+    // Runs [program] to its end and returns everything it printed, followed by the line the
+    // tinyscript tool shows for each yield and for the error that stopped it, if any.
+    inline std::string run(VM& vm, const Program& program, std::uint32_t stackSize = 256, std::uint32_t frameCount = 64) {
+        std::ostringstream out;
+        auto* console = std::cout.rdbuf(out.rdbuf());
+        Task task{program, stackSize, frameCount};
+        auto result = vm.run(task);
+        while(result.first == VM::Result::Continue) {
+            std::cout << "yield: " << result.second.repr() << std::endl;
+            result = vm.run(task);
+        }
+        if(result.first == VM::Result::Error) {
+            std::cout << "runtime error: " << result.second.asString() << std::endl;
+        }
+        std::cout.rdbuf(console);
+        return out.str();
+    }
+    
+    // Scripts the tests run are found from the root of the source tree.
+    inline std::string source(const std::string& path) {
+        std::ifstream input(std::string(TINYSCRIPT_SOURCE_DIR) + "/" + path);
+        std::ostringstream contents;
+        contents << input.rdbuf();
+        return contents.str();
+    }
+    
+    // Fails the test when [actual] isn't the output [name] should give, and shows both.
+    inline bool same(const std::string& name, const std::string& expected, const std::string& actual) {
+        if(actual == expected) return true;
+        std::cerr << name << ": expected output\n" << expected << "but got\n" << actual << std::endl;
+        ++failures();
+        return false;
+    }
+}}
+
+#define CHECK(condition) do {                                                                       \
+    if(!(condition)) {                                                                              \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;     \
+        ++tinyscript::test::failures();                                                             \
+    }                                                                                               \
+} while(0)
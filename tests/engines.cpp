@@ -0,0 +1,89 @@
+//
+//  engines.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <string>
+#include <utility>
+
+#include <tinyscript/runtime/aot.hpp>
+#include <tinyscript/runtime/jit.hpp>
+#include <tinyscript/runtime/library.hpp>
+#include "check.hpp"
+
+using namespace tinyscript;
+
+// The benchmarks and the optimizer tests' corpus, translated to C++ when building this test (see
+// CMakeLists.txt).
+TINYSCRIPT_DECLARE_SCRIPT(branches)
+TINYSCRIPT_DECLARE_SCRIPT(fib)
+TINYSCRIPT_DECLARE_SCRIPT(foreign)
+TINYSCRIPT_DECLARE_SCRIPT(guards)
+TINYSCRIPT_DECLARE_SCRIPT(helpers)
+TINYSCRIPT_DECLARE_SCRIPT(locals)
+TINYSCRIPT_DECLARE_SCRIPT(loop)
+TINYSCRIPT_DECLARE_SCRIPT(numeric)
+TINYSCRIPT_DECLARE_SCRIPT(strings)
+TINYSCRIPT_DECLARE_SCRIPT(tailcalls)
+TINYSCRIPT_DECLARE_SCRIPT(tasks)
+TINYSCRIPT_DECLARE_SCRIPT(arith)
+TINYSCRIPT_DECLARE_SCRIPT(counting)
+TINYSCRIPT_DECLARE_SCRIPT(flow)
+TINYSCRIPT_DECLARE_SCRIPT(funcs)
+TINYSCRIPT_DECLARE_SCRIPT(recursion)
+TINYSCRIPT_DECLARE_SCRIPT(yield)
+
+static const std::pair<const char*, Program (*)(VM&)> translated[] = {
+    {"bench/branches.tiny", &scripts::branches},
+    {"bench/fib.tiny", &scripts::fib},
+    {"bench/foreign.tiny", &scripts::foreign},
+    {"bench/guards.tiny", &scripts::guards},
+    {"bench/helpers.tiny", &scripts::helpers},
+    {"bench/locals.tiny", &scripts::locals},
+    {"bench/loop.tiny", &scripts::loop},
+    {"bench/numeric.tiny", &scripts::numeric},
+    {"bench/strings.tiny", &scripts::strings},
+    {"bench/tailcalls.tiny", &scripts::tailcalls},
+    {"bench/tasks.tiny", &scripts::tasks},
+    {"tests/corpus/arith.tiny", &scripts::arith},
+    {"tests/corpus/counting.tiny", &scripts::counting},
+    {"tests/corpus/flow.tiny", &scripts::flow},
+    {"tests/corpus/funcs.tiny", &scripts::funcs},
+    {"tests/corpus/recursion.tiny", &scripts::recursion},
+    {"tests/corpus/yield.tiny", &scripts::yield},
+};
+
+// Every way of running a script gives the output the stack interpreter gives: the register and
+// typed encodings, the JIT, and the script translated to C++.
+static void testEngines(VM& vm, const std::string& path, Program (*aot)(VM&)) {
+    auto source = test::source(path);
+    CHECK(!source.empty());
+    auto expected = test::run(vm, test::compile(vm, source));
+    CHECK(expected.find("runtime error") == std::string::npos || path == "tests/corpus/yield.tiny");
+    
+    test::same(path + " -r", expected, test::run(vm, test::compile(vm, source, Program::Encoding::Registers)));
+    test::same(path + " -t", expected, test::run(vm, test::compile(vm, source, Program::Encoding::Typed)));
+    if(JIT::isAvailable()) {
+        auto prog = test::compile(vm, source);
+        JIT::compile(prog);
+        test::same(path + " -j", expected, test::run(vm, prog));
+    }
+    test::same(path + " -a", expected, test::run(vm, aot(vm)));
+}
+
+int main() {
+    VM vm;
+    StdLib lib;
+    vm.registerModule(lib.system());
+    vm.registerModule(lib.io());
+    vm.registerModule(lib.random());
+    vm.registerModule(lib.string());
+    vm.registerModule(lib.reflection());
+    
+    for(const auto& script: translated) {
+        testEngines(vm, script.first, script.second);
+    }
+    return test::failures();
+}
@@ -0,0 +1,557 @@
+//
+//  generator.hpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Random scripts for the optimizer tests. Generators are seeded, so a failing script can be written
+// again from its seed, and only write scripts that terminate.
+namespace tinyscript { namespace test {
+    
+    class Dice {
+    public:
+        Dice(std::uint32_t seed) : engine_(seed) {}
+        
+        int range(int min, int max) { return std::uniform_int_distribution<int>(min, max)(engine_); }
+        double roll() { return std::uniform_real_distribution<double>(0, 1)(engine_); }
+        bool chance(double p) { return roll() < p; }
+        
+        template <typename T>
+        const T& pick(const std::vector<T>& items) { return items[range(0, int(items.size()) - 1)]; }
+    
+    private:
+        std::mt19937 engine_;
+    };
+    
+    // Scripts mixing every type, with functions (recursive ones included), nested loops and
+    // conditions, early returns and yields.
+    class ScriptGenerator {
+    public:
+        ScriptGenerator(std::uint32_t seed) : dice_(seed) {}
+        
+        std::string script() {
+            std::vector<std::string> lines;
+            allowYield_ = dice_.chance(0.3);
+            for(int i = dice_.range(0, 4); i > 0; --i) {
+                function(lines);
+            }
+            block(lines, {}, 0, 0, false, "", dice_.range(3, 10));
+            
+            std::string source;
+            for(const auto& line: lines) source += line + "\n";
+            return source;
+        }
+    
+    private:
+        struct Variable {
+            std::string name;
+            std::string type;
+            bool        writable;
+        };
+        using Scope = std::vector<Variable>;
+        
+        struct Function {
+            std::string                 name;
+            std::vector<std::string>    params;
+            std::string                 ret;
+            bool                        recursive;
+        };
+        
+        std::string fresh(const std::string& prefix) { return prefix + std::to_string(++count_); }
+        
+        std::string literal(const std::string& type) {
+            if(type == "Integer") return std::to_string(dice_.range(0, 12));
+            if(type == "Real") return std::to_string(dice_.range(0, 20)) + "." + dice_.pick<std::string>({"0", "5", "25"});
+            if(type == "String") return "\"" + dice_.pick<std::string>({"a", "bb", "ccc", "state.a", "state.b", "d"}) + "\"";
+            return dice_.pick<std::string>({"yes", "no"});
+        }
+        
+        std::string term(const std::string& type, const Scope& scope, int depth) {
+            return "(" + expression(type, scope, depth + 1) + ")";
+        }
+        
+        // Returns an empty string when no function returns [type].
+        std::string call(const std::string& type, const Scope& scope, int depth) {
+            std::vector<const Function*> candidates;
+            for(const auto& function: functions_) {
+                // Recursive functions are only called from the script, which keeps the number of calls small.
+                if(function.ret == type && !(function.recursive && inFunction_)) candidates.push_back(&function);
+            }
+            if(candidates.empty()) return "";
+            
+            const auto& function = *dice_.pick(candidates);
+            std::string args;
+            for(const auto& param: function.params) {
+                if(!args.empty()) args += ", ";
+                args += expression(param, scope, depth + 2);
+            }
+            return function.name + "(" + args + ")";
+        }
+        
+        std::string expression(const std::string& type, const Scope& scope, int depth = 0) {
+            std::vector<std::string> variables;
+            for(const auto& variable: scope) {
+                if(variable.type == type) variables.push_back(variable.name);
+            }
+            if(depth > 2 || dice_.chance(0.3)) {
+                if(!variables.empty() && dice_.chance(0.7)) return dice_.pick(variables);
+                return literal(type);
+            }
+            
+            auto k = dice_.roll();
+            std::string called;
+            if(type == "Integer") {
+                if(k < 0.4) {
+                    auto op = dice_.pick<std::string>({"+", "-", "+", "*"});
+                    return "(" + expression(type, scope, depth + 1) + ") " + op + " (" + expression(type, scope, depth + 1) + ")";
+                }
+                // Division by a constant (never 0) goes through the strength reductions.
+                if(k < 0.45) return term(type, scope, depth) + " / " + dice_.pick<std::string>({"2", "3", "7", "(-4)"});
+                if(k < 0.55) return "-" + term(type, scope, depth);
+                if(k < 0.8) called = call(type, scope, depth);
+            }
+            else if(type == "Real") {
+                if(k < 0.5) {
+                    auto lhs = expression(dice_.pick<std::string>({"Integer", "Real"}), scope, depth + 1);
+                    auto op = dice_.pick<std::string>({"+", "-", "*"});
+                    return "(" + lhs + ") " + op + " (" + expression(type, scope, depth + 1) + ")";
+                }
+                if(k < 0.7) called = call(type, scope, depth);
+            }
+            else if(type == "String") {
+                if(k < 0.5) {
+                    auto rhs = expression(dice_.pick<std::string>({"String", "Integer", "Bool"}), scope, depth + 1);
+                    return "(" + expression(type, scope, depth + 1) + ") + (" + rhs + ")";
+                }
+                if(k < 0.7) called = call(type, scope, depth);
+            }
+            else {
+                if(k < 0.35) {
+                    auto operands = dice_.pick<std::string>({"Integer", "Integer", "Real"});
+                    auto op = dice_.pick<std::string>({"<", ">", "<=", ">=", "=="});
+                    return "(" + expression(operands, scope, depth + 1) + ") " + op + " (" + expression(operands, scope, depth + 1) + ")";
+                }
+                if(k < 0.45) return "(" + expression("String", scope, depth + 1) + ") == (" + expression("String", scope, depth + 1) + ")";
+                if(k < 0.75) return term(type, scope, depth) + " " + dice_.pick<std::string>({"and", "or"}) + " " + term(type, scope, depth);
+                if(k < 0.85) called = call(type, scope, depth);
+            }
+            return called.empty() ? term(type, scope, depth) : called;
+        }
+        
+        void block(std::vector<std::string>& lines, Scope scope, int indent, int depth, bool inLoop,
+                   const std::string& returnType, int count) {
+            const std::string pre(4 * indent, ' ');
+            for(int i = 0; i < count; ++i) {
+                auto k = dice_.roll();
+                if(k < 0.2) {
+                    auto type = dice_.pick<std::string>({"Integer", "Integer", "Real", "String", "Bool"});
+                    auto name = fresh("v");
+                    lines.push_back(pre + "var " + name + " = " + expression(type, scope));
+                    scope.push_back({name, type, true});
+                }
+                else if(k < 0.4) {
+                    std::vector<Variable> writable;
+                    for(const auto& variable: scope) {
+                        if(variable.writable) writable.push_back(variable);
+                    }
+                    if(writable.empty()) continue;
+                    // A string assigned from strings could double in length on every iteration of a loop.
+                    const auto& variable = dice_.pick(writable);
+                    Scope operands;
+                    for(const auto& operand: scope) {
+                        if(variable.type != "String" || operand.type != "String") operands.push_back(operand);
+                    }
+                    lines.push_back(pre + variable.name + " = " + expression(variable.type, operands));
+                }
+                else if(k < 0.55) {
+                    auto type = dice_.pick<std::string>({"Integer", "Real", "String", "Bool"});
+                    lines.push_back(pre + "IO.print(" + expression(type, scope) + ")");
+                }
+                else if(k < 0.65 && depth < 3) {
+                    lines.push_back(pre + "if " + expression("Bool", scope) + " {");
+                    block(lines, scope, indent + 1, depth + 1, inLoop, returnType, dice_.range(1, 3));
+                    if(dice_.chance(0.5)) {
+                        lines.push_back(pre + "} else {");
+                        block(lines, scope, indent + 1, depth + 1, inLoop, returnType, dice_.range(1, 3));
+                    }
+                    lines.push_back(pre + "}");
+                }
+                else if(k < 0.72 && depth < 3) {
+                    auto counter = fresh("c");
+                    lines.push_back(pre + "var " + counter + " = 0");
+                    lines.push_back(pre + "until " + counter + " >= " + std::to_string(dice_.range(0, 5)) + " {");
+                    lines.push_back(pre + "    " + counter + " = " + counter + " + 1");
+                    scope.push_back({counter, "Integer", false});
+                    block(lines, scope, indent + 1, depth + 1, true, returnType, dice_.range(1, 3));
+                    lines.push_back(pre + "}");
+                }
+                else if(k < 0.79 && depth < 3) {
+                    lines.push_back(pre + "loop " + std::to_string(dice_.range(-1, 4)) + " {");
+                    block(lines, scope, indent + 1, depth + 1, true, returnType, dice_.range(1, 3));
+                    lines.push_back(pre + "}");
+                }
+                else if(k < 0.85 && inLoop) {
+                    auto flow = dice_.pick<std::string>({"next", "stoploop"});
+                    if(dice_.chance(0.5)) {
+                        lines.push_back(pre + "guard " + expression("Bool", scope) + " else " + flow);
+                    } else {
+                        lines.push_back(pre + "if " + expression("Bool", scope) + " {");
+                        lines.push_back(pre + "    " + flow);
+                        lines.push_back(pre + "}");
+                    }
+                }
+                else if(k < 0.9 && !returnType.empty()) {
+                    lines.push_back(pre + "if " + expression("Bool", scope) + " {");
+                    lines.push_back(pre + "    return " + expression(returnType, scope));
+                    lines.push_back(pre + "}");
+                }
+                else if(k < 0.93 && allowYield_) {
+                    auto type = dice_.pick<std::string>({"Integer", "String", "Real", "Bool"});
+                    lines.push_back(pre + "yield " + expression(type, scope));
+                }
+                else {
+                    auto type = dice_.pick<std::string>({"Integer", "String"});
+                    lines.push_back(pre + "IO.print(" + expression(type, scope) + ")");
+                }
+            }
+        }
+        
+        // Recursive functions take their depth first, and stop after a few calls whatever it is.
+        void function(std::vector<std::string>& lines) {
+            static const std::vector<std::string> types = {"Integer", "Integer", "Real", "Bool", "String"};
+            
+            Function function;
+            function.name = fresh("f");
+            function.recursive = dice_.chance(0.35);
+            function.ret = dice_.pick(types);
+            
+            Scope scope;
+            if(function.recursive) scope.push_back({fresh("p"), "Integer", false});
+            for(int i = dice_.range(0, 3); i > 0; --i) {
+                scope.push_back({fresh("p"), dice_.pick(types), false});
+            }
+            std::string params;
+            for(const auto& param: scope) {
+                if(!params.empty()) params += ", ";
+                params += param.name + ": " + param.type;
+                function.params.push_back(param.type);
+            }
+            lines.push_back("func " + function.name + " = (" + params + ") -> " + function.ret + " {");
+            
+            inFunction_ = true;
+            auto allowYield = allowYield_;
+            allowYield_ = false;
+            
+            std::string recursion;
+            if(function.recursive) {
+                const auto& depth = scope.front().name;
+                lines.push_back("    if " + depth + " <= 0 or " + depth + " > 6 {");
+                lines.push_back("        return " + expression(function.ret, scope));
+                lines.push_back("    }");
+                recursion = function.name + "(" + depth + " - 1";
+                for(std::uint64_t i = 1; i < scope.size(); ++i) {
+                    recursion += ", " + expression(scope[i].type, scope, 2);
+                }
+                recursion += ")";
+            }
+            block(lines, scope, 1, 1, false, function.ret, dice_.range(1, 4));
+            
+            if(!function.recursive) {
+                lines.push_back("    return " + expression(function.ret, scope));
+            } else if((function.ret == "Integer" || function.ret == "Real") && dice_.chance(0.5)) {
+                lines.push_back("    return " + recursion + " + " + expression(function.ret, scope, 2));
+            } else {
+                lines.push_back("    return " + recursion);
+            }
+            lines.push_back("}");
+            
+            allowYield_ = allowYield;
+            inFunction_ = false;
+            functions_.push_back(function);
+        }
+        
+        Dice                    dice_;
+        int                     count_ = 0;
+        bool                    allowYield_ = false;
+        bool                    inFunction_ = false;
+        std::vector<Function>   functions_;
+    };
+    
+    // Functions that only call each other (or themselves) in tail position, hundreds of calls deep:
+    // they have to run in the frames of a task that couldn't hold that many.
+    class TailCallGenerator {
+    public:
+        TailCallGenerator(std::uint32_t seed) : dice_(seed) {}
+        
+        std::string script(int maxDepth = 300) {
+            for(int k = 0, count = dice_.range(1, 5); k < count; ++k) {
+                Function function{"f" + std::to_string(k), dice_.pick(returnTypes), {}};
+                for(int i = 0, params = dice_.range(0, 4); i < params; ++i) {
+                    function.params.push_back({"p" + std::to_string(i), dice_.pick(types)});
+                }
+                functions_.push_back(function);
+            }
+            
+            std::ostringstream out;
+            for(std::uint64_t k = 0; k < functions_.size(); ++k) {
+                body(out, k);
+            }
+            for(const auto& function: functions_) {
+                std::string call = function.name + "(" + std::to_string(dice_.range(0, maxDepth));
+                for(const auto& param: function.params) call += ", " + literal(param.second);
+                call += ")";
+                out << (function.ret == "Void" ? call : "IO.print(" + call + ")") << "\n";
+            }
+            return out.str();
+        }
+    
+    private:
+        using Variables = std::vector<std::pair<std::string, std::string>>;
+        struct Function {
+            std::string name;
+            std::string ret;
+            Variables   params;
+        };
+        
+        const std::vector<std::string> types = {"Integer", "Real", "Bool", "String"};
+        const std::vector<std::string> returnTypes = {"Integer", "Real", "Bool", "String", "Void"};
+        
+        std::string literal(const std::string& type) {
+            if(type == "Integer") return std::to_string(dice_.range(0, 9));
+            if(type == "Real") return std::to_string(dice_.range(0, 5)) + ".5";
+            if(type == "String") return dice_.pick<std::string>({"\"a\"", "\"bc\"", "\"x\""});
+            return dice_.pick<std::string>({"yes", "no"});
+        }
+        
+        std::string expression(const std::string& type, const Variables& variables, int depth = 0) {
+            std::vector<std::string> candidates;
+            for(const auto& variable: variables) {
+                if(variable.second == type) candidates.push_back(variable.first);
+            }
+            if(depth > 2 || dice_.chance(0.4)) {
+                return !candidates.empty() && dice_.chance(0.7) ? dice_.pick(candidates) : literal(type);
+            }
+            if(type == "Integer" || type == "Real") {
+                auto op = dice_.pick<std::string>({"+", "-", "*"});
+                return "(" + expression(type, variables, depth + 1) + " " + op + " " + expression(type, variables, depth + 1) + ")";
+            }
+            if(type == "String") {
+                return "(" + expression(type, variables, depth + 1) + " + " + expression(type, variables, depth + 1) + ")";
+            }
+            auto op = dice_.pick<std::string>({"<", ">", "=="});
+            return "(" + expression("Integer", variables, depth + 1) + " " + op + " " + expression("Integer", variables, depth + 1) + ")";
+        }
+        
+        // Strings are passed on as they are: concatenating them on every call would double their
+        // length hundreds of times.
+        std::string call(const Function& function, const Function& caller, const Variables& variables) {
+            std::string call = function.name + "(n - " + std::to_string(dice_.range(1, 3));
+            for(const auto& param: function.params) {
+                if(param.second != "String") {
+                    call += ", " + expression(param.second, variables, 1);
+                    continue;
+                }
+                std::vector<std::string> strings;
+                for(const auto& own: caller.params) {
+                    if(own.second == "String") strings.push_back(own.first);
+                }
+                call += ", " + (!strings.empty() && dice_.chance(0.7) ? dice_.pick(strings) : literal("String"));
+            }
+            return call + ")";
+        }
+        
+        // Each function calls itself or one declared before it that returns the same type.
+        void body(std::ostream& out, std::uint64_t index) {
+            const auto& function = functions_[index];
+            Variables variables = {{"n", "Integer"}};
+            variables.insert(variables.end(), function.params.begin(), function.params.end());
+            
+            std::string params;
+            for(const auto& param: function.params) params += ", " + param.first + ": " + param.second;
+            out << "func " << function.name << " = (n: Integer" << params << ") -> " << function.ret << " {\n";
+            
+            bool isVoid = function.ret == "Void";
+            out << "    if n <= 0 {\n";
+            if(isVoid) out << "        IO.print(\"" << function.name << "\")\n        return\n";
+            else out << "        return " << expression(function.ret, variables) << "\n";
+            out << "    }\n";
+            
+            for(int j = 0, locals = dice_.range(0, 3); j < locals; ++j) {
+                auto type = dice_.pick(types);
+                auto name = "l" + std::to_string(j);
+                out << "    var " << name << " = " << expression(type, variables) << "\n";
+                variables.push_back({name, type});
+            }
+            if(dice_.chance(0.5)) out << "    IO.print(" << dice_.pick(variables).first << ")\n";
+            
+            std::vector<const Function*> targets;
+            for(std::uint64_t k = 0; k <= index; ++k) {
+                if(functions_[k].ret == function.ret) targets.push_back(&functions_[k]);
+            }
+            for(int j = 0, branches = dice_.range(1, 2); j < branches; ++j) {
+                const auto& target = *dice_.pick(targets);
+                out << "    if " << expression("Bool", variables) << " {\n";
+                if(isVoid) out << "        " << call(target, function, variables) << "\n        return\n";
+                else out << "        return " << call(target, function, variables) << "\n";
+                out << "    }\n";
+            }
+            const auto& target = *dice_.pick(targets);
+            out << (isVoid ? "    " : "    return ") << call(target, function, variables) << "\n";
+            out << "}\n";
+        }
+        
+        Dice                    dice_;
+        std::vector<Function>   functions_;
+    };
+    
+    // Conditions made of `and`, `or` and predicates that print their name when they're called, with
+    // the output they must give: an operand only runs when the ones before it didn't decide.
+    class LogicGenerator {
+    public:
+        LogicGenerator(std::uint32_t seed) : dice_(seed) {}
+        
+        std::string script() {
+            for(int k = 0; k < 3; ++k) {
+                auto name = "p" + std::to_string(k);
+                predicates_[name] = dice_.range(0, 6);
+                lines_.push_back("func " + name + " = (n: Integer) -> Bool {");
+                lines_.push_back("    IO.print(\"" + name + "\")");
+                lines_.push_back("    return n > " + std::to_string(predicates_[name]));
+                lines_.push_back("}");
+            }
+            Environment env = {{"i0", dice_.range(0, 6)}, {"i1", dice_.range(0, 6)},
+                               {"c0", dice_.range(0, 1)}, {"m0", dice_.range(0, 1)}};
+            for(const auto& variable: env) {
+                auto value = variable.first[0] == 'i' ? std::to_string(variable.second) : variable.second ? "yes" : "no";
+                lines_.push_back("var " + variable.first + " = " + value);
+            }
+            
+            for(int k = 0, count = dice_.range(4, 10); k < count; ++k) {
+                auto t = dice_.roll();
+                auto id = std::to_string(k);
+                if(t < 0.9) {
+                    auto cond = condition(0, env);
+                    if(t < 0.25) {
+                        lines_.push_back("IO.print(" + cond.first + ")");
+                        print(cond.second(env));
+                    }
+                    else if(t < 0.5) {
+                        lines_.insert(lines_.end(), {"if " + cond.first + " {", "    IO.print(\"t" + id + "\")",
+                                                     "} else {", "    IO.print(\"f" + id + "\")", "}"});
+                        bool taken = cond.second(env);
+                        output_ += (taken ? "t" : "f") + id + "\n";
+                    }
+                    else if(t < 0.6) {
+                        lines_.insert(lines_.end(), {"if " + cond.first + " {", "    IO.print(\"t" + id + "\")", "}"});
+                        bool taken = cond.second(env);
+                        if(taken) output_ += "t" + id + "\n";
+                    }
+                    else if(t < 0.7) {
+                        lines_.insert(lines_.end(), {"m0 = " + cond.first, "IO.print(m0)"});
+                        bool value = cond.second(env);
+                        env["m0"] = value;
+                        print(env["m0"]);
+                    }
+                    else if(t < 0.8) {
+                        lines_.insert(lines_.end(), {"var v" + id + " = " + cond.first, "IO.print(v" + id + ")"});
+                        bool value = cond.second(env);
+                        env["v" + id] = value;
+                        print(env["v" + id]);
+                    }
+                    else {
+                        lines_.insert(lines_.end(), {"i1 = 0", "until i1 > 3 or (" + cond.first + ") {",
+                                                     "    i1 = i1 + 1", "}", "IO.print(\"l" + id + "\")"});
+                        for(env["i1"] = 0; !(env["i1"] > 3 || cond.second(env)); ++env["i1"]);
+                        output_ += "l" + id + "\n";
+                    }
+                } else {
+                    // Functions only see their parameters, which get the script's integers swapped.
+                    Environment params = {{"i0", env["i1"]}, {"i1", env["i0"]}};
+                    auto cond = condition(0, params);
+                    lines_.insert(lines_.end(), {"func q" + id + " = (i0: Integer, i1: Integer) -> Bool {",
+                                                 "    return " + cond.first, "}", "IO.print(q" + id + "(i1, i0))"});
+                    print(cond.second(params));
+                }
+                if(dice_.chance(0.3)) {
+                    lines_.push_back("i0 = i0 + 1");
+                    ++env["i0"];
+                }
+            }
+            
+            std::string source;
+            for(const auto& line: lines_) source += line + "\n";
+            return source;
+        }
+        
+        // What the last script written must print.
+        const std::string& output() const { return output_; }
+    
+    private:
+        using Environment = std::map<std::string, int>;
+        using Condition = std::pair<std::string, std::function<bool(const Environment&)>>;
+        
+        void print(bool value) { output_ += value ? "true\n" : "false\n"; }
+        
+        Condition condition(int depth, const Environment& env) {
+            std::vector<std::string> integers, flags;
+            for(const auto& variable: env) {
+                (variable.first[0] == 'i' ? integers : flags).push_back(variable.first);
+            }
+            
+            auto c = dice_.roll();
+            if(depth > 3 || c < 0.35) {
+                auto a = dice_.roll();
+                if(a < 0.15 || (a < 0.35 && flags.empty())) {
+                    bool value = dice_.chance(0.5);
+                    return {value ? "yes" : "no", [value](const Environment&) { return value; }};
+                }
+                if(a < 0.35) {
+                    auto name = dice_.pick(flags);
+                    return {name, [name](const Environment& e) { return e.at(name) != 0; }};
+                }
+                auto name = dice_.pick(integers);
+                if(a < 0.65) {
+                    auto k = dice_.range(0, 6);
+                    auto op = dice_.pick<std::string>({"<", ">", "=="});
+                    return {name + " " + op + " " + std::to_string(k), [name, k, op](const Environment& e) {
+                        auto value = e.at(name);
+                        return op == "<" ? value < k : op == ">" ? value > k : value == k;
+                    }};
+                }
+                auto predicate = "p" + std::to_string(dice_.range(0, 2));
+                auto limit = predicates_[predicate];
+                return {predicate + "(" + name + ")", [this, predicate, limit, name](const Environment& e) {
+                    output_ += predicate + "\n";
+                    return e.at(name) > limit;
+                }};
+            }
+            
+            bool isAnd = c < 0.65;
+            auto lhs = condition(depth + 1, env);
+            auto rhs = condition(depth + 1, env);
+            if(dice_.chance(0.5) || (isAnd && lhs.first.find(" or ") != std::string::npos)) lhs.first = "(" + lhs.first + ")";
+            if(dice_.chance(0.5) || isAnd) rhs.first = "(" + rhs.first + ")";
+            
+            auto left = lhs.second, right = rhs.second;
+            if(isAnd) {
+                return {lhs.first + " and " + rhs.first, [left, right](const Environment& e) { return left(e) && right(e); }};
+            }
+            return {lhs.first + " or " + rhs.first, [left, right](const Environment& e) { return left(e) || right(e); }};
+        }
+        
+        Dice                        dice_;
+        std::map<std::string, int>  predicates_;
+        std::vector<std::string>    lines_;
+        std::string                 output_;
+    };
+}}
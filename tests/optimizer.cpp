@@ -0,0 +1,216 @@
+//
+//  optimizer.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <string>
+
+#include <tinyscript/runtime/jit.hpp>
+#include <tinyscript/runtime/library.hpp>
+#include "check.hpp"
+#include "generator.hpp"
+
+using namespace tinyscript;
+
+// Scripts in tests/corpus, each next to the output it gives.
+static const char* corpus[] = {"arith", "counting", "flow", "funcs", "recursion", "yield"};
+
+static std::string describe(const std::string& name, Program::Encoding encoding, int optLevel) {
+    static const char* flags[] = {"", " -r", " -t"};
+    return name + " -O" + std::to_string(optLevel) + flags[static_cast<int>(encoding)];
+}
+
+// Every optimization level gives [expected], in every encoding.
+static bool sameAtEveryLevel(VM& vm, const std::string& name, const std::string& source, const std::string& expected) {
+    bool same = true;
+    for(auto encoding: test::encodings) {
+        for(int optLevel = 0; optLevel <= 2; ++optLevel) {
+            auto prog = test::compile(vm, source, encoding, optLevel);
+            same &= test::same(describe(name, encoding, optLevel), expected, test::run(vm, prog));
+        }
+    }
+    return same;
+}
+
+// Generated scripts must give what they give at -O0 at every other level.
+template <typename Generator>
+static void testGenerated(VM& vm, const std::string& name, std::uint32_t count) {
+    for(std::uint32_t seed = 1; seed <= count; ++seed) {
+        Generator generator{seed};
+        auto source = generator.script();
+        auto expected = test::run(vm, test::compile(vm, source, Program::Encoding::Stack, 0));
+        CHECK(expected.find("runtime error") == std::string::npos);
+        if(!sameAtEveryLevel(vm, name + " " + std::to_string(seed), source, expected)) std::cerr << source << std::endl;
+    }
+}
+
+static void testCorpus(VM& vm) {
+    for(std::string name: corpus) {
+        auto source = test::source("tests/corpus/" + name + ".tiny");
+        auto expected = test::source("tests/corpus/" + name + ".tiny.expected");
+        CHECK(!source.empty() && !expected.empty());
+        sameAtEveryLevel(vm, name, source, expected);
+    }
+}
+
+// Operands of `and` and `or` only run when the ones before them didn't decide the result, including
+// when the inliner copied them or the condition only picks a branch.
+static void testShortCircuit(VM& vm) {
+    sameAtEveryLevel(vm, "short-circuit", R"(
+func say = (name: String, value: Bool) -> Bool {
+    IO.print(name)
+    return value
+}
+IO.print(say("a", no) and say("b", yes))
+IO.print(say("c", yes) or say("d", yes))
+if say("e", yes) and say("f", no) or say("g", yes) {
+    IO.print("taken")
+}
+var i = 0
+until i > 1 or say("h", no) {
+    i = i + 1
+}
+)", "a\nfalse\nc\ntrue\ne\nf\ng\ntaken\nh\nh\n");
+    
+    for(std::uint32_t seed = 1; seed <= 200; ++seed) {
+        test::LogicGenerator generator{seed};
+        auto source = generator.script();
+        if(!sameAtEveryLevel(vm, "logic " + std::to_string(seed), source, generator.output())) std::cerr << source << std::endl;
+    }
+}
+
+// Tail calls reuse the caller's frame at every level: a task with room for a handful of values
+// and frames runs recursions a hundred thousand calls deep.
+static void testTailCalls(VM& vm) {
+    static const char* source = R"(
+func sum = (n: Integer, total: Integer) -> Integer {
+    if n == 0 {
+        return total
+    }
+    return sum(n - 1, total + n)
+}
+func down = (n: Integer) -> Void {
+    if n == 0 {
+        IO.print("down")
+        return
+    }
+    down(n - 1)
+}
+IO.print(sum(100000, 0))
+down(100000)
+)";
+    for(auto encoding: test::encodings) {
+        for(int optLevel = 0; optLevel <= 2; ++optLevel) {
+            auto prog = test::compile(vm, source, encoding, optLevel);
+            test::same(describe("tail calls", encoding, optLevel), "5000050000\ndown\n", test::run(vm, prog, 32, 4));
+        }
+    }
+    testGenerated<test::TailCallGenerator>(vm, "tail calls", 100);
+}
+
+// An integer division by a constant 0 is left for the program to run rather than folded while
+// compiling, and the division that isn't by 0 still is.
+static void testDivisionByZero(VM& vm) {
+    static const char* source = R"(
+func divide = (a: Integer) -> Integer {
+    return a / 0
+}
+var zero = 0
+if zero > 0 {
+    IO.print(divide(7) + 7 / 0)
+}
+IO.print(7 / 2)
+)";
+    for(int optLevel = 0; optLevel <= 2; ++optLevel) {
+        std::ostringstream dump;
+        auto* console = std::cerr.rdbuf(dump.rdbuf());
+        SourceManager manager{source};
+        Compiler compiler{vm, manager};
+        auto prog = compiler.compile(true, optLevel);
+        std::cerr.rdbuf(console);
+        
+        auto code = dump.str();
+        auto first = code.find("idiv");
+        CHECK(first != std::string::npos && code.find("idiv", first + 1) != std::string::npos);
+        CHECK(code.find("$3") != std::string::npos);
+    }
+    sameAtEveryLevel(vm, "division by zero", source, "3\n");
+}
+
+// Comparisons with NaN are all false, so a float branch can't be turned into the opposite test
+// (`x < y` isn't `!(x >= y)`) when the optimizer flips a condition around.
+static void testNaN(VM& vm) {
+    static const char* source = R"(
+func nan = (zero: Real) -> Real {
+    return zero / zero
+}
+func compare = (x: Real) -> Void {
+    if x < 1.0 {
+        IO.print("lt")
+    } else {
+        IO.print("not lt")
+    }
+    if x >= 1.0 {
+        IO.print("gteq")
+    } else {
+        IO.print("not gteq")
+    }
+    if x == x {
+        IO.print("eq")
+    } else {
+        IO.print("not eq")
+    }
+}
+func above = (x: Real) -> Bool {
+    guard x > 1.0 else return no
+    return yes
+}
+func choose = (count: Integer, first: Real, then: Real) -> Real {
+    if count == 1 {
+        return first
+    }
+    return then
+}
+var n = nan(0.0)
+compare(n)
+compare(2.0)
+IO.print(above(n))
+var x = 0.5
+var i = 0
+until x >= 1.0 {
+    i = i + 1
+    x = choose(i, n, 2.0)
+}
+var y = 2.0
+var j = 0
+until y < 1.0 {
+    j = j + 1
+    y = choose(j, n, 0.5)
+}
+IO.print(i + j)
+)";
+    static const char* expected = "not lt\nnot gteq\nnot eq\nnot lt\ngteq\neq\nfalse\n4\n";
+    sameAtEveryLevel(vm, "NaN", source, expected);
+    if(!JIT::isAvailable()) return;
+    for(int optLevel = 0; optLevel <= 2; ++optLevel) {
+        auto prog = test::compile(vm, source, Program::Encoding::Stack, optLevel);
+        JIT::compile(prog);
+        test::same(describe("NaN", Program::Encoding::Stack, optLevel) + " -j", expected, test::run(vm, prog));
+    }
+}
+
+int main() {
+    VM vm;
+    StdLib lib;
+    vm.registerModule(lib.io());
+    
+    testCorpus(vm);
+    testGenerated<test::ScriptGenerator>(vm, "script", 300);
+    testShortCircuit(vm);
+    testTailCalls(vm);
+    testDivisionByZero(vm);
+    testNaN(vm);
+    return test::failures();
+}
@@ -0,0 +1,169 @@
+//
+//  scheduler.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <tinyscript/runtime/jit.hpp>
+#include <tinyscript/runtime/scheduler.hpp>
+#include "check.hpp"
+
+using namespace tinyscript;
+
+static const char* counter = R"(
+var i = 0
+loop 3 {
+    i = i + 1
+    yield i
+}
+)";
+
+// Tasks take turns, and each tick resumes every one of them once.
+static void testYield(Program::Encoding encoding) {
+    VM vm;
+    auto prog = test::compile(vm, counter, encoding);
+    
+    std::vector<std::pair<Task*, std::int64_t>> yields;
+    std::vector<Task*> exits;
+    Scheduler scheduler{vm};
+    scheduler.onYield([&](Task& task, const Value& value) { yields.emplace_back(&task, value.asInt()); });
+    scheduler.onExit([&](Task& task, VM::Result result, const Value&) {
+        CHECK(result == VM::Result::Done);
+        exits.push_back(&task);
+    });
+    auto a = &scheduler.spawn(prog);
+    auto b = &scheduler.spawn(prog);
+    
+    for(std::size_t i = 1; i <= 3; ++i) {
+        CHECK(scheduler.tick() == 2);
+        CHECK(yields.size() == 2 * i);
+        if(yields.size() != 2 * i) return;
+        CHECK(yields[2*i-2] == std::make_pair(a, std::int64_t(i)));
+        CHECK(yields[2*i-1] == std::make_pair(b, std::int64_t(i)));
+    }
+    CHECK(exits.empty());
+    CHECK(scheduler.tick() == 2);
+    CHECK(scheduler.empty());
+    CHECK(exits == (std::vector<Task*>{a, b}));
+    CHECK(scheduler.resumes() == 8);
+    CHECK(scheduler.tick() == 0);
+}
+
+// A task that fails is reported and dropped, without stopping the others.
+static void testError(Program::Encoding encoding) {
+    VM vm;
+    auto failing = test::compile(vm, "yield 1\nvar x = 1\nguard x == 2 else fail \"boom\"\n", encoding);
+    auto deep = test::compile(vm, R"(
+func f = (n: Integer) -> Integer {
+    return f(n + 1) + 1
+}
+yield f(0)
+)", encoding);
+    auto prog = test::compile(vm, counter, encoding);
+    
+    std::vector<std::string> errors;
+    int returns = 0;
+    Scheduler scheduler{vm};
+    scheduler.onExit([&](Task&, VM::Result result, const Value& value) {
+        if(result == VM::Result::Error) errors.push_back(value.asString());
+        else if(result == VM::Result::Done) ++returns;
+    });
+    scheduler.spawn(failing);
+    scheduler.spawn(deep, 256, 16);
+    scheduler.spawn(prog);
+    
+    CHECK(scheduler.tick() == 3);
+    CHECK(errors == std::vector<std::string>{"call stack overflow"});
+    CHECK(scheduler.size() == 2);
+    scheduler.run();
+    CHECK(errors == (std::vector<std::string>{"call stack overflow", "boom"}));
+    CHECK(returns == 1);
+}
+
+// A task that never yields is preempted once it ran out of budget, and the others get their turn.
+static void testPreempted(Program::Encoding encoding) {
+    VM vm;
+    auto spinning = test::compile(vm, "var i = 0\nuntil i < 0 {\n    i = i + 1\n}\n", encoding);
+    auto counting = test::compile(vm, "var i = 0\nloop 1000 {\n    i = i + 1\n}\nyield i\n", encoding);
+    auto prog = test::compile(vm, counter, encoding);
+    
+    std::vector<std::int64_t> yields;
+    int returns = 0;
+    Scheduler scheduler{vm};
+    scheduler.setBudget(10);
+    scheduler.onYield([&](Task&, const Value& value) { yields.push_back(value.asInt()); });
+    scheduler.onExit([&](Task&, VM::Result result, const Value&) {
+        CHECK(result == VM::Result::Done);
+        ++returns;
+    });
+    scheduler.spawn(spinning);
+    scheduler.spawn(prog);
+    
+    for(int i = 0; i < 4; ++i) CHECK(scheduler.tick() == 2);
+    CHECK(yields == (std::vector<std::int64_t>{1, 2, 3}));
+    CHECK(returns == 1);
+    CHECK(scheduler.size() == 1);
+    for(int i = 0; i < 100; ++i) scheduler.tick();
+    CHECK(scheduler.size() == 1);
+    
+    // The loop isn't cut short by preemption: the task picks up where it stopped.
+    Scheduler other{vm};
+    other.setBudget(10);
+    other.onYield([&](Task&, const Value& value) { yields.push_back(value.asInt()); });
+    other.onExit([&](Task&, VM::Result result, const Value&) { ++returns; });
+    other.spawn(counting);
+    other.run();
+    CHECK(yields.back() == 1000);
+    CHECK(returns == 2);
+    CHECK(other.resumes() > 50);
+}
+
+// Functions compiled by the JIT that loop or call are interpreted when the task can be preempted.
+// Inlining is off, or the script would have neither.
+static void testJIT() {
+    VM vm;
+    auto prog = test::compile(vm, R"(
+func spin = (n: Integer) -> Integer {
+    var i = 0
+    until i >= n {
+        i = i + 1
+    }
+    return i
+}
+func twice = (n: Integer) -> Integer {
+    return n * 2
+}
+yield twice(21)
+yield spin(10000)
+)", Program::Encoding::Stack, 0);
+    if(!JIT::isAvailable()) return;
+    CHECK(JIT::compile(prog) == 2);
+    CHECK(std::count(prog.bounded.begin(), prog.bounded.end(), nullptr) == 1);
+    
+    for(std::uint64_t budget: {0, 10}) {
+        std::vector<std::int64_t> yields;
+        Scheduler scheduler{vm};
+        scheduler.setBudget(budget);
+        scheduler.onYield([&](Task&, const Value& value) { yields.push_back(value.asInt()); });
+        scheduler.spawn(prog);
+        scheduler.run();
+        CHECK(yields == (std::vector<std::int64_t>{42, 10000}));
+        if(budget) CHECK(scheduler.resumes() > 100);
+        else CHECK(scheduler.resumes() == 3);
+    }
+}
+
+int main() {
+    for(auto encoding: test::encodings) {
+        testYield(encoding);
+        testError(encoding);
+        testPreempted(encoding);
+    }
+    testJIT();
+    return test::failures();
+}
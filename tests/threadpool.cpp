@@ -0,0 +1,198 @@
+//
+//  threadpool.cpp
+//  tinyscript
+//
+//  Created by Amy Parent on 18/10/2026.
+//  Copyright © 2026 Amy Parent. All rights reserved.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tinyscript/runtime/library.hpp>
+#include <tinyscript/runtime/scheduler.hpp>
+#include <tinyscript/runtime/threadpool.hpp>
+#include "check.hpp"
+
+using namespace tinyscript;
+
+static const char* counter = R"(
+var i = 0
+loop 3 {
+    i = i + 1
+    yield i
+}
+)";
+
+// Spins until [condition] holds, and gives up after a few seconds so a broken pool fails the test
+// instead of hanging it.
+template <typename Condition>
+static bool eventually(Condition condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(!condition()) {
+        if(std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// wait() returns once every task spawned so far finished, and the pool can be reused after it.
+static void testWait(Program::Encoding encoding) {
+    VM vm;
+    auto prog = test::compile(vm, counter, encoding);
+    
+    std::atomic<std::int64_t> yielded{0};
+    std::atomic<int> exits{0};
+    ThreadPool pool{vm, 4};
+    pool.onYield([&](Task&, const Value& value) { yielded += value.asInt(); });
+    pool.onExit([&](Task&, VM::Result result, const Value&) {
+        CHECK(result == VM::Result::Done);
+        ++exits;
+    });
+    
+    for(int round = 1; round <= 2; ++round) {
+        for(int i = 0; i < 100; ++i) pool.spawn(prog);
+        pool.wait();
+        CHECK(exits == 100 * round);
+        CHECK(yielded == 600 * round);
+        CHECK(pool.resumes() == 400u * round);
+    }
+    pool.wait();
+}
+
+// A worker that runs dry takes tasks from the others. The first task to yield holds its worker
+// until that happened, so the test doesn't depend on how the threads get scheduled.
+static void testSteal(Program::Encoding encoding) {
+    VM vm;
+    auto yielding = test::compile(vm, counter, encoding);
+    auto returning = test::compile(vm, "var x = 1\n", encoding);
+    
+    std::atomic<int> exits{0};
+    ThreadPool pool{vm, 2};
+    pool.onYield([&](Task&, const Value&) { CHECK(eventually([&] { return pool.steals() > 0; })); });
+    pool.onExit([&](Task&, VM::Result, const Value&) { ++exits; });
+    
+    // Tasks are handed out in turn: the first worker gets the ones that yield.
+    for(int i = 0; i < 8; ++i) {
+        pool.spawn(yielding);
+        pool.spawn(returning);
+    }
+    pool.wait();
+    CHECK(exits == 16);
+    CHECK(pool.steals() > 0);
+}
+
+// Tasks failing on any worker are reported to the exit handler, and still count as finished.
+static void testError(Program::Encoding encoding) {
+    VM vm;
+    auto failing = test::compile(vm, "yield 1\nvar x = 1\nguard x == 2 else fail \"boom\"\n", encoding);
+    auto deep = test::compile(vm, R"(
+func f = (n: Integer) -> Integer {
+    return f(n + 1) + 1
+}
+yield f(0)
+)", encoding);
+    auto prog = test::compile(vm, counter, encoding);
+    
+    std::mutex mutex;
+    std::vector<std::string> errors;
+    int done = 0;
+    ThreadPool pool{vm, 3};
+    pool.onExit([&](Task&, VM::Result result, const Value& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(result == VM::Result::Error) errors.push_back(value.asString());
+        else if(result == VM::Result::Done) ++done;
+    });
+    
+    for(int i = 0; i < 10; ++i) {
+        pool.spawn(failing);
+        pool.spawn(deep, 256, 16);
+        pool.spawn(prog);
+    }
+    pool.wait();
+    CHECK(done == 10);
+    CHECK(errors.size() == 20);
+    CHECK(std::count(errors.begin(), errors.end(), "boom") == 10);
+    CHECK(std::count(errors.begin(), errors.end(), "call stack overflow") == 10);
+}
+
+// With a budget, a task that never yields doesn't keep the others from running, and the pool can
+// be destroyed while it's still queued.
+static void testPreempted(Program::Encoding encoding) {
+    VM vm;
+    auto spinning = test::compile(vm, "var i = 0\nuntil i < 0 {\n    i = i + 1\n}\n", encoding);
+    auto prog = test::compile(vm, counter, encoding);
+    
+    std::atomic<int> exits{0};
+    ThreadPool pool{vm, 1};
+    pool.setBudget(10);
+    pool.onExit([&](Task&, VM::Result, const Value&) { ++exits; });
+    pool.spawn(spinning);
+    pool.spawn(prog);
+    CHECK(eventually([&] { return exits == 1; }));
+}
+
+// Tasks seeded alike draw the same numbers, whether they share a thread or not, and tasks that
+// aren't seeded don't.
+static void testRandom(Program::Encoding encoding) {
+    VM vm;
+    StdLib lib;
+    vm.registerModule(lib.random());
+    auto seeded = test::compile(vm, R"(
+Random.seed(42)
+loop 3 {
+    yield Random.integer(1000000)
+}
+)", encoding);
+    auto unseeded = test::compile(vm, "yield Random.integer(1000000)\n", encoding);
+    
+    // Tasks are keyed by address only until they exit, since a later one may reuse it.
+    std::mutex mutex;
+    std::map<const Task*, std::vector<std::int64_t>> running;
+    std::vector<std::vector<std::int64_t>> draws;
+    auto onYield = [&](Task& task, const Value& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        running[&task].push_back(value.asInt());
+    };
+    auto onExit = [&](Task& task, VM::Result, const Value&) {
+        std::lock_guard<std::mutex> lock(mutex);
+        draws.push_back(std::move(running[&task]));
+        running.erase(&task);
+    };
+    
+    Scheduler scheduler{vm};
+    scheduler.onYield(onYield);
+    scheduler.onExit(onExit);
+    for(int i = 0; i < 4; ++i) scheduler.spawn(seeded);
+    scheduler.run();
+    
+    ThreadPool pool{vm, 2};
+    pool.onYield(onYield);
+    pool.onExit(onExit);
+    for(int i = 0; i < 8; ++i) pool.spawn(seeded);
+    pool.wait();
+    CHECK(draws.size() == 12);
+    CHECK(draws[0].size() == 3);
+    CHECK(std::count(draws.begin(), draws.end(), draws[0]) == 12);
+    
+    draws.clear();
+    scheduler.spawn(unseeded);
+    scheduler.spawn(unseeded);
+    scheduler.run();
+    CHECK(draws.size() == 2 && draws[0] != draws[1]);
+}
+
+int main() {
+    for(auto encoding: test::encodings) {
+        testWait(encoding);
+        testSteal(encoding);
+        testError(encoding);
+        testPreempted(encoding);
+        testRandom(encoding);
+    }
+    return test::failures();
+}